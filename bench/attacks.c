@@ -0,0 +1,85 @@
+#include <bench/base.h>
+#include <schess/attacks.h>
+#include <schess/gen.h>
+#include <schess/move.h>
+#include <schess/types.h>
+#include <schess/utils.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *attacks_FENs[] =
+{
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+static size_t
+collect_boards(game_state *game, irreversable_state meta, unsigned depth,
+               struct move_buffer *mbuf, board_state *out, size_t capacity)
+{
+  irreversable_state meta_copy;
+  size_t i, num_moves, count = 0;
+
+  if (!depth) { if (capacity) out[0] = game->board; return capacity != 0; }
+
+  num_moves = generate_moves(game, meta, &mbuf[depth - 1]);
+  for (i = 0; i < num_moves; ++i)
+  {
+    move *m = mbuf[depth - 1].moves + i;
+    meta_copy = meta;
+    move_make(m, game, &meta_copy);
+    if (is_board_legal(&game->board, game->active))
+      count += collect_boards(game, meta_copy, depth - 1, mbuf, out + count, capacity - count);
+    move_unmake(m, game);
+  }
+  return count;
+}
+
+BENCH(attack_map)
+{
+  const size_t capacity = 1 << 16;
+  const unsigned depth = 2, rounds = 50;
+  struct move_buffer *mbuf = move_buffer_create(depth);
+  board_state *boards = malloc(capacity * sizeof(*boards));
+  struct attack_map map;
+  game_state game;
+  irreversable_state meta;
+  enum CPU_LEVEL level;
+  size_t i, count = 0;
+  unsigned r;
+  volatile bitboard sink = 0;
+  double start, elapsed;
+  char label[64];
+
+  move_gen_init_LUTs();
+  for (i = 0; i < sizeof(attacks_FENs) / sizeof(*attacks_FENs); ++i)
+  {
+    parse_FEN(attacks_FENs[i], &game, &meta);
+    count += collect_boards(&game, meta, depth, mbuf, boards + count, capacity - count);
+  }
+
+  for (level = CPU_SCALAR; level <= CPU_AVX2; ++level)
+  {
+    if (attack_map_select_kernels(level) != level) continue;
+
+    start = bench_now();
+    for (r = 0; r < rounds; ++r)
+      for (i = 0; i < count; ++i)
+      {
+        attack_map_compute(&boards[i], &map);
+        sink ^= map.by_color[0] ^ map.by_color[1];
+      }
+    elapsed = bench_now() - start;
+
+    snprintf(label, sizeof(label), "%s attack maps", level == CPU_SCALAR ? "pext" : cpu_level_name(level));
+    bench_report(label, rounds * count / elapsed, "maps/s");
+  }
+
+  (void) sink;
+
+  attack_map_select_kernels(CPU_SCALAR);
+  move_buffer_destroy(mbuf);
+  free(boards);
+}
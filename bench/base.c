@@ -0,0 +1,78 @@
+#include <bench/base.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+
+typedef struct bench_ll
+{
+  const char *group;
+  const char *name;
+  void (*fn)(void);
+  struct bench_ll *next;
+} bench_ll;
+
+
+static bench_ll *bench_head;
+
+
+void
+bench_register(const char *group, const char *name, void (*fn)(void))
+{
+  bench_ll *new_bench, *current;
+
+  new_bench = malloc(sizeof(bench_ll));
+  new_bench->group = group;
+  new_bench->name = name;
+  new_bench->fn = fn;
+  new_bench->next = NULL;
+
+  if (!bench_head)
+  {
+    bench_head = new_bench;
+    return;
+  }
+  for (current = bench_head; current->next; current = current->next);
+  current->next = new_bench;
+}
+
+double
+bench_now(void)
+{
+  struct timespec ts;
+
+  // LINUX
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void
+bench_report(const char *label, double value, const char *unit)
+{
+  printf("  %-40s %16.2f %s\n", label, value, unit);
+}
+
+
+// runs every benchmark, or the ones whose name contains one of the arguments
+int
+main(int argc, char **argv)
+{
+  bench_ll *current;
+  int i, selected;
+
+  for (current = bench_head; current; current = current->next)
+  {
+    selected = argc == 1;
+    for (i = 1; i < argc && !selected; ++i)
+      selected = strstr(current->name, argv[i]) != NULL;
+    if (!selected) continue;
+
+    printf("Benchmark %s (%s):\n", current->name, current->group);
+    fflush(stdout);
+    current->fn();
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,27 @@
+#ifndef BENCH_BASE_H
+#define BENCH_BASE_H
+
+#include <stddef.h>
+
+void
+bench_register(const char *group, const char *name, void (*fn)(void));
+
+// monotonic wall clock in seconds
+double bench_now(void);
+
+// prints one aligned result line of the current benchmark
+void bench_report(const char *label, double value, const char *unit);
+
+
+#define BENCH(bench_id) \
+  static void schess_bench_## bench_id(void); \
+  __attribute__((constructor)) static void \
+  schess_benchregister_## bench_id(void) \
+{ \
+  bench_register(__FILE__, #bench_id, schess_bench_## bench_id); \
+} \
+static void schess_bench_## bench_id(void)
+
+
+
+#endif // BENCH_BASE_H
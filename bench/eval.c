@@ -0,0 +1,169 @@
+#include <bench/base.h>
+#include <schess/eval.h>
+#include <schess/evalcache.h>
+#include <schess/gen.h>
+#include <schess/move.h>
+#include <schess/nnue.h>
+#include <schess/search.h>
+#include <schess/types.h>
+#include <schess/utils.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *eval_FENs[] =
+{
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+BENCH(eval_cache)
+{
+  const size_t sizes[] = { 0, 1, EVAL_CACHE_DEFAULT_MB, 64 };
+  const unsigned depth = 4;
+  game_state game;
+  irreversable_state meta;
+  struct eval_cache_stats stats;
+  size_t i, s;
+  int net;
+  double start, elapsed;
+  char label[64];
+
+  move_gen_init_LUTs();
+
+  // the classical evaluation is cheap, the cache pays off in front of the network
+  for (net = 0; net < 2; ++net)
+  for (s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s)
+  {
+    if (net && !nnue_is_loaded()) nnue_init_random(0x5C4E55);
+
+    eval_cache_resize(sizes[s]);
+    eval_cache_stats_reset();
+
+    start = bench_now();
+    for (i = 0; i < sizeof(eval_FENs) / sizeof(*eval_FENs); ++i)
+    {
+      parse_FEN(eval_FENs[i], &game, &meta);
+      search_best_move(&game, meta, depth);
+    }
+    elapsed = bench_now() - start;
+    stats = eval_cache_stats();
+
+    snprintf(label, sizeof(label), "%s %zu MB search time", net ? "nnue" : "classical", sizes[s]);
+    bench_report(label, elapsed, "s");
+    if (!sizes[s]) continue;
+    snprintf(label, sizeof(label), "%s %zu MB hit rate", net ? "nnue" : "classical", sizes[s]);
+    bench_report(label, 100.0 * stats.hits / stats.probes, "%");
+  }
+
+  eval_cache_resize(EVAL_CACHE_DEFAULT_MB);
+}
+
+BENCH(eval_terms)
+{
+  const char *names[ET_COUNT] = { "material", "pawns", "mobility", "king safety" };
+  const unsigned depth = 5;
+  game_state game;
+  irreversable_state meta;
+  struct eval_stats stats;
+  size_t i;
+  unsigned term;
+  char label[64];
+
+  move_gen_init_LUTs();
+  // every evaluation has to reach the evaluator
+  eval_cache_resize(0);
+  eval_stats_reset();
+
+  for (i = 0; i < sizeof(eval_FENs) / sizeof(*eval_FENs); ++i)
+  {
+    parse_FEN(eval_FENs[i], &game, &meta);
+    search_best_move(&game, meta, depth);
+  }
+  stats = eval_stats();
+
+  bench_report("evaluations", stats.evaluations, "");
+  bench_report("lazy exits", 100.0 * stats.lazy_exits / stats.evaluations, "%");
+  // the cycle counters stay zero unless built with EVAL_STATS=1
+  for (term = 0; term < ET_COUNT; ++term)
+  {
+    snprintf(label, sizeof(label), "%s cycles per eval", names[term]);
+    bench_report(label, (double) stats.cycles[term] / stats.evaluations, "cycles");
+  }
+
+  eval_cache_resize(EVAL_CACHE_DEFAULT_MB);
+}
+
+// appends the positions `depth` plies below `game`
+static size_t
+collect_positions(game_state *game, irreversable_state meta, unsigned depth,
+                  struct move_buffer *mbuf, game_state *out, size_t capacity)
+{
+  irreversable_state meta_copy;
+  size_t i, num_moves, count = 0;
+
+  if (!depth) { if (capacity) out[0] = *game; return capacity != 0; }
+
+  num_moves = generate_moves(game, meta, &mbuf[depth - 1]);
+  for (i = 0; i < num_moves; ++i)
+  {
+    move *m = mbuf[depth - 1].moves + i;
+    meta_copy = meta;
+    move_make(m, game, &meta_copy);
+    if (is_board_legal(&game->board, game->active))
+      count += collect_positions(game, meta_copy, depth - 1, mbuf, out + count, capacity - count);
+    move_unmake(m, game);
+  }
+  return count;
+}
+
+BENCH(eval_batch)
+{
+  const size_t capacity = 1 << 16;
+  const unsigned depth = 2, rounds = 20;
+  struct move_buffer *mbuf = move_buffer_create(depth);
+  game_state *positions = malloc(capacity * sizeof(*positions)), game;
+  int *scores = malloc(capacity * sizeof(*scores));
+  irreversable_state meta;
+  enum CPU_LEVEL level;
+  size_t i, count = 0;
+  unsigned r;
+  volatile int sink;
+  double start, elapsed;
+  char label[64];
+
+  move_gen_init_LUTs();
+  for (i = 0; i < sizeof(eval_FENs) / sizeof(*eval_FENs); ++i)
+  {
+    parse_FEN(eval_FENs[i], &game, &meta);
+    count += collect_positions(&game, meta, depth, mbuf, positions + count, capacity - count);
+  }
+  bench_report("positions", count, "");
+
+  eval_cache_resize(0);
+  start = bench_now();
+  for (r = 0; r < rounds; ++r)
+    for (i = 0; i < count; ++i) sink = eval_position(&positions[i], meta);
+  elapsed = bench_now() - start;
+  bench_report("one at a time", rounds * count / elapsed, "evals/s");
+  (void) sink;
+
+  for (level = CPU_SCALAR; level <= CPU_AVX2; ++level)
+  {
+    if (eval_batch_select_kernels(level) != level) continue;
+
+    start = bench_now();
+    for (r = 0; r < rounds; ++r) eval_batch(positions, count, scores);
+    elapsed = bench_now() - start;
+
+    snprintf(label, sizeof(label), "%s batch", cpu_level_name(level));
+    bench_report(label, rounds * count / elapsed, "evals/s");
+  }
+
+  eval_batch_select_kernels(cpu_detect());
+  eval_cache_resize(EVAL_CACHE_DEFAULT_MB);
+  move_buffer_destroy(mbuf);
+  free(positions);
+  free(scores);
+}
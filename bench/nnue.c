@@ -0,0 +1,109 @@
+#include <bench/base.h>
+#include <schess/cpu.h>
+#include <schess/eval.h>
+#include <schess/evalcache.h>
+#include <schess/gen.h>
+#include <schess/move.h>
+#include <schess/nnue.h>
+#include <schess/types.h>
+#include <schess/utils.h>
+#include <stddef.h>
+#include <stdio.h>
+
+static const char *nnue_FENs[] =
+{
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+#define NNUE_FENS_NUM (sizeof(nnue_FENs) / sizeof(*nnue_FENs))
+
+// evaluates every node of a tree walk, the way a search sees the accumulators
+static size_t
+nnue_walk(game_state *game, irreversable_state meta, unsigned depth, struct move_buffer *mbuf, volatile int *sink)
+{
+  size_t i, num_moves, nodes = 1;
+  irreversable_state meta_copy;
+
+  *sink = eval_position(game, meta);
+  if (!depth) return nodes;
+
+  num_moves = generate_moves(game, meta, &mbuf[depth - 1]);
+  for (i = 0; i < num_moves; ++i)
+  {
+    move *m = mbuf[depth - 1].moves + i;
+    meta_copy = meta;
+    move_make(m, game, &meta_copy);
+    if (is_board_legal(&game->board, game->active)) nodes += nnue_walk(game, meta_copy, depth - 1, mbuf, sink);
+    move_unmake(m, game);
+  }
+
+  return nodes;
+}
+
+BENCH(nnue_evaluate)
+{
+  const unsigned depth = 3;
+  struct move_buffer *mbuf = move_buffer_create(depth);
+  game_state positions[NNUE_FENS_NUM];
+  irreversable_state meta[NNUE_FENS_NUM];
+  volatile int sink;
+  size_t i, nodes;
+  enum CPU_LEVEL level;
+  struct nnue_stats stats;
+  double start, elapsed;
+  char label[64];
+
+  move_gen_init_LUTs();
+  for (i = 0; i < NNUE_FENS_NUM; ++i)
+    parse_FEN(nnue_FENs[i], &positions[i], &meta[i]);
+  // transpositions in the walk would measure the cache instead
+  eval_cache_resize(0);
+
+  nodes = 0;
+  start = bench_now();
+  for (i = 0; i < NNUE_FENS_NUM; ++i)
+    nodes += nnue_walk(&positions[i], meta[i], depth, mbuf, &sink);
+  elapsed = bench_now() - start;
+  bench_report("classical tree walk", nodes / elapsed, "evals/s");
+
+  // no trained network ships with the engine, a random one has the same cost
+  nnue_init_random(0x5C4E55);
+
+  for (level = CPU_SCALAR; level <= CPU_AVX2; ++level)
+  {
+    if (nnue_select_kernels(level) != level) continue;
+
+    nnue_stats_reset();
+    nodes = 0;
+    start = bench_now();
+    for (i = 0; i < NNUE_FENS_NUM; ++i)
+    {
+      nnue_attach(&positions[i]);
+      nodes += nnue_walk(&positions[i], meta[i], depth, mbuf, &sink);
+      nnue_detach(&positions[i]);
+    }
+    elapsed = bench_now() - start;
+    stats = nnue_stats();
+
+    snprintf(label, sizeof(label), "%s incremental tree walk", cpu_level_name(level));
+    bench_report(label, nodes / elapsed, "evals/s");
+    snprintf(label, sizeof(label), "%s refreshes per eval", cpu_level_name(level));
+    bench_report(label, (double) stats.refreshes / stats.evaluations, "");
+    snprintf(label, sizeof(label), "%s updates per eval", cpu_level_name(level));
+    bench_report(label, (double) stats.updates / stats.evaluations, "");
+
+    start = bench_now();
+    for (i = 0; i < 20000; ++i)
+      sink = nnue_evaluate_fresh(&positions[i % NNUE_FENS_NUM]);
+    elapsed = bench_now() - start;
+
+    snprintf(label, sizeof(label), "%s full refresh", cpu_level_name(level));
+    bench_report(label, 20000 / elapsed, "evals/s");
+  }
+
+  nnue_select_kernels(cpu_detect());
+  eval_cache_resize(EVAL_CACHE_DEFAULT_MB);
+  move_buffer_destroy(mbuf);
+}
@@ -0,0 +1,212 @@
+#include <bench/base.h>
+#include <schess/gen.h>
+#include <schess/search.h>
+#include <schess/tt.h>
+#include <schess/types.h>
+#include <schess/utils.h>
+#include <stddef.h>
+#include <stdio.h>
+
+static const char *search_FENs[] =
+{
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+#define SEARCH_FENS_NUM (sizeof(search_FENs) / sizeof(*search_FENs))
+
+BENCH(search_multipv)
+{
+  const size_t widths[] = { 1, 2, 4, 8 };
+  const unsigned depth = 5;
+  struct search_limits limits = { .depth = depth };
+  game_state game;
+  irreversable_state meta;
+  uint64_t nodes, single = 0;
+  size_t i, w;
+  double start, elapsed;
+  char label[64];
+
+  move_gen_init_LUTs();
+
+  // every line after the first is searched over the table the ones above it filled
+  for (w = 0; w < sizeof(widths) / sizeof(*widths); ++w)
+  {
+    nodes = 0;
+    limits.multipv = widths[w];
+    start = bench_now();
+    for (i = 0; i < SEARCH_FENS_NUM; ++i)
+    {
+      tt_clear();
+      search_clear();
+      parse_FEN(search_FENs[i], &game, &meta);
+      nodes += search(&game, meta, &limits, NULL, NULL).nodes;
+    }
+    elapsed = bench_now() - start;
+    if (!single) single = nodes;
+
+    snprintf(label, sizeof(label), "multipv %zu time", widths[w]);
+    bench_report(label, elapsed, "s");
+    snprintf(label, sizeof(label), "multipv %zu nodes of multipv 1", widths[w]);
+    bench_report(label, (double) nodes / single, "x");
+  }
+}
+
+BENCH(search_pruning)
+{
+  static const char *names[] = { "all", "no reverse futility", "no futility", "no razoring", "no probcut", "none" };
+  const struct search_pruning defaults = search_pruning;
+  struct search_limits limits = { .depth = 6 };
+  struct search_stats stats;
+  game_state game;
+  irreversable_state meta;
+  uint64_t nodes;
+  size_t i, c;
+  double start, elapsed;
+  char label[64];
+
+  move_gen_init_LUTs();
+
+  // each technique is left out once, then all of them
+  for (c = 0; c < sizeof(names) / sizeof(*names); ++c)
+  {
+    search_pruning = defaults;
+    if (c == 1 || c == 5) search_pruning.reverse_futility_depth = 0;
+    if (c == 2 || c == 5) search_pruning.futility_depth = 0;
+    if (c == 3 || c == 5) search_pruning.razoring_depth = 0;
+    if (c == 4 || c == 5) search_pruning.probcut_depth = 0;
+
+    nodes = 0;
+    search_stats_reset();
+    start = bench_now();
+    for (i = 0; i < SEARCH_FENS_NUM; ++i)
+    {
+      tt_clear();
+      search_clear();
+      parse_FEN(search_FENs[i], &game, &meta);
+      nodes += search(&game, meta, &limits, NULL, NULL).nodes;
+    }
+    elapsed = bench_now() - start;
+    stats = search_stats();
+
+    snprintf(label, sizeof(label), "%s time", names[c]);
+    bench_report(label, elapsed, "s");
+    snprintf(label, sizeof(label), "%s nodes", names[c]);
+    bench_report(label, nodes, "");
+    if (c) continue;
+    bench_report("reverse futility prunes", stats.reverse_futility, "");
+    bench_report("futility prunes", stats.futility, "");
+    bench_report("razoring prunes", stats.razoring, "");
+    bench_report("probcut prunes", stats.probcut, "");
+  }
+
+  search_pruning = defaults;
+}
+
+BENCH(search_ordering)
+{
+  struct search_limits limits = { .depth = 7 };
+  struct search_stats stats;
+  game_state game;
+  irreversable_state meta;
+  uint64_t nodes = 0;
+  size_t i;
+  double start;
+
+  move_gen_init_LUTs();
+
+  search_stats_reset();
+  start = bench_now();
+  for (i = 0; i < SEARCH_FENS_NUM; ++i)
+  {
+    tt_clear();
+    search_clear();
+    parse_FEN(search_FENs[i], &game, &meta);
+    nodes += search(&game, meta, &limits, NULL, NULL).nodes;
+  }
+  bench_report("time", bench_now() - start, "s");
+  bench_report("nodes", nodes, "");
+  stats = search_stats();
+  bench_report("cutoffs on the first move", 100.0 * stats.first_cutoffs / stats.cutoffs, "%");
+}
+
+BENCH(search_internal_iterative)
+{
+  // the technique is picked when building, see SEARCH_IID in the Makefile
+#ifdef SCHESS_SEARCH_IID
+  const char *name = "IID";
+#else
+  const char *name = "IIR";
+#endif
+  struct search_limits limits = { .depth = 7 };
+  game_state game;
+  irreversable_state meta;
+  uint64_t nodes = 0;
+  size_t i;
+  double start;
+  char label[64];
+
+  move_gen_init_LUTs();
+
+  search_stats_reset();
+  start = bench_now();
+  for (i = 0; i < SEARCH_FENS_NUM; ++i)
+  {
+    tt_clear();
+    search_clear();
+    parse_FEN(search_FENs[i], &game, &meta);
+    nodes += search(&game, meta, &limits, NULL, NULL).nodes;
+  }
+  snprintf(label, sizeof(label), "%s time", name);
+  bench_report(label, bench_now() - start, "s");
+  snprintf(label, sizeof(label), "%s nodes", name);
+  bench_report(label, nodes, "");
+  snprintf(label, sizeof(label), "%s nodes without a hashed move", name);
+  bench_report(label, search_stats().internal_iterative, "");
+}
+
+BENCH(search_ybwc)
+{
+  const unsigned threads[] = { 1, 2, 4, 8, 16, 32 };
+  struct search_limits limits = { .depth = 7 };
+  game_state game;
+  irreversable_state meta;
+  uint64_t nodes, single_nodes = 0;
+  double start, elapsed, single_time = 0;
+  size_t i, t;
+  char label[64];
+
+  move_gen_init_LUTs();
+  search_set_parallel(SEARCH_YBWC);
+
+  // speedup is in wall time over one thread, overhead the nodes searched on top of its
+  for (t = 0; t < sizeof(threads) / sizeof(*threads); ++t)
+  {
+    search_set_threads(threads[t]);
+    nodes = 0;
+    start = bench_now();
+    for (i = 0; i < SEARCH_FENS_NUM; ++i)
+    {
+      tt_clear();
+      search_clear();
+      parse_FEN(search_FENs[i], &game, &meta);
+      nodes += search(&game, meta, &limits, NULL, NULL).nodes;
+    }
+    elapsed = bench_now() - start;
+    if (!t)
+    {
+      single_time = elapsed;
+      single_nodes = nodes;
+    }
+
+    snprintf(label, sizeof(label), "%u threads time", threads[t]);
+    bench_report(label, elapsed, "s");
+    snprintf(label, sizeof(label), "%u threads speedup", threads[t]);
+    bench_report(label, single_time / elapsed, "x");
+    snprintf(label, sizeof(label), "%u threads search overhead", threads[t]);
+    bench_report(label, 100.0 * ((double) nodes / single_nodes - 1), "%");
+  }
+
+  search_set_threads(1);
+  search_set_parallel(SEARCH_LAZY_SMP);
+}
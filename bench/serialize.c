@@ -0,0 +1,116 @@
+#include <bench/base.h>
+#include <schess/gen.h>
+#include <schess/serialize.h>
+#include <schess/types.h>
+#include <schess/utils.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define SERIALIZE_SAMPLES_NUM 4096
+
+static const char *serialize_FENs[] =
+{
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+static struct
+{
+  bitboard targets;
+  square from;
+  size_t position;
+} samples[SERIALIZE_SAMPLES_NUM];
+static size_t num_samples;
+static game_state positions[sizeof(serialize_FENs) / sizeof(*serialize_FENs)];
+
+static void
+serialize_collect_samples(void)
+{
+  irreversable_state meta;
+  struct move_set set;
+  size_t i, j;
+
+  move_gen_init_LUTs();
+  for (num_samples = 0; num_samples < SERIALIZE_SAMPLES_NUM;)
+  {
+    for (i = 0; i < sizeof(serialize_FENs) / sizeof(*serialize_FENs) && num_samples < SERIALIZE_SAMPLES_NUM; ++i)
+    {
+      parse_FEN(serialize_FENs[i], &positions[i], &meta);
+      generate_move_set(&positions[i], meta, &set);
+      for (j = 0; j < set.num_origins && num_samples < SERIALIZE_SAMPLES_NUM; ++j, ++num_samples)
+      {
+        samples[num_samples].targets  = set.targets[j];
+        samples[num_samples].from     = set.origins[j];
+        samples[num_samples].position = i;
+      }
+    }
+  }
+}
+
+BENCH(serialize_targets)
+{
+  const unsigned rounds = 2000;
+  move out[NUM_SQUARES];
+  size_t i, moves;
+  unsigned r;
+  enum CPU_LEVEL level;
+  double start, elapsed;
+  char label[64];
+
+  serialize_collect_samples();
+
+  for (level = CPU_SCALAR; level < CPU_LEVEL_COUNT; ++level)
+  {
+    // there is no dedicated sse serializer
+    if (level == CPU_SSE || serialize_init(level) != level) continue;
+
+    moves = 0;
+    start = bench_now();
+    for (r = 0; r < rounds; ++r)
+      for (i = 0; i < num_samples; ++i)
+        moves += serialize_targets(samples[i].targets, samples[i].from, positions[samples[i].position].board.types, out);
+    elapsed = bench_now() - start;
+
+    snprintf(label, sizeof(label), "%s serialized moves", cpu_level_name(level));
+    bench_report(label, moves / elapsed, "moves/s");
+  }
+
+  serialize_init(CPU_AVX512);
+}
+
+BENCH(generate_moves)
+{
+  const unsigned rounds = 200000;
+  struct move_buffer *mbuf = move_buffer_create(1);
+  irreversable_state meta[sizeof(serialize_FENs) / sizeof(*serialize_FENs)];
+  size_t i, moves;
+  unsigned r;
+  enum CPU_LEVEL level;
+  double start, elapsed;
+  char label[64];
+
+  move_gen_init_LUTs();
+  for (i = 0; i < sizeof(serialize_FENs) / sizeof(*serialize_FENs); ++i)
+    parse_FEN(serialize_FENs[i], &positions[i], &meta[i]);
+
+  for (level = CPU_SCALAR; level < CPU_LEVEL_COUNT; ++level)
+  {
+    if (level == CPU_SSE || serialize_init(level) != level) continue;
+
+    moves = 0;
+    start = bench_now();
+    for (r = 0; r < rounds; ++r)
+      for (i = 0; i < sizeof(serialize_FENs) / sizeof(*serialize_FENs); ++i)
+        moves += generate_moves(&positions[i], meta[i], mbuf);
+    elapsed = bench_now() - start;
+
+    snprintf(label, sizeof(label), "%s generate_moves", cpu_level_name(level));
+    bench_report(label, moves / elapsed, "moves/s");
+  }
+
+  serialize_init(CPU_AVX512);
+  move_buffer_destroy(mbuf);
+}
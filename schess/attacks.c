@@ -0,0 +1,281 @@
+#include <schess/attacks.h>
+#include <schess/eval.h>
+#include <schess/gen.h>
+#include <x86intrin.h>
+
+static const bitboard not_a_file = ~0x0101010101010101ull;
+static const bitboard not_h_file = ~0x8080808080808080ull;
+
+
+/* SLIDER KERNELS */
+// attack sets of `n` single bit sliders, orthogonal or diagonal
+typedef void (*slider_fn)(const bitboard *pieces, size_t n, bitboard occ, bitboard *out, int diagonal);
+
+static void
+sliders_lookup(const bitboard *pieces, size_t n, bitboard occ, bitboard *out, int diagonal)
+{
+  size_t i;
+
+  for (i = 0; i < n; ++i)
+  {
+    // GCC
+    square sq = __builtin_ctzll(pieces[i]);
+    out[i] = diagonal ? bishop_attacks(occ, sq) : rook_attacks(occ, sq);
+  }
+}
+
+// occluded fills towards higher squares: three doubling steps cover the seven squares of a ray
+__attribute__((target("avx2"))) // GCC // X86
+static inline __m256i
+fill_up(__m256i gen, __m256i empty, __m256i mask, int s)
+{
+  __m256i pro = _mm256_and_si256(empty, mask);
+
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_slli_epi64(gen, s)));
+  pro = _mm256_and_si256(pro, _mm256_slli_epi64(pro, s));
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_slli_epi64(gen, 2 * s)));
+  pro = _mm256_and_si256(pro, _mm256_slli_epi64(pro, 2 * s));
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_slli_epi64(gen, 4 * s)));
+  return _mm256_and_si256(_mm256_slli_epi64(gen, s), mask);
+}
+
+__attribute__((target("avx2"))) // GCC // X86
+static inline __m256i
+fill_down(__m256i gen, __m256i empty, __m256i mask, int s)
+{
+  __m256i pro = _mm256_and_si256(empty, mask);
+
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srli_epi64(gen, s)));
+  pro = _mm256_and_si256(pro, _mm256_srli_epi64(pro, s));
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srli_epi64(gen, 2 * s)));
+  pro = _mm256_and_si256(pro, _mm256_srli_epi64(pro, 2 * s));
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, _mm256_srli_epi64(gen, 4 * s)));
+  return _mm256_and_si256(_mm256_srli_epi64(gen, s), mask);
+}
+
+// four sliders per vector, one per lane
+__attribute__((target("avx2"))) // GCC // X86
+static void
+sliders_kogge_stone(const bitboard *pieces, size_t n, bitboard occ, bitboard *out, int diagonal)
+{
+  const __m256i empty = _mm256_set1_epi64x(~occ),
+                all   = _mm256_set1_epi64x(-1),
+                not_a = _mm256_set1_epi64x(not_a_file),
+                not_h = _mm256_set1_epi64x(not_h_file);
+  bitboard lanes[4] __attribute__((aligned(32))); // GCC
+  __m256i gen, attacks;
+  size_t i, j;
+
+  for (i = 0; i < n; i += 4)
+  {
+    for (j = 0; j < 4; ++j) lanes[j] = i + j < n ? pieces[i + j] : 0;
+    gen = _mm256_load_si256((const __m256i *) lanes);
+
+    if (diagonal)
+      attacks = _mm256_or_si256(_mm256_or_si256(fill_up(gen, empty, not_a, 9), fill_up(gen, empty, not_h, 7)),
+                                _mm256_or_si256(fill_down(gen, empty, not_h, 9), fill_down(gen, empty, not_a, 7)));
+    else
+      attacks = _mm256_or_si256(_mm256_or_si256(fill_up(gen, empty, all, 8), fill_down(gen, empty, all, 8)),
+                                _mm256_or_si256(fill_up(gen, empty, not_a, 1), fill_down(gen, empty, not_h, 1)));
+
+    _mm256_store_si256((__m256i *) lanes, attacks);
+    for (j = 0; j < 4 && i + j < n; ++j) out[i + j] = lanes[j];
+  }
+}
+
+static slider_fn sliders = sliders_lookup;
+
+enum CPU_LEVEL
+attack_map_select_kernels(enum CPU_LEVEL level)
+{
+  if (level > cpu_detect()) level = cpu_detect();
+  if (level >= CPU_AVX2)
+  {
+    sliders = sliders_kogge_stone;
+    return CPU_AVX2;
+  }
+  sliders = sliders_lookup;
+  return CPU_SCALAR;
+}
+
+// GCC
+__attribute__((constructor)) static void
+attack_map_init_kernels(void)
+{
+  // a PEXT lookup beats four lanes of fills, see bench/attacks.c
+  attack_map_select_kernels(CPU_SCALAR);
+}
+
+
+/* ATTACK MAP */
+void
+attack_map_compute(const board_state *board, struct attack_map *out)
+{
+  const int batched = sliders != sliders_lookup;
+  bitboard pieces, attacks, orthogonal[16], diagonal[16], results[16];
+  size_t n = 0, i, num_orthogonal = 0, num_diagonal = 0,
+         orthogonal_index[16], diagonal_index[16];
+  enum PIECE_REL pr;
+  unsigned side;
+  piece_type pt;
+  color c;
+  square sq;
+
+  out->occupancy = out->by_type[PT_NONE] = 0;
+  for (pt = PT_WP; pt < PT_COUNT; ++pt) out->occupancy |= board->bitboards[pt];
+
+  // pawns set-wise
+  pieces = board->bitboards[PT_WP];
+  out->by_type[PT_WP] = out->by_color[0] = ((pieces << 9) & not_a_file) | ((pieces << 7) & not_h_file);
+  out->twice[0] = (pieces << 9) & not_a_file & (pieces << 7) & not_h_file;
+  pieces = board->bitboards[PT_BP];
+  out->by_type[PT_BP] = out->by_color[1] = ((pieces >> 7) & not_a_file) | ((pieces >> 9) & not_h_file);
+  out->twice[1] = (pieces >> 7) & not_a_file & (pieces >> 9) & not_h_file;
+
+  // the piece list; with a vector kernel the sliders are queued and filled afterwards
+  for (side = 0; side < 2; ++side)
+  {
+    c = side ? COLOR_BLACK : COLOR_WHITE;
+    for (pr = PR_N; pr <= PR_K; ++pr)
+    {
+      out->by_type[c + pr] = 0;
+      for (pieces = board->bitboards[c + pr]; pieces && n < ATTACK_MAP_MAX_PIECES; pieces &= pieces - 1, ++n)
+      {
+        // GCC
+        sq = __builtin_ctzll(pieces);
+        out->squares[n] = sq;
+        out->types[n] = c + pr;
+
+        switch (pr)
+        {
+        case PR_N: attacks = knight_attacks[sq]; break;
+        case PR_K: attacks = king_attacks[sq]; break;
+        default:
+          if (!batched)
+          {
+            attacks = pr == PR_B ? bishop_attacks(out->occupancy, sq)
+                    : pr == PR_R ? rook_attacks(out->occupancy, sq)
+                    : queen_attacks(out->occupancy, sq);
+            break;
+          }
+          attacks = 0;
+          if (pr != PR_B && num_orthogonal < 16)
+          {
+            orthogonal_index[num_orthogonal] = n;
+            orthogonal[num_orthogonal++] = sq2bb(sq);
+          }
+          if (pr != PR_R && num_diagonal < 16)
+          {
+            diagonal_index[num_diagonal] = n;
+            diagonal[num_diagonal++] = sq2bb(sq);
+          }
+          break;
+        }
+        out->attacks[n] = attacks;
+      }
+    }
+  }
+  out->num_pieces = n;
+
+  if (batched)
+  {
+    sliders(orthogonal, num_orthogonal, out->occupancy, results, 0);
+    for (i = 0; i < num_orthogonal; ++i) out->attacks[orthogonal_index[i]] |= results[i];
+    sliders(diagonal, num_diagonal, out->occupancy, results, 1);
+    for (i = 0; i < num_diagonal; ++i) out->attacks[diagonal_index[i]] |= results[i];
+  }
+
+  for (i = 0; i < n; ++i)
+  {
+    side = out->types[i] >= PT_BP;
+    out->by_type[out->types[i]] |= out->attacks[i];
+    out->twice[side] |= out->by_color[side] & out->attacks[i];
+    out->by_color[side] |= out->attacks[i];
+  }
+}
+
+
+/* STATIC EXCHANGE */
+bitboard
+attackers_to(const board_state *board, square sq, bitboard occ)
+{
+  const bitboard *bb = board->bitboards, target = sq2bb(sq);
+  bitboard orthogonal = bb[PT_WR] | bb[PT_WQ] | bb[PT_BR] | bb[PT_BQ],
+           diagonal   = bb[PT_WB] | bb[PT_WQ] | bb[PT_BB] | bb[PT_BQ];
+
+  return ((((target >> 9) & not_h_file) | ((target >> 7) & not_a_file)) & bb[PT_WP])
+       | ((((target << 7) & not_h_file) | ((target << 9) & not_a_file)) & bb[PT_BP])
+       | (knight_attacks[sq] & (bb[PT_WN] | bb[PT_BN]))
+       | (king_attacks[sq] & (bb[PT_WK] | bb[PT_BK]))
+       | (rook_attacks(occ, sq) & orthogonal)
+       | (bishop_attacks(occ, sq) & diagonal);
+}
+
+static inline int
+see_value(piece_type pt)
+{
+  int value = eval_piece_value(pt);
+  return value < 0 ? -value : value;
+}
+
+static inline bitboard
+color_pieces(const bitboard *bb, color c)
+{
+  return bb[c + PR_P] | bb[c + PR_N] | bb[c + PR_B] | bb[c + PR_R] | bb[c + PR_Q] | bb[c + PR_K];
+}
+
+int
+see(const board_state *board, const struct attack_map *map, square from, square to)
+{
+  const bitboard *bb = board->bitboards;
+  const bitboard orthogonal = bb[PT_WR] | bb[PT_WQ] | bb[PT_BR] | bb[PT_BQ],
+                 diagonal   = bb[PT_WB] | bb[PT_WQ] | bb[PT_BB] | bb[PT_BQ];
+  piece_type moving = board->types[from], captured = board->types[to];
+  color side = moving >= PT_BP ? COLOR_BLACK : COLOR_WHITE;
+  bitboard occ, attackers, own = 0;
+  int gain[32], depth = 0;
+  enum PIECE_REL pr = PR_P;
+
+  gain[0] = captured == PT_NONE ? 0 : see_value(captured);
+  occ = (map ? map->occupancy : color_pieces(bb, COLOR_WHITE) | color_pieces(bb, COLOR_BLACK)) & ~sq2bb(from);
+
+  // nothing recaptures on an undefended square, unless an enemy slider x-rays through `from`:
+  // the map was computed with the moving piece still in its way
+  if (map && !(map->by_color[!COLOR_INDEX(side)] & sq2bb(to)))
+  {
+    const color enemy = OTHER_COLOR(side);
+    bitboard xray = 0;
+
+    if (rook_attacks(0, to) & sq2bb(from)) xray = rook_attacks(occ, to) & (bb[enemy + PR_R] | bb[enemy + PR_Q]);
+    else if (bishop_attacks(0, to) & sq2bb(from)) xray = bishop_attacks(occ, to) & (bb[enemy + PR_B] | bb[enemy + PR_Q]);
+    if (!xray) return gain[0];
+  }
+
+  attackers = attackers_to(board, to, occ) & occ;
+
+  // each side recaptures with its least valuable attacker, x-rays join as they are uncovered
+  while (depth < 31)
+  {
+    side = OTHER_COLOR(side);
+    for (pr = PR_P; pr <= PR_K; ++pr)
+      if ((own = attackers & bb[side + pr])) break;
+    if (!own) break;
+
+    own &= -own;
+    occ &= ~own;
+    // the king cannot capture into a square the other side still attacks
+    if (pr == PR_K && (attackers & occ & color_pieces(bb, OTHER_COLOR(side)))) break;
+
+    ++depth;
+    gain[depth] = see_value(moving) - gain[depth - 1];
+    moving = side + pr;
+
+    if (pr == PR_P || pr == PR_B || pr == PR_Q) attackers |= bishop_attacks(occ, to) & diagonal;
+    if (pr == PR_R || pr == PR_Q) attackers |= rook_attacks(occ, to) & orthogonal;
+    attackers &= occ;
+  }
+
+  for (; depth > 0; --depth)
+    gain[depth - 1] = -(gain[depth] > -gain[depth - 1] ? gain[depth] : -gain[depth - 1]);
+  return gain[0];
+}
@@ -0,0 +1,48 @@
+#ifndef SCHESS_ATTACKS_H
+#define SCHESS_ATTACKS_H
+
+#include <schess/cpu.h>
+#include <schess/types.h>
+#include <stddef.h>
+
+/*
+ * every attack of a position, computed in one pass. pawns are handled set-wise, the other
+ * pieces get one attack set each; sliders are filled several at a time (see
+ * attack_map_select_kernels). computed once per node, the map serves the evaluation, SEE
+ * and check detection alike.
+ */
+#define ATTACK_MAP_MAX_PIECES 32
+
+struct attack_map
+{
+  bitboard occupancy;
+  bitboard by_type[PT_COUNT];   // union of the attacks of every piece of the type
+  bitboard by_color[2];         // per COLOR_INDEX
+  bitboard twice[2];            // attacked by at least two pieces of the color
+  size_t num_pieces;            // knights, bishops, rooks, queens and kings, white first
+  square squares[ATTACK_MAP_MAX_PIECES];
+  piece_type types[ATTACK_MAP_MAX_PIECES];
+  bitboard attacks[ATTACK_MAP_MAX_PIECES];
+};
+
+void attack_map_compute(const board_state *board, struct attack_map *out);
+// slider kernels: PEXT lookups or Kogge-Stone fills; returns the level actually in use
+enum CPU_LEVEL attack_map_select_kernels(enum CPU_LEVEL level);
+
+// whether the king of `c` is attacked
+static inline int
+attack_map_in_check(const board_state *board, const struct attack_map *map, color c)
+{
+  return (board->bitboards[c + PR_K] & map->by_color[!COLOR_INDEX(c)]) != 0;
+}
+
+// pieces of both colors attacking `sq` through the occupancy `occ`
+bitboard attackers_to(const board_state *board, square sq, bitboard occ);
+
+/*
+ * static exchange evaluation of moving the piece on `from` to `to`, from the mover's point
+ * of view, in midgame material. `map` (may be NULL) lets undefended targets skip the swap.
+ */
+int see(const board_state *board, const struct attack_map *map, square from, square to);
+
+#endif // SCHESS_ATTACKS_H
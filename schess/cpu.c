@@ -0,0 +1,35 @@
+#include <schess/cpu.h>
+
+enum CPU_LEVEL
+cpu_detect(void)
+{
+  // GCC // X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") &&
+      __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512vbmi2")) return CPU_AVX512;
+  if (__builtin_cpu_supports("avx2")) return CPU_AVX2;
+  if (__builtin_cpu_supports("sse4.1")) return CPU_SSE;
+  return CPU_SCALAR;
+}
+
+int
+cpu_has_bmi2(void)
+{
+  // GCC // X86
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("bmi2");
+}
+
+static const char *cpu_level_names[CPU_LEVEL_COUNT] =
+{
+  "scalar",
+  "sse",
+  "avx2",
+  "avx512",
+};
+const char *
+cpu_level_name(enum CPU_LEVEL level)
+{
+  return cpu_level_names[level];
+}
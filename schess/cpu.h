@@ -0,0 +1,21 @@
+#ifndef SCHESS_CPU_H
+#define SCHESS_CPU_H
+
+/* instruction set levels the vectorized kernels are dispatched on at runtime */
+enum CPU_LEVEL
+{
+  CPU_SCALAR,
+  CPU_SSE,
+  CPU_AVX2,
+  CPU_AVX512,
+  CPU_LEVEL_COUNT
+};
+
+// best level supported by the running cpu
+enum CPU_LEVEL cpu_detect(void);
+// whether the running cpu has PEXT, which the whole build assumes (-mbmi2)
+int cpu_has_bmi2(void);
+
+const char *cpu_level_name(enum CPU_LEVEL level);
+
+#endif // SCHESS_CPU_H
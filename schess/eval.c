@@ -1,40 +1,853 @@
+#include <schess/attacks.h>
+#include <schess/cpu.h>
 #include <schess/eval.h>
+#include <schess/evalcache.h>
+#include <schess/gen.h>
+#include <schess/kpk.h>
+#include <schess/material.h>
+#include <schess/nnue.h>
+#include <schess/pawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
 
+/* MATERIAL */
+static int material_mg[PR_K + 1] = { 82, 337, 365, 477, 1025, 0 };
+static int material_eg[PR_K + 1] = { 94, 281, 297, 512,  936, 0 };
+
+// midgame material, so tuned values reach the move ordering as well
 int
 eval_piece_value(piece_type type)
 {
-  const int piece_values[PT_COUNT] =
-  {
-    [PT_NONE] = 0,
-    [PT_WP]   = 1,
-    [PT_WN]   = 3,
-    [PT_WB]   = 3,
-    [PT_WR]   = 5,
-    [PT_WQ]   = 9,
-    [PT_WK]   = +oo,
-    [PT_BP]   = -1,
-    [PT_BN]   = -3,
-    [PT_BB]   = -3,
-    [PT_BR]   = -5,
-    [PT_BQ]   = -9,
-    [PT_BK]   = -oo,
-  };
-
-  return piece_values[type];
+  if (type == PT_NONE) return 0;
+  if (type == PT_WK) return +oo;
+  if (type == PT_BK) return -oo;
+  return type < PT_BP ? material_mg[type - PT_WP] : -material_mg[type - PT_BP];
+}
+
+
+/* PIECE-SQUARE TABLES */
+// from white's point of view, written rank 8 first; white pieces index with sq ^ 56
+static int pst_mg[PR_K + 1][NUM_SQUARES] =
+{
+  [PR_P] =
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     98, 134,  61,  95,  68, 126,  34, -11,
+     -6,   7,  26,  31,  65,  56,  25, -20,
+    -14,  13,   6,  21,  23,  12,  17, -23,
+    -27,  -2,  -5,  12,  17,   6,  10, -25,
+    -26,  -4,  -4, -10,   3,   3,  33, -12,
+    -35,  -1, -20, -23, -15,  24,  38, -22,
+      0,   0,   0,   0,   0,   0,   0,   0,
+  },
+  [PR_N] =
+  {
+   -167, -89, -34, -49,  61, -97, -15,-107,
+    -73, -41,  72,  36,  23,  62,   7, -17,
+    -47,  60,  37,  65,  84, 129,  73,  44,
+     -9,  17,  19,  53,  37,  69,  18,  22,
+    -13,   4,  16,  13,  28,  19,  21,  -8,
+    -23,  -9,  12,  10,  19,  17,  25, -16,
+    -29, -53, -12,  -3,  -1,  18, -14, -19,
+   -105, -21, -58, -33, -17, -28, -19, -23,
+  },
+  [PR_B] =
+  {
+    -29,   4, -82, -37, -25, -42,   7,  -8,
+    -26,  16, -18, -13,  30,  59,  18, -47,
+    -16,  37,  43,  40,  35,  50,  37,  -2,
+     -4,   5,  19,  50,  37,  37,   7,  -2,
+     -6,  13,  13,  26,  34,  12,  10,   4,
+      0,  15,  15,  15,  14,  27,  18,  10,
+      4,  15,  16,   0,   7,  21,  33,   1,
+    -33,  -3, -14, -21, -13, -12, -39, -21,
+  },
+  [PR_R] =
+  {
+     32,  42,  32,  51,  63,   9,  31,  43,
+     27,  32,  58,  62,  80,  67,  26,  44,
+     -5,  19,  26,  36,  17,  45,  61,  16,
+    -24, -11,   7,  26,  24,  35,  -8, -20,
+    -36, -26, -12,  -1,   9,  -7,   6, -23,
+    -45, -25, -16, -17,   3,   0,  -5, -33,
+    -44, -16, -20,  -9,  -1,  11,  -6, -71,
+    -19, -13,   1,  17,  16,   7, -37, -26,
+  },
+  [PR_Q] =
+  {
+    -28,   0,  29,  12,  59,  44,  43,  45,
+    -24, -39,  -5,   1, -16,  57,  28,  54,
+    -13, -17,   7,   8,  29,  56,  47,  57,
+    -27, -27, -16, -16,  -1,  17,  -2,   1,
+     -9, -26,  -9, -10,  -2,  -4,   3,  -3,
+    -14,   2, -11,  -2,  -5,   2,  14,   5,
+    -35,  -8,  11,   2,   8,  15,  -3,   1,
+     -1, -18,  -9,  10, -15, -25, -31, -50,
+  },
+  [PR_K] =
+  {
+    -65,  23,  16, -15, -56, -34,   2,  13,
+     29,  -1, -20,  -7,  -8,  -4, -38, -29,
+     -9,  24,   2, -16, -20,   6,  22, -22,
+    -17, -20, -12, -27, -30, -25, -14, -36,
+    -49,  -1, -27, -39, -46, -44, -33, -51,
+    -14, -14, -22, -46, -44, -30, -15, -27,
+      1,   7,  -8, -64, -43, -16,   9,   8,
+    -15,  36,  12, -54,   8, -28,  24,  14,
+  },
+};
+static int pst_eg[PR_K + 1][NUM_SQUARES] =
+{
+  [PR_P] =
+  {
+      0,   0,   0,   0,   0,   0,   0,   0,
+    178, 173, 158, 134, 147, 132, 165, 187,
+     94, 100,  85,  67,  56,  53,  82,  84,
+     32,  24,  13,   5,  -2,   4,  17,  17,
+     13,   9,  -3,  -7,  -7,  -8,   3,  -1,
+      4,   7,  -6,   1,   0,  -5,  -1,  -8,
+     13,   8,   8,  10,  13,   0,   2,  -7,
+      0,   0,   0,   0,   0,   0,   0,   0,
+  },
+  [PR_N] =
+  {
+    -58, -38, -13, -28, -31, -27, -63, -99,
+    -25,  -8, -25,  -2,  -9, -25, -24, -52,
+    -24, -20,  10,   9,  -1,  -9, -19, -41,
+    -17,   3,  22,  22,  22,  11,   8, -18,
+    -18,  -6,  16,  25,  16,  17,   4, -18,
+    -23,  -3,  -1,  15,  10,  -3, -20, -22,
+    -42, -20, -10,  -5,  -2, -20, -23, -44,
+    -29, -51, -23, -15, -22, -18, -50, -64,
+  },
+  [PR_B] =
+  {
+    -14, -21, -11,  -8,  -7,  -9, -17, -24,
+     -8,  -4,   7, -12,  -3, -13,  -4, -14,
+      2,  -8,   0,  -1,  -2,   6,   0,   4,
+     -3,   9,  12,   9,  14,  10,   3,   2,
+     -6,   3,  13,  19,   7,  10,  -3,  -9,
+    -12,  -3,   8,  10,  13,   3,  -7, -15,
+    -14, -18,  -7,  -1,   4,  -9, -15, -27,
+    -23,  -9, -23,  -5,  -9, -16,  -5, -17,
+  },
+  [PR_R] =
+  {
+     13,  10,  18,  15,  12,  12,   8,   5,
+     11,  13,  13,  11,  -3,   3,   8,   3,
+      7,   7,   7,   5,   4,  -3,  -5,  -3,
+      4,   3,  13,   1,   2,   1,  -1,   2,
+      3,   5,   8,   4,  -5,  -6,  -8, -11,
+     -4,   0,  -5,  -1,  -7, -12,  -8, -16,
+     -6,  -6,   0,   2,  -9,  -9, -11,  -3,
+     -9,   2,   3,  -1,  -5, -13,   4, -20,
+  },
+  [PR_Q] =
+  {
+     -9,  22,  22,  27,  27,  19,  10,  20,
+    -17,  20,  32,  41,  58,  25,  30,   0,
+    -20,   6,   9,  49,  47,  35,  19,   9,
+      3,  22,  24,  45,  57,  40,  57,  36,
+    -18,  28,  19,  47,  31,  34,  39,  23,
+    -16, -27,  15,   6,   9,  17,  10,   5,
+    -22, -23, -30, -16, -16, -23, -36, -32,
+    -33, -28, -22, -43,  -5, -32, -20, -41,
+  },
+  [PR_K] =
+  {
+    -74, -35, -18, -18, -11,  15,   4, -17,
+    -12,  17,  14,  17,  17,  38,  23,  11,
+     10,  17,  23,  15,  20,  45,  44,  13,
+     -8,  22,  24,  27,  26,  33,  26,   3,
+    -18,  -4,  21,  24,  27,  23,   9, -11,
+    -19,  -3,  11,  21,  23,  16,   7,  -9,
+    -27, -11,   4,  13,  14,   4,  -5, -17,
+    -53, -34, -21, -11, -28, -14, -24, -43,
+  },
+};
+
+const int eval_phase_inc[PT_COUNT] =
+{
+  [PT_WN] = 1, [PT_WB] = 1, [PT_WR] = 2, [PT_WQ] = 4,
+  [PT_BN] = 1, [PT_BB] = 1, [PT_BR] = 2, [PT_BQ] = 4,
+};
+
+int eval_psqt_mg[PT_COUNT][NUM_SQUARES];
+int eval_psqt_eg[PT_COUNT][NUM_SQUARES];
+
+void
+eval_init_tables(void)
+{
+  enum PIECE_REL pr;
+  square sq;
+
+  for (pr = PR_P; pr <= PR_K; ++pr)
+  {
+    for (sq = a1; sq < NUM_SQUARES; ++sq)
+    {
+      eval_psqt_mg[COLOR_WHITE + pr][sq] =  (material_mg[pr] + pst_mg[pr][sq ^ 56]);
+      eval_psqt_eg[COLOR_WHITE + pr][sq] =  (material_eg[pr] + pst_eg[pr][sq ^ 56]);
+      eval_psqt_mg[COLOR_BLACK + pr][sq] = -(material_mg[pr] + pst_mg[pr][sq]);
+      eval_psqt_eg[COLOR_BLACK + pr][sq] = -(material_eg[pr] + pst_eg[pr][sq]);
+    }
+  }
+}
+
+// GCC
+__attribute__((constructor)) static void
+eval_init_tables_on_load(void) { eval_init_tables(); }
+
+void
+eval_refresh(game_state *game)
+{
+  square sq;
+  piece_type pt;
+
+  game->psqt_mg = game->psqt_eg = game->phase = 0;
+  for (sq = a1; sq < NUM_SQUARES; ++sq)
+  {
+    pt = game->board.types[sq];
+    game->psqt_mg += eval_psqt_mg[pt][sq];
+    game->psqt_eg += eval_psqt_eg[pt][sq];
+    game->phase   += eval_phase_inc[pt];
+  }
+}
+
+
+
+/* MOBILITY */
+// per reachable square beyond the typical count, which scores zero
+static int mobility_mg[PR_K + 1]   = { 0, 4, 5, 2, 1, 0 };
+static int mobility_eg[PR_K + 1]   = { 0, 4, 5, 4, 2, 0 };
+static int mobility_base[PR_K + 1] = { 0, 4, 6, 7, 13, 0 };
+
+// squares attacked by enemy pawns or taken by own pieces do not count, per COLOR_INDEX
+static void
+eval_mobility_area(const board_state *board, const struct pawn_entry *pawns, bitboard area[2])
+{
+  bitboard own[2] = { 0, 0 };
+  enum PIECE_REL pr;
+
+  for (pr = PR_P; pr <= PR_K; ++pr)
+  {
+    own[0] |= board->bitboards[COLOR_WHITE + pr];
+    own[1] |= board->bitboards[COLOR_BLACK + pr];
+  }
+  area[0] = ~own[0] & ~pawns->attacks[1];
+  area[1] = ~own[1] & ~pawns->attacks[0];
+}
+
+// white relative
+static void
+eval_mobility(const board_state *board, const struct pawn_entry *pawns, const struct attack_map *map, int *mg, int *eg)
+{
+  bitboard area[2];
+  enum PIECE_REL pr;
+  unsigned side;
+  size_t i;
+  int count, sign;
+
+  eval_mobility_area(board, pawns, area);
+  for (i = 0; i < map->num_pieces; ++i)
+  {
+    side = map->types[i] >= PT_BP;
+    pr   = map->types[i] - (side ? COLOR_BLACK : COLOR_WHITE);
+    if (pr == PR_K) continue;
+
+    sign  = side ? -1 : 1;
+    // GCC
+    count = __builtin_popcountll(map->attacks[i] & area[side]);
+    *mg += sign * mobility_mg[pr] * (count - mobility_base[pr]);
+    *eg += sign * mobility_eg[pr] * (count - mobility_base[pr]);
+  }
+}
+
+
+/* KING SAFETY */
+static int king_attack_weight[PR_K + 1] = { 0, 2, 2, 3, 5, 0 };
+#define KING_SAFETY_MAX 500
+
+// of the king whose zone `attackers` pieces bear on with a summed `weight`
+static inline int
+king_safety_penalty(unsigned attackers, int weight)
+{
+  // a lone attacker is no attack
+  if (attackers < 2) return 0;
+  return weight * weight / 8 > KING_SAFETY_MAX ? KING_SAFETY_MAX : weight * weight / 8;
+}
+
+// the king and the squares around it, per COLOR_INDEX
+static void
+eval_king_zones(const board_state *board, bitboard zone[2])
+{
+  unsigned side;
+  square king;
+
+  for (side = 0; side < 2; ++side)
+  {
+    // GCC
+    king = __builtin_ctzll(board->bitboards[(side ? COLOR_BLACK : COLOR_WHITE) + PR_K] | (1ull << 63));
+    zone[side] = king_attacks[king] | sq2bb(king);
+  }
+}
+
+// white relative midgame penalty for pieces bearing on the squares around each king
+static int
+eval_king_safety(const board_state *board, const struct attack_map *map)
+{
+  bitboard zone[2];
+  enum PIECE_REL pr;
+  unsigned them, attackers[2] = { 0, 0 };
+  int weight[2] = { 0, 0 };
+  size_t i;
+
+  eval_king_zones(board, zone);
+  for (i = 0; i < map->num_pieces; ++i)
+  {
+    them = map->types[i] < PT_BP;   // the side whose king the piece bears on
+    pr   = map->types[i] - (them ? COLOR_WHITE : COLOR_BLACK);
+    if (pr == PR_K || !(map->attacks[i] & zone[them])) continue;
+    ++attackers[them];
+    // GCC
+    weight[them] += king_attack_weight[pr] * __builtin_popcountll(map->attacks[i] & zone[them]);
+  }
+
+  return king_safety_penalty(attackers[1], weight[1]) - king_safety_penalty(attackers[0], weight[0]);
+}
+
+
+/* KPK */
+#define KPK_WIN_BONUS 600
+
+// white relative; returns 0 if the bitbase is not available
+static int
+eval_kpk(const game_state *game, int *score)
+{
+  color strong = game->board.bitboards[PT_WP] ? COLOR_WHITE : COLOR_BLACK,
+        weak = OTHER_COLOR(strong);
+  // GCC
+  square strong_king = __builtin_ctzll(game->board.bitboards[strong + PR_K]),
+         weak_king   = __builtin_ctzll(game->board.bitboards[weak + PR_K]),
+         pawn        = __builtin_ctzll(game->board.bitboards[strong + PR_P]);
+  int result = kpk_probe(strong_king, pawn, weak_king, strong, game->active),
+      rank = strong == COLOR_WHITE ? pawn >> 3 : 7 - (pawn >> 3),
+      sign = strong == COLOR_WHITE ? 1 : -1;
+
+  if (result < 0) return 0;
+
+  // wins are kept ordered by how far the pawn is, so the search still makes progress
+  *score = result ? game->psqt_eg + sign * (KPK_WIN_BONUS + 20 * rank) : 0;
+  return 1;
+}
+
+
+/* PARAMETERS */
+#define PARAM(array) { #array, (int *) (array), sizeof(array) / sizeof(int) }
+const struct eval_param eval_params[] =
+{
+  PARAM(material_mg),
+  PARAM(material_eg),
+  PARAM(pst_mg),
+  PARAM(pst_eg),
+  PARAM(mobility_mg),
+  PARAM(mobility_eg),
+  PARAM(mobility_base),
+  PARAM(king_attack_weight),
 };
+#undef PARAM
+const size_t eval_num_params = sizeof(eval_params) / sizeof(*eval_params);
+
+void
+eval_params_changed(void)
+{
+  eval_init_tables();
+  eval_cache_clear();
+  pawn_table_free();
+}
+
+
+/* STAGED EVALUATION */
+static _Thread_local struct eval_stats stats;
+
+#ifdef SCHESS_EVAL_STATS
+#define EVAL_TERM_BEGIN() uint64_t term_start = __rdtsc() // X86
+#define EVAL_TERM_END(term) \
+  do \
+  { \
+    uint64_t term_end = __rdtsc(); \
+    stats.cycles[term] += term_end - term_start; \
+    term_start = term_end; \
+  } while (0)
+#else
+#define EVAL_TERM_BEGIN() do { } while (0)
+#define EVAL_TERM_END(term) do { } while (0)
+#endif
+
+static inline int
+eval_taper(int mg, int eg, const struct material_entry *material)
+{
+  // the side ahead in the endgame is scaled down in drawish material configurations
+  eg = eg * material->scale[eg < 0] / MATERIAL_SCALE_NORMAL;
+  return (mg * material->phase + eg * (EVAL_PHASE_MAX - material->phase)) / EVAL_PHASE_MAX;
+}
+
+static inline int
+square_distance(square a, square b)
+{
+  int files = abs((int) (a & 7) - (int) (b & 7)),
+      ranks = abs((int) (a >> 3) - (int) (b >> 3));
+  return files > ranks ? files : ranks;
+}
+
+// white relative; a lone king is driven to the edge by its opponent's king
+static int
+eval_kxk(const game_state *game)
+{
+  // GCC
+  square white_king = __builtin_ctzll(game->board.bitboards[PT_WK] | (1ull << 63)),
+         black_king = __builtin_ctzll(game->board.bitboards[PT_BK] | (1ull << 63));
+  int strong = game->psqt_eg > 0,
+      weak_king = strong ? black_king : white_king,
+      file = weak_king & 7, rank = weak_king >> 3,
+      edge = (file < 4 ? 3 - file : file - 4) + (rank < 4 ? 3 - rank : rank - 4),
+      bonus = 20 * edge + 10 * (7 - square_distance(white_king, black_king));
+
+  return game->psqt_eg + (strong ? bonus : -bonus);
+}
+
+// white relative score of the endings with a dedicated evaluation; returns 0 for any other material
+static inline int
+eval_special(const game_state *game, const struct material_entry *material, int *score)
+{
+  if (material->flags & MF_DRAW) { *score = 0; return 1; }
+  if (material->flags & MF_KXK) { *score = eval_kxk(game); return 1; }
+  return material->flags & MF_KPK && eval_kpk(game, score);
+}
+
+static inline int
+eval_clamp_positional(int value)
+{
+  return value > EVAL_POSITIONAL_MAX ? EVAL_POSITIONAL_MAX : value < -EVAL_POSITIONAL_MAX ? -EVAL_POSITIONAL_MAX : value;
+}
+
+// sets `exact` to 0 if the score is the material + pst one returned by a lazy exit
+static int
+eval_classical(game_state *game, int alpha, int beta, int *exact)
+{
+  const struct material_entry *material = material_probe(game->material_key);
+  struct pawn_entry *pawns;
+  struct attack_map map;
+  int sign = game->active == COLOR_WHITE ? 1 : -1,
+      mg = game->psqt_mg + material->imbalance,
+      eg = game->psqt_eg + material->imbalance,
+      positional_mg = 0, positional_eg = 0,
+      score;
+  EVAL_TERM_BEGIN();
+
+  ++stats.evaluations;
+  *exact = 1;
+
+  if (eval_special(game, material, &score)) return sign * score;
+
+  // cheap terms first; the clamped expensive ones cannot move the score by the margin
+  score = sign * eval_taper(mg, eg, material);
+  EVAL_TERM_END(ET_MATERIAL);
+  if (score + EVAL_LAZY_MARGIN <= alpha || score - EVAL_LAZY_MARGIN >= beta)
+  {
+    ++stats.lazy_exits;
+    *exact = 0;
+    return score;
+  }
+
+  pawns = pawn_probe(game);
+  positional_mg += pawns->mg + pawns->shield[0] - pawns->shield[1];
+  positional_eg += pawns->eg;
+  EVAL_TERM_END(ET_PAWNS);
+
+  // one attack map serves both of the remaining terms
+  attack_map_compute(&game->board, &map);
+  eval_mobility(&game->board, pawns, &map, &positional_mg, &positional_eg);
+  EVAL_TERM_END(ET_MOBILITY);
+
+  positional_mg += eval_king_safety(&game->board, &map);
+  EVAL_TERM_END(ET_KING_SAFETY);
+
+  mg += eval_clamp_positional(positional_mg);
+  eg += eval_clamp_positional(positional_eg);
+  return sign * eval_taper(mg, eg, material);
+}
+
+#undef EVAL_TERM_BEGIN
+#undef EVAL_TERM_END
+
+// network scores are cached apart from classical ones of the same position
+static const uint64_t nnue_key_salt = 0x9E3779B97F4A7C15ull;
 
 int
-eval_position(game_state *game, irreversable_state meta)
+eval_position_window(game_state *game, irreversable_state meta, int alpha, int beta)
 {
+  uint64_t key = game->nnue ? game->key ^ nnue_key_salt : game->key;
+  int score, exact = 1;
+
   (void) meta;
 
-  piece_type i;
-  int score = 0;
+  if (eval_cache_probe(key, &score)) return score;
+
+  score = game->nnue ? nnue_evaluate(game) : eval_classical(game, alpha, beta, &exact);
+  // lazy scores are only good for the window they were computed in
+  if (exact) eval_cache_store(key, score);
+  return score;
+}
+
+int
+eval_position(game_state *game, irreversable_state meta)
+{
+  return eval_position_window(game, meta, -oo, +oo);
+}
+
+struct eval_stats
+eval_stats(void)
+{
+  return stats;
+}
+
+void
+eval_stats_reset(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+
+/* BATCH */
+/*
+ * positions are evaluated a block at a time, one position per lane. walking a board stays
+ * per position: the material and pawn entries are probed and the attack map is computed,
+ * then gathered into arrays indexed by lane, piece slot by piece slot. mobility, king
+ * safety, the clamp of the positional terms, scaling, tapering and the side to move are
+ * computed across the lanes, with one vector instruction per EVAL_BATCH_LANES positions.
+ */
+#define EVAL_BATCH_BLOCK 64
+#define EVAL_BATCH_LANES 4
 
-  for (i = 0; i < PT_COUNT; ++i)
+struct eval_soa
+{
+  int32_t mg[EVAL_BATCH_BLOCK], eg[EVAL_BATCH_BLOCK], phase[EVAL_BATCH_BLOCK];
+  int32_t scale_white[EVAL_BATCH_BLOCK], scale_black[EVAL_BATCH_BLOCK], sign[EVAL_BATCH_BLOCK];
+  // pawn terms, to which the lanes add mobility and king safety before the clamp
+  int32_t positional_mg[EVAL_BATCH_BLOCK], positional_eg[EVAL_BATCH_BLOCK];
+  int32_t num_pieces[EVAL_BATCH_BLOCK];
+  bitboard area[2][EVAL_BATCH_BLOCK], zone[2][EVAL_BATCH_BLOCK]; // per COLOR_INDEX
+  // slots past a lane's num_pieces keep whatever an earlier block left there
+  int32_t types[ATTACK_MAP_MAX_PIECES][EVAL_BATCH_BLOCK];
+  bitboard attacks[ATTACK_MAP_MAX_PIECES][EVAL_BATCH_BLOCK];
+} __attribute__((aligned(32))); // GCC
+
+/* the mobility and king safety weights by piece type, white relative; zero for PT_NONE */
+struct eval_lane_weights
+{
+  int32_t mobility_mg[PT_COUNT], mobility_eg[PT_COUNT], mobility_base[PT_COUNT];
+  int32_t king_attack[PT_COUNT];
+  int32_t attacker[PT_COUNT];   // 1 for the pieces counted as king attackers
+};
+
+// the weights are tunable, so they are looked up again for every batch
+static void
+eval_lane_weights(struct eval_lane_weights *w)
+{
+  enum PIECE_REL pr;
+  piece_type pt;
+  int sign;
+
+  memset(w, 0, sizeof(*w));
+  for (pr = PR_N; pr < PR_K; ++pr)
   {
-    score += __builtin_popcountll(game->board.bitboards[i]) * eval_piece_value(i);
+    for (sign = 1; sign >= -1; sign -= 2)
+    {
+      pt = (sign > 0 ? COLOR_WHITE : COLOR_BLACK) + pr;
+      w->mobility_mg[pt]   = sign * mobility_mg[pr];
+      w->mobility_eg[pt]   = sign * mobility_eg[pr];
+      w->mobility_base[pt] = mobility_base[pr];
+      w->king_attack[pt]   = king_attack_weight[pr];
+      w->attacker[pt]      = 1;
+    }
   }
+}
 
-  return score;
+typedef void (*positional_fn)(struct eval_soa *soa, const struct eval_lane_weights *w, size_t n);
+typedef void (*taper_fn)(const struct eval_soa *soa, size_t n, int *out);
+
+static void
+positional_scalar(struct eval_soa *soa, const struct eval_lane_weights *w, size_t n)
+{
+  unsigned attackers[2];
+  int weight[2], mg, eg, count, hits;
+  size_t i, slot;
+  piece_type pt;
+  bitboard attacks;
+
+  for (i = 0; i < n; ++i)
+  {
+    mg = soa->positional_mg[i];
+    eg = soa->positional_eg[i];
+    attackers[0] = attackers[1] = 0;
+    weight[0] = weight[1] = 0;
+
+    for (slot = 0; slot < (size_t) soa->num_pieces[i]; ++slot)
+    {
+      pt = soa->types[slot][i];
+      attacks = soa->attacks[slot][i];
+      // GCC
+      count = __builtin_popcountll(attacks & soa->area[pt >= PT_BP][i]);
+      hits  = __builtin_popcountll(attacks & soa->zone[pt < PT_BP][i]);
+      mg += w->mobility_mg[pt] * (count - w->mobility_base[pt]);
+      eg += w->mobility_eg[pt] * (count - w->mobility_base[pt]);
+      attackers[pt < PT_BP] += w->attacker[pt] && hits;
+      weight[pt < PT_BP]    += w->king_attack[pt] * hits;
+    }
+
+    mg += king_safety_penalty(attackers[1], weight[1]) - king_safety_penalty(attackers[0], weight[0]);
+    soa->mg[i] += eval_clamp_positional(mg);
+    soa->eg[i] += eval_clamp_positional(eg);
+  }
+}
+
+// bits set in each 64 bit lane, in its low 16 bits
+__attribute__((target("avx2"))) // GCC // X86
+static inline __m256i
+popcount_avx2(__m256i v)
+{
+  const __m256i nibbles = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4),
+                low = _mm256_set1_epi8(0x0F);
+  __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(nibbles, _mm256_and_si256(v, low)),
+                                  _mm256_shuffle_epi8(nibbles, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+  return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+// the low 32 bits of each 64 bit lane
+__attribute__((target("avx2"))) // GCC // X86
+static inline __m128i
+narrow_avx2(__m256i v)
+{
+  return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7)));
+}
+
+__attribute__((target("avx2"))) // GCC // X86
+static inline __m128i
+king_safety_penalty_avx2(__m128i attackers, __m128i weight)
+{
+  __m128i penalty = _mm_min_epi32(_mm_srai_epi32(_mm_mullo_epi32(weight, weight), 3), _mm_set1_epi32(KING_SAFETY_MAX));
+  return _mm_and_si128(penalty, _mm_cmpgt_epi32(attackers, _mm_set1_epi32(1)));
+}
+
+// the slots of EVAL_BATCH_LANES positions at a time, up to the longest map among them
+__attribute__((target("avx2"))) // GCC // X86
+static void
+positional_avx2(struct eval_soa *soa, const struct eval_lane_weights *w, size_t n)
+{
+  const __m128i zero = _mm_setzero_si128(),
+                limit = _mm_set1_epi32(EVAL_POSITIONAL_MAX),
+                black_from = _mm_set1_epi32(PT_BP - 1);
+  __m256i area_white, area_black, zone_white, zone_black, attacks, black_wide;
+  __m128i num_pieces, pt, black, active, count, hits, base, attacking,
+          mg, eg, attackers_white, attackers_black, weight_white, weight_black, attack_weight;
+  size_t i, slot, slots, lane;
+
+  // lanes past `n` read what an earlier block left, only the stores are cut short
+  for (i = 0; i < n; i += EVAL_BATCH_LANES)
+  {
+    area_white = _mm256_load_si256((const __m256i *) (soa->area[0] + i));
+    area_black = _mm256_load_si256((const __m256i *) (soa->area[1] + i));
+    zone_white = _mm256_load_si256((const __m256i *) (soa->zone[0] + i));
+    zone_black = _mm256_load_si256((const __m256i *) (soa->zone[1] + i));
+    num_pieces = _mm_load_si128((const __m128i *) (soa->num_pieces + i));
+    mg = _mm_load_si128((const __m128i *) (soa->positional_mg + i));
+    eg = _mm_load_si128((const __m128i *) (soa->positional_eg + i));
+    attackers_white = attackers_black = weight_white = weight_black = zero;
+
+    for (slots = 0, lane = i; lane < i + EVAL_BATCH_LANES && lane < n; ++lane)
+      if ((size_t) soa->num_pieces[lane] > slots) slots = soa->num_pieces[lane];
+
+    for (slot = 0; slot < slots; ++slot)
+    {
+      // slots past a lane's map become PT_NONE, which weighs nothing
+      active = _mm_cmpgt_epi32(num_pieces, _mm_set1_epi32((int) slot));
+      pt = _mm_and_si128(_mm_load_si128((const __m128i *) (soa->types[slot] + i)), active);
+      attacks = _mm256_load_si256((const __m256i *) (soa->attacks[slot] + i));
+      black = _mm_cmpgt_epi32(pt, black_from);
+      black_wide = _mm256_cvtepi32_epi64(black);
+
+      count = narrow_avx2(popcount_avx2(_mm256_and_si256(attacks, _mm256_blendv_epi8(area_white, area_black, black_wide))));
+      hits  = narrow_avx2(popcount_avx2(_mm256_and_si256(attacks, _mm256_blendv_epi8(zone_black, zone_white, black_wide))));
+
+      base = _mm_sub_epi32(count, _mm_i32gather_epi32(w->mobility_base, pt, 4));
+      mg = _mm_add_epi32(mg, _mm_mullo_epi32(_mm_i32gather_epi32(w->mobility_mg, pt, 4), base));
+      eg = _mm_add_epi32(eg, _mm_mullo_epi32(_mm_i32gather_epi32(w->mobility_eg, pt, 4), base));
+
+      // white pieces bear on the black king, black ones on the white king
+      attacking = _mm_andnot_si128(_mm_cmpeq_epi32(hits, zero), _mm_i32gather_epi32(w->attacker, pt, 4));
+      attack_weight = _mm_mullo_epi32(_mm_i32gather_epi32(w->king_attack, pt, 4), hits);
+      attackers_white = _mm_add_epi32(attackers_white, _mm_and_si128(black, attacking));
+      attackers_black = _mm_add_epi32(attackers_black, _mm_andnot_si128(black, attacking));
+      weight_white = _mm_add_epi32(weight_white, _mm_and_si128(black, attack_weight));
+      weight_black = _mm_add_epi32(weight_black, _mm_andnot_si128(black, attack_weight));
+    }
+
+    mg = _mm_add_epi32(mg, _mm_sub_epi32(king_safety_penalty_avx2(attackers_black, weight_black),
+                                         king_safety_penalty_avx2(attackers_white, weight_white)));
+    mg = _mm_min_epi32(_mm_max_epi32(mg, _mm_sub_epi32(zero, limit)), limit);
+    eg = _mm_min_epi32(_mm_max_epi32(eg, _mm_sub_epi32(zero, limit)), limit);
+    _mm_store_si128((__m128i *) (soa->mg + i), _mm_add_epi32(_mm_load_si128((const __m128i *) (soa->mg + i)), mg));
+    _mm_store_si128((__m128i *) (soa->eg + i), _mm_add_epi32(_mm_load_si128((const __m128i *) (soa->eg + i)), eg));
+  }
+}
+
+static void
+taper_scalar(const struct eval_soa *soa, size_t n, int *out)
+{
+  size_t i;
+  int eg;
+
+  for (i = 0; i < n; ++i)
+  {
+    eg = soa->eg[i] * (soa->eg[i] < 0 ? soa->scale_black[i] : soa->scale_white[i]) / MATERIAL_SCALE_NORMAL;
+    out[i] = soa->sign[i] * ((soa->mg[i] * soa->phase[i] + eg * (EVAL_PHASE_MAX - soa->phase[i])) / EVAL_PHASE_MAX);
+  }
+}
+
+// the products stay below 2^24, so single precision divides them exactly before truncating
+__attribute__((target("avx2"))) // GCC // X86
+static void
+taper_avx2(const struct eval_soa *soa, size_t n, int *out)
+{
+  const __m256 scale_normal = _mm256_set1_ps(MATERIAL_SCALE_NORMAL),
+               phase_max = _mm256_set1_ps(EVAL_PHASE_MAX);
+  const __m256i phase_max_i = _mm256_set1_epi32(EVAL_PHASE_MAX);
+  __m256i mg, eg, phase, scale, sum;
+  int tail[8];
+  size_t i;
+
+  // lanes past `n` compute garbage from the previous block, only the stores are cut short
+  for (i = 0; i < n; i += 8)
+  {
+    mg    = _mm256_load_si256((const __m256i *) (soa->mg + i));
+    eg    = _mm256_load_si256((const __m256i *) (soa->eg + i));
+    phase = _mm256_load_si256((const __m256i *) (soa->phase + i));
+    scale = _mm256_blendv_epi8(_mm256_load_si256((const __m256i *) (soa->scale_white + i)),
+                               _mm256_load_si256((const __m256i *) (soa->scale_black + i)),
+                               _mm256_cmpgt_epi32(_mm256_setzero_si256(), eg));
+    eg = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(_mm256_mullo_epi32(eg, scale)), scale_normal));
+    sum = _mm256_add_epi32(_mm256_mullo_epi32(mg, phase),
+                           _mm256_mullo_epi32(eg, _mm256_sub_epi32(phase_max_i, phase)));
+    sum = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(sum), phase_max));
+    sum = _mm256_sign_epi32(sum, _mm256_load_si256((const __m256i *) (soa->sign + i)));
+
+    if (i + 8 <= n) _mm256_storeu_si256((__m256i *) (out + i), sum);
+    else
+    {
+      _mm256_storeu_si256((__m256i *) tail, sum);
+      memcpy(out + i, tail, (n - i) * sizeof(*out));
+    }
+  }
+}
+
+static positional_fn positional_batch = positional_scalar;
+static taper_fn taper_batch = taper_scalar;
+
+enum CPU_LEVEL
+eval_batch_select_kernels(enum CPU_LEVEL level)
+{
+  if (level > cpu_detect()) level = cpu_detect();
+  // nothing is gained from SSE over the scalar loop, which GCC vectorizes itself
+  if (level >= CPU_AVX2)
+  {
+    positional_batch = positional_avx2;
+    taper_batch = taper_avx2;
+    return CPU_AVX2;
+  }
+  positional_batch = positional_scalar;
+  taper_batch = taper_scalar;
+  return CPU_SCALAR;
+}
+
+// GCC
+__attribute__((constructor)) static void
+eval_batch_init_kernels(void)
+{
+  eval_batch_select_kernels(cpu_detect());
+}
+
+// what the lanes are scored from, white relative; special endings are given the phase of
+// the middlegame and no pieces, so their score passes through unchanged
+static void
+eval_gather(game_state *game, struct eval_soa *soa, size_t i)
+{
+  const struct material_entry *material = material_probe(game->material_key);
+  struct pawn_entry *pawns;
+  struct attack_map map;
+  bitboard area[2], zone[2];
+  size_t slot;
+  int score;
+
+  soa->sign[i] = game->active == COLOR_WHITE ? 1 : -1;
+  soa->scale_white[i] = material->scale[0];
+  soa->scale_black[i] = material->scale[1];
+  soa->positional_mg[i] = soa->positional_eg[i] = soa->num_pieces[i] = 0;
+
+  if (eval_special(game, material, &score))
+  {
+    soa->mg[i] = score;
+    soa->eg[i] = 0;
+    soa->phase[i] = EVAL_PHASE_MAX;
+    return;
+  }
+
+  soa->mg[i] = game->psqt_mg + material->imbalance;
+  soa->eg[i] = game->psqt_eg + material->imbalance;
+  soa->phase[i] = material->phase;
+
+  pawns = pawn_probe(game);
+  soa->positional_mg[i] = pawns->mg + pawns->shield[0] - pawns->shield[1];
+  soa->positional_eg[i] = pawns->eg;
+
+  attack_map_compute(&game->board, &map);
+  eval_mobility_area(&game->board, pawns, area);
+  eval_king_zones(&game->board, zone);
+  soa->area[0][i] = area[0];
+  soa->area[1][i] = area[1];
+  soa->zone[0][i] = zone[0];
+  soa->zone[1][i] = zone[1];
+  soa->num_pieces[i] = map.num_pieces;
+  for (slot = 0; slot < map.num_pieces; ++slot)
+  {
+    soa->types[slot][i] = map.types[slot];
+    soa->attacks[slot][i] = map.attacks[slot];
+  }
+}
+
+void
+eval_batch(game_state *games, size_t count, int *scores)
+{
+  static _Thread_local struct eval_soa soa;
+  struct eval_lane_weights weights;
+  size_t start, n, i;
+
+  if (nnue_is_loaded())
+  {
+    // the network is vectorized within a position already
+    for (i = 0; i < count; ++i) scores[i] = nnue_evaluate_fresh(games + i);
+    return;
+  }
+
+  eval_lane_weights(&weights);
+
+  for (start = 0; start < count; start += n)
+  {
+    n = count - start < EVAL_BATCH_BLOCK ? count - start : EVAL_BATCH_BLOCK;
+    for (i = 0; i < n; ++i) eval_gather(games + start + i, &soa, i);
+    positional_batch(&soa, &weights, n);
+    taper_batch(&soa, n, scores + start);
+  }
+  stats.evaluations += count;
 }
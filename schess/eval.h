@@ -1,8 +1,77 @@
 #ifndef SCHESS_EVAL_H
 #define SCHESS_EVAL_H
 
+#include <schess/cpu.h>
 #include <schess/types.h>
+#include <stddef.h>
+#include <stdint.h>
 
+// game phase of the starting position; 0 is a pawn (or bare king) ending
+#define EVAL_PHASE_MAX 24
+
+/* white relative material + piece-square values, kept incrementally in game_state */
+extern int eval_psqt_mg[PT_COUNT][NUM_SQUARES];
+extern int eval_psqt_eg[PT_COUNT][NUM_SQUARES];
+extern const int eval_phase_inc[PT_COUNT];
+
+void eval_init_tables(void);
+// recomputes the incremental evaluation terms of `game` from scratch
+void eval_refresh(game_state *game);
+
+int eval_piece_value(piece_type type);
+
+/* weights of the classical evaluation, flattened, for the tuner */
+struct eval_param
+{
+  const char *name;
+  int *values;
+  size_t count;
+};
+extern const struct eval_param eval_params[];
+extern const size_t eval_num_params;
+// rebuilds the tables derived from the weights and drops the caches of the calling thread
+void eval_params_changed(void);
+
+/*
+ * the classical evaluation runs in stages: material + piece-square values first, then
+ * pawns, mobility and king safety. the later terms are clamped to EVAL_POSITIONAL_MAX per
+ * phase, so they move the tapered score by at most EVAL_LAZY_MARGIN: a first stage that far
+ * outside the window is returned as is (a lazy exit), the full score would be outside too.
+ */
+#define EVAL_POSITIONAL_MAX 400
+// the clamp, plus one for the rounding of the endgame scale and one for the taper's
+#define EVAL_LAZY_MARGIN (EVAL_POSITIONAL_MAX + 2)
+
+enum EVAL_TERM
+{
+  ET_MATERIAL,
+  ET_PAWNS,
+  ET_MOBILITY,
+  ET_KING_SAFETY,
+  ET_COUNT
+};
+
+struct eval_stats
+{
+  uint64_t evaluations, lazy_exits;
+  uint64_t cycles[ET_COUNT]; // per term, only counted when built with SCHESS_EVAL_STATS
+};
+
+// score from the point of view of the side to move; uses the network while one is attached
 int eval_position(game_state *game, irreversable_state meta);
+// same, but may return a bound once the score is clearly outside [alpha, beta]
+int eval_position_window(game_state *game, irreversable_state meta, int alpha, int beta);
+
+/*
+ * scores `count` positions from the point of view of their side to move, without the
+ * cache or a window. with a network loaded, each position is evaluated from scratch.
+ */
+void eval_batch(game_state *games, size_t count, int *scores);
+// kernels used by eval_batch; returns the level actually in use
+enum CPU_LEVEL eval_batch_select_kernels(enum CPU_LEVEL level);
+
+// counters of the calling thread
+struct eval_stats eval_stats(void);
+void eval_stats_reset(void);
 
 #endif // SCHESS_EVAL_H
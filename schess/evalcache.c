@@ -0,0 +1,91 @@
+#include <schess/evalcache.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct eval_cache_entry
+{
+  uint64_t check; // key ^ data
+  uint64_t data;
+};
+
+static struct eval_cache_entry *table;
+static size_t mask;
+
+static _Thread_local struct eval_cache_stats stats;
+
+int
+eval_cache_resize(size_t megabytes)
+{
+  size_t entries = 1;
+
+  free(table);
+  table = NULL;
+  mask = 0;
+  if (!megabytes) return 0;
+
+  // largest power of two that fits
+  while (entries * 2 * sizeof(struct eval_cache_entry) <= (megabytes << 20)) entries *= 2;
+
+  table = calloc(entries, sizeof(struct eval_cache_entry));
+  if (!table) return 1;
+  mask = entries - 1;
+  return 0;
+}
+
+void
+eval_cache_clear(void)
+{
+  if (table) memset(table, 0, (mask + 1) * sizeof(struct eval_cache_entry));
+}
+
+// GCC
+__attribute__((constructor)) static void
+eval_cache_init(void)
+{
+  eval_cache_resize(EVAL_CACHE_DEFAULT_MB);
+}
+
+int
+eval_cache_probe(uint64_t key, int *score)
+{
+  struct eval_cache_entry *e;
+  uint64_t check, data;
+
+  if (!table) return 0;
+  ++stats.probes;
+
+  e = &table[key & mask];
+  check = __atomic_load_n(&e->check, __ATOMIC_RELAXED); // GCC
+  data  = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+  // key 0 would hit the empty entries
+  if ((check ^ data) != key || !key) return 0;
+
+  ++stats.hits;
+  *score = (int32_t) (uint32_t) data;
+  return 1;
+}
+
+void
+eval_cache_store(uint64_t key, int score)
+{
+  struct eval_cache_entry *e;
+  uint64_t data = (uint32_t) score;
+
+  if (!table) return;
+
+  e = &table[key & mask];
+  __atomic_store_n(&e->check, key ^ data, __ATOMIC_RELAXED); // GCC
+  __atomic_store_n(&e->data, data, __ATOMIC_RELAXED);
+}
+
+struct eval_cache_stats
+eval_cache_stats(void)
+{
+  return stats;
+}
+
+void
+eval_cache_stats_reset(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
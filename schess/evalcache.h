@@ -0,0 +1,30 @@
+#ifndef SCHESS_EVALCACHE_H
+#define SCHESS_EVALCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EVAL_CACHE_DEFAULT_MB 4
+
+struct eval_cache_stats
+{
+  uint64_t probes, hits;
+};
+
+/*
+ * shared between threads without locks; an entry stores its key xor its data,
+ * so a torn write fails verification instead of returning a wrong score
+ */
+// resizes and clears the cache; 0 disables it. returns 0 on success
+int eval_cache_resize(size_t megabytes);
+void eval_cache_clear(void);
+
+// returns 1 and sets `score` if `key` is cached
+int eval_cache_probe(uint64_t key, int *score);
+void eval_cache_store(uint64_t key, int score);
+
+// counters of the calling thread
+struct eval_cache_stats eval_cache_stats(void);
+void eval_cache_stats_reset(void);
+
+#endif // SCHESS_EVALCACHE_H
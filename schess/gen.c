@@ -1,36 +1,20 @@
+#include <schess/cpu.h>
 #include <schess/gen.h>
+#include <schess/kpk.h>
 #include <schess/lut.h>
+#include <schess/serialize.h>
 #include <schess/types.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
 #include <x86intrin.h>
 
-static bitboard attack_table[LUT_BISHOP_SIZE + LUT_ROOK_SIZE];
-
-static bitboard rook_mask[NUM_SQUARES];
-static size_t rook_offset[NUM_SQUARES];
-static inline bitboard
-rook_attacks(bitboard occ, square sq)
-{
-  // X86
-  return attack_table[rook_offset[sq] + _pext_u64(occ, rook_mask[sq])];
-}
-
-static bitboard bishop_mask[NUM_SQUARES];
-static size_t bishop_offset[NUM_SQUARES];
-static inline bitboard
-bishop_attacks(bitboard occ, square sq)
-{
-  // X86
-  return attack_table[bishop_offset[sq] + _pext_u64(occ, bishop_mask[sq])];
-}
-
-static inline bitboard
-queen_attacks(bitboard occ, square sq)
-{
-  return rook_attacks(occ, sq) | bishop_attacks(occ, sq);
-}
+bitboard attack_table[LUT_BISHOP_SIZE + LUT_ROOK_SIZE];
+bitboard rook_mask[NUM_SQUARES];
+size_t rook_offset[NUM_SQUARES];
+bitboard bishop_mask[NUM_SQUARES];
+size_t bishop_offset[NUM_SQUARES];
 
 // TODO: rewrite
 static inline square
@@ -65,48 +49,29 @@ move_buffer_append_move(square from, square to, piece_type capture, enum MOVE_TY
 static inline void
 move_buffer_append_attacks(bitboard attacks, square from, piece_type types[NUM_SQUARES], struct move_buffer *out)
 {
-  square to;
-
-  while (attacks)
-  {
-    to = pop_bit(&attacks);
-
-    move_buffer_append_move(from, to, types[to], MT_NORMAL, out);
-  }
+  out->size += serialize_targets(attacks, from, types, out->moves + out->size);
 }
 
 static inline void
-generate_rook_moves(bitboard own, bitboard other, square sq, piece_type types[NUM_SQUARES], struct move_buffer *out)
+move_set_append_origin(square from, bitboard targets, struct move_set *out)
 {
-  bitboard occ = own | other;
-  bitboard attacks = rook_attacks(occ, sq) & ~own;
-  move_buffer_append_attacks(attacks, sq, types, out);
-}
-static inline void
-generate_bishop_moves(bitboard own, bitboard other, square sq, piece_type types[NUM_SQUARES], struct move_buffer *out)
-{
-  bitboard occ = own | other;
-  bitboard attacks = bishop_attacks(occ, sq) & ~own;
-  move_buffer_append_attacks(attacks, sq, types, out);
-}
-static inline void
-generate_queen_moves(bitboard own, bitboard other, square sq, piece_type types[NUM_SQUARES], struct move_buffer *out)
-{
-  bitboard occ = own | other;
-  bitboard attacks = queen_attacks(occ, sq) & ~own;
-  move_buffer_append_attacks(attacks, sq, types, out);
+  out->origins[out->num_origins] = from;
+  out->targets[out->num_origins] = targets;
+  ++out->num_origins;
 }
 
-static bitboard knight_attacks[NUM_SQUARES];
 static inline void
-generate_knight_moves(bitboard own, bitboard other, square sq, piece_type types[NUM_SQUARES], struct move_buffer *out)
+move_set_append_special(square from, square to, enum MOVE_TYPE type, struct move_set *out)
 {
-  (void) other;
-  bitboard attacks = knight_attacks[sq] & ~own;
-  move_buffer_append_attacks(attacks, sq, types, out);
+  out->specials[out->num_specials].from    = from;
+  out->specials[out->num_specials].to      = to;
+  out->specials[out->num_specials].capture = PT_NONE;
+  out->specials[out->num_specials].type    = type;
+  ++out->num_specials;
 }
 
-static bitboard king_attacks[NUM_SQUARES];
+bitboard knight_attacks[NUM_SQUARES];
+bitboard king_attacks[NUM_SQUARES];
 static inline int
 is_square_checked(bitboard own, bitboard other, bitboard other_pieces[6], bitboard other_pawn_attacks, square sq)
 {
@@ -126,11 +91,10 @@ is_square_checked(bitboard own, bitboard other, bitboard other_pieces[6], bitboa
 
 
 static inline void
-generate_king_moves(bitboard own, bitboard other, bitboard other_pieces[6], bitboard other_pawn_attacks, square sq, piece_type types[NUM_SQUARES], irreversable_state meta, struct move_buffer *out)
+generate_king_moves(bitboard own, bitboard other, bitboard other_pieces[6], bitboard other_pawn_attacks, square sq, irreversable_state meta, struct move_set *out)
 {
   bitboard occ = own | other;
-  bitboard attacks = king_attacks[sq] & ~own;
-  move_buffer_append_attacks(attacks, sq, types, out);
+  move_set_append_origin(sq, king_attacks[sq] & ~own, out);
 
   // is king checked?
   if (is_square_checked(own, other, other_pieces, other_pawn_attacks, sq)) return;
@@ -142,13 +106,13 @@ generate_king_moves(bitboard own, bitboard other, bitboard other_pieces[6], bitb
       !is_square_checked(own, other, other_pieces, other_pawn_attacks, sq + 1) &&
       !(occ & (sq2bb(sq + 1) | sq2bb(sq + 2))))
   {
-    move_buffer_append_move(sq, sq + 2, PT_NONE, MT_CASTLE_KING, out);
+    move_set_append_special(sq, sq + 2, MT_CASTLE_KING, out);
   }
   if (castle_west & meta.castling_rights &&
       !is_square_checked(own, other, other_pieces, other_pawn_attacks, sq - 1) &&
       !(occ & (sq2bb(sq - 1) | sq2bb(sq - 2) | sq2bb(sq - 3))))
   {
-    move_buffer_append_move(sq, sq - 2, PT_NONE, MT_CASTLE_QUEEN, out);
+    move_set_append_special(sq, sq - 2, MT_CASTLE_QUEEN, out);
   }
 }
 
@@ -168,204 +132,488 @@ move_buffer_append_promotions(square from, square to, piece_type capture, struct
   move_buffer_append_move(from, to, capture, MT_PROMOTION_QUEEN, out);
 }
 
-static inline void
-generate_pawn_moves_white(bitboard own, bitboard other, bitboard pieces, piece_type types[NUM_SQUARES], bitboard en_passant_potential, struct move_buffer *out)
+/* color relative pawn geometry; folded to constants by the specialized generators */
+ALWAYS_INLINE bitboard
+pawn_push(bitboard b, const color us) { return us == COLOR_WHITE ? b << 0x8 : b >> 0x8; }
+ALWAYS_INLINE bitboard
+pawn_east_attacks(bitboard b, const color us) { return (us == COLOR_WHITE ? b << 0x9 : b >> 0x7) & ~a_file; }
+ALWAYS_INLINE bitboard
+pawn_west_attacks(bitboard b, const color us) { return (us == COLOR_WHITE ? b << 0x7 : b >> 0x9) & ~h_file; }
+
+#define PAWN_PUSH(us)        ((us) == COLOR_WHITE ? 0x8 : -0x8)
+#define PAWN_EAST(us)        ((us) == COLOR_WHITE ? 0x9 : -0x7)
+#define PAWN_WEST(us)        ((us) == COLOR_WHITE ? 0x7 : -0x9)
+#define PAWN_DOUBLE_RANK(us) ((us) == COLOR_WHITE ? rank_4 : rank_5)
+#define PAWN_PROMO_RANK(us)  ((us) == COLOR_WHITE ? rank_8 : rank_1)
+
+ALWAYS_INLINE void
+generate_pawn_moves(bitboard own, bitboard other, bitboard pieces, bitboard en_passant_potential, const color us, struct move_set *out)
 {
   bitboard occ = own | other,
-           singles = (pieces  << 0x8) & ~occ,
-           doubles = (singles << 0x8) & ~occ & rank_4,
-           east_captures = (pieces << 0x9) & ~a_file & other,
-           west_captures = (pieces << 0x7) & ~h_file & other;
-
-  square from, to;
+           singles = pawn_push(pieces, us) & ~occ,
+           doubles = pawn_push(singles, us) & ~occ & PAWN_DOUBLE_RANK(us),
+           east_captures = pawn_east_attacks(pieces, us) & other,
+           west_captures = pawn_west_attacks(pieces, us) & other;
 
   bitboard en_passant_east = (en_passant_potential >> 0x1) & ~h_file & pieces;
   if (en_passant_east) // en passant east
   {
-    from = log_bit(en_passant_potential >> 0x1);
-    to   = log_bit(en_passant_potential << 0x8);
-    move_buffer_append_move(from, to, PT_NONE, MT_EN_PASSANT, out);
+    move_set_append_special(log_bit(en_passant_potential >> 0x1),
+        log_bit(pawn_push(en_passant_potential, us)), MT_EN_PASSANT, out);
   }
   bitboard en_passant_west = (en_passant_potential << 0x1) & ~a_file & pieces;
   if (en_passant_west) // en passant west
   {
-    from = log_bit(en_passant_potential << 0x1);
-    to   = log_bit(en_passant_potential << 0x8);
-    move_buffer_append_move(from, to, PT_NONE, MT_EN_PASSANT, out);
+    move_set_append_special(log_bit(en_passant_potential << 0x1),
+        log_bit(pawn_push(en_passant_potential, us)), MT_EN_PASSANT, out);
   }
 
-  while (singles)
-  {
-    to = pop_bit(&singles);
-    from = to - 0x8;
-    if (sq2bb(to) & ~rank_8) // no promotion
-    {
-      move_buffer_append_move(from, to, PT_NONE, MT_NORMAL, out);
-    }
-    else // promotion
-    {
-      move_buffer_append_promotions(from, to, PT_NONE, out);
-    }
+  out->pawn_targets[PS_SINGLE]       = singles & ~PAWN_PROMO_RANK(us);
+  out->pawn_targets[PS_DOUBLE]       = doubles;
+  out->pawn_targets[PS_EAST]         = east_captures & ~PAWN_PROMO_RANK(us);
+  out->pawn_targets[PS_WEST]         = west_captures & ~PAWN_PROMO_RANK(us);
+  out->pawn_targets[PS_SINGLE_PROMO] = singles & PAWN_PROMO_RANK(us);
+  out->pawn_targets[PS_EAST_PROMO]   = east_captures & PAWN_PROMO_RANK(us);
+  out->pawn_targets[PS_WEST_PROMO]   = west_captures & PAWN_PROMO_RANK(us);
+
+  out->pawn_offsets[PS_SINGLE]       = PAWN_PUSH(us);
+  out->pawn_offsets[PS_DOUBLE]       = 2 * PAWN_PUSH(us);
+  out->pawn_offsets[PS_EAST]         = PAWN_EAST(us);
+  out->pawn_offsets[PS_WEST]         = PAWN_WEST(us);
+  out->pawn_offsets[PS_SINGLE_PROMO] = PAWN_PUSH(us);
+  out->pawn_offsets[PS_EAST_PROMO]   = PAWN_EAST(us);
+  out->pawn_offsets[PS_WEST_PROMO]   = PAWN_WEST(us);
+}
+
+
+ALWAYS_INLINE void
+generate_move_set_color(game_state *game, irreversable_state meta, const color us, struct move_set *out)
+{
+  board_state *board = &game->board;
+  const color them = OTHER_COLOR(us);
+  bitboard *own = board->bitboards + us,
+           *other = board->bitboards + them;
+  bitboard own_union = own[PR_P] | own[PR_N] | own[PR_B] | own[PR_R] | own[PR_Q] | own[PR_K];
+  bitboard other_union = other[PR_P] | other[PR_N] | other[PR_B] | other[PR_R] | other[PR_Q] | other[PR_K];
+  bitboard occ = own_union | other_union;
+
+  bitboard copy;
+  square from;
+#define GENERATE_ALL_TARGETS(pieces, attacks) \
+  copy = pieces; \
+  while (copy) \
+  { \
+    from = pop_bit(&copy); \
+    move_set_append_origin(from, (attacks) & ~own_union, out); \
   }
-  while (doubles)
+
+  out->num_origins = out->num_specials = out->cursor = 0;
+  out->promotion = MT_PROMOTION_KNIGHT;
+
+  // generate sliding moves
+  GENERATE_ALL_TARGETS(own[PR_B], bishop_attacks(occ, from));
+  GENERATE_ALL_TARGETS(own[PR_R], rook_attacks(occ, from));
+  GENERATE_ALL_TARGETS(own[PR_Q], queen_attacks(occ, from));
+
+  GENERATE_ALL_TARGETS(own[PR_N], knight_attacks[from]);
+
+#undef GENERATE_ALL_TARGETS
+
+  generate_pawn_moves(own_union, other_union, own[PR_P], meta.en_passant_potential, us, out);
+
+  bitboard other_pawn_attacks = pawn_east_attacks(other[PR_P], them) | pawn_west_attacks(other[PR_P], them);
+  // TODO: may fail if king dead
+  generate_king_moves(own_union, other_union, other, other_pawn_attacks, log_bit(own[PR_K]), meta, out);
+}
+
+void
+generate_move_set_white(game_state *game, irreversable_state meta, struct move_set *out)
+{
+  generate_move_set_color(game, meta, COLOR_WHITE, out);
+}
+void
+generate_move_set_black(game_state *game, irreversable_state meta, struct move_set *out)
+{
+  generate_move_set_color(game, meta, COLOR_BLACK, out);
+}
+void
+generate_move_set(game_state *game, irreversable_state meta, struct move_set *out)
+{
+  if (game->active == COLOR_WHITE) generate_move_set_white(game, meta, out);
+  else generate_move_set_black(game, meta, out);
+}
+
+size_t
+move_set_count(const struct move_set *set)
+{
+  size_t i, count = set->num_specials;
+
+  // GCC
+  for (i = set->cursor; i < set->num_origins; ++i)
+    count += __builtin_popcountll(set->targets[i]);
+
+  count += __builtin_popcountll(set->pawn_targets[PS_SINGLE]);
+  count += __builtin_popcountll(set->pawn_targets[PS_DOUBLE]);
+  count += __builtin_popcountll(set->pawn_targets[PS_EAST]);
+  count += __builtin_popcountll(set->pawn_targets[PS_WEST]);
+  count += __builtin_popcountll(set->pawn_targets[PS_SINGLE_PROMO]) * 4;
+  count += __builtin_popcountll(set->pawn_targets[PS_EAST_PROMO]) * 4;
+  count += __builtin_popcountll(set->pawn_targets[PS_WEST_PROMO]) * 4;
+
+  return count;
+}
+
+int
+move_set_next(struct move_set *set, piece_type types[NUM_SQUARES], move *out)
+{
+  square to;
+  enum PAWN_SET ps;
+
+  for (; set->cursor < set->num_origins; ++set->cursor)
   {
-    to = pop_bit(&doubles);
-    from = to - 0x10;
-    move_buffer_append_move(from, to, PT_NONE, MT_DOUBLE_PAWN, out);
+    if (!set->targets[set->cursor]) continue;
+
+    to = pop_bit(&set->targets[set->cursor]);
+    *out = (move) { set->origins[set->cursor], to, types[to], MT_NORMAL };
+    return 1;
   }
-  while (east_captures)
+
+  for (ps = PS_SINGLE; ps < PS_SINGLE_PROMO; ++ps)
   {
-    to = pop_bit(&east_captures);
-    from = to - 0x9;
-    if (sq2bb(to) & ~rank_8) // no promotion
-    {
-      move_buffer_append_move(from, to, types[to], MT_NORMAL, out);
-    }
-    else // promotion
-    {
-      move_buffer_append_promotions(from, to, types[to], out);
-    }
+    if (!set->pawn_targets[ps]) continue;
+
+    to = pop_bit(&set->pawn_targets[ps]);
+    *out = (move) { to - set->pawn_offsets[ps], to, types[to], ps == PS_DOUBLE ? MT_DOUBLE_PAWN : MT_NORMAL };
+    return 1;
   }
-  while (west_captures)
+
+  for (; ps < PS_COUNT; ++ps)
   {
-    to = pop_bit(&west_captures);
-    from = to - 0x7;
-    if (sq2bb(to) & ~rank_8) // no promotion
-    {
-      move_buffer_append_move(from, to, types[to], MT_NORMAL, out);
-    }
-    else // promotion
+    if (!set->pawn_targets[ps]) continue;
+
+    // the target is kept until every promotion piece has been emitted
+    to = log_bit(set->pawn_targets[ps]);
+    *out = (move) { to - set->pawn_offsets[ps], to, types[to], set->promotion };
+    if (set->promotion++ == MT_PROMOTION_QUEEN)
     {
-      move_buffer_append_promotions(from, to, types[to], out);
+      set->pawn_targets[ps] ^= sq2bb(to);
+      set->promotion = MT_PROMOTION_KNIGHT;
     }
+    return 1;
   }
+
+  if (!set->num_specials) return 0;
+
+  *out = set->specials[--set->num_specials];
+  return 1;
 }
 
-static inline void
-generate_pawn_moves_black(bitboard own, bitboard other, bitboard pieces, piece_type types[NUM_SQUARES], bitboard en_passant_potential, struct move_buffer *out)
+int
+move_set_contains(const struct move_set *set, const move *m)
 {
-  bitboard occ = own | other,
-           singles = (pieces  >> 0x8) & ~occ,
-           doubles = (singles >> 0x8) & ~occ & rank_5,
-           east_captures = (pieces >> 0x7) & ~a_file & other,
-           west_captures = (pieces >> 0x9) & ~h_file & other;
+  enum PAWN_SET ps;
+  size_t i;
 
-  square from, to;
+  if (m->type == MT_NULL) return 0;
 
-  bitboard en_passant_east = (en_passant_potential >> 0x1) & ~h_file & pieces;
-  if (en_passant_east) // en passant east
-  {
-    from = log_bit(en_passant_potential >> 0x1);
-    to   = log_bit(en_passant_potential >> 0x8);
-    move_buffer_append_move(from, to, PT_NONE, MT_EN_PASSANT, out);
-  }
-  bitboard en_passant_west = (en_passant_potential << 0x1) & ~a_file & pieces;
-  if (en_passant_west) // en passant west
+  for (i = 0; i < set->num_specials; ++i)
+    if (set->specials[i].from == m->from && set->specials[i].to == m->to && set->specials[i].type == m->type) return 1;
+  if (m->type == MT_EN_PASSANT || m->type == MT_CASTLE_KING || m->type == MT_CASTLE_QUEEN) return 0;
+
+  for (i = set->cursor; i < set->num_origins; ++i)
+    if (set->origins[i] == m->from) return m->type == MT_NORMAL && (set->targets[i] & sq2bb(m->to));
+
+  // pawns: the set is the one of the move type whose offset leads back to `from`
+  for (ps = PS_SINGLE; ps < PS_COUNT; ++ps)
   {
-    from = log_bit(en_passant_potential << 0x1);
-    to   = log_bit(en_passant_potential >> 0x8);
-    move_buffer_append_move(from, to, PT_NONE, MT_EN_PASSANT, out);
+    if (!(set->pawn_targets[ps] & sq2bb(m->to)) || (int) m->to - set->pawn_offsets[ps] != (int) m->from) continue;
+    if (ps == PS_DOUBLE) return m->type == MT_DOUBLE_PAWN;
+    if (ps < PS_SINGLE_PROMO) return m->type == MT_NORMAL;
+    return m->type >= MT_PROMOTION_KNIGHT && m->type <= MT_PROMOTION_QUEEN;
   }
+  return 0;
+}
+
+size_t
+move_set_serialize(struct move_set *set, piece_type types[NUM_SQUARES], struct move_buffer *out)
+{
+  size_t i;
+  square to;
+  enum PAWN_SET ps;
 
-  while (singles)
+  out->size = 0;
+
+  for (i = set->cursor; i < set->num_origins; ++i)
+    move_buffer_append_attacks(set->targets[i], set->origins[i], types, out);
+
+  for (ps = PS_SINGLE; ps < PS_SINGLE_PROMO; ++ps)
   {
-    to = pop_bit(&singles);
-    from = to + 0x8;
-    if (sq2bb(to) & ~rank_1) // no promotion
+    while (set->pawn_targets[ps])
     {
-      move_buffer_append_move(from, to, PT_NONE, MT_NORMAL, out);
+      to = pop_bit(&set->pawn_targets[ps]);
+      move_buffer_append_move(to - set->pawn_offsets[ps], to, types[to], ps == PS_DOUBLE ? MT_DOUBLE_PAWN : MT_NORMAL, out);
     }
-    else // promotion
-    {
-      move_buffer_append_promotions(from, to, PT_NONE, out);
-    }
-  }
-  while (doubles)
-  {
-    to = pop_bit(&doubles);
-    from = to + 0x10;
-    move_buffer_append_move(from, to, PT_NONE, MT_DOUBLE_PAWN, out);
   }
-  while (east_captures)
+  for (; ps < PS_COUNT; ++ps)
   {
-    to = pop_bit(&east_captures);
-    from = to + 0x7;
-    if (sq2bb(to) & ~rank_1) // no promotion
+    while (set->pawn_targets[ps])
     {
-      move_buffer_append_move(from, to, types[to], MT_NORMAL, out);
-    }
-    else // promotion
-    {
-      move_buffer_append_promotions(from, to, types[to], out);
+      to = pop_bit(&set->pawn_targets[ps]);
+      move_buffer_append_promotions(to - set->pawn_offsets[ps], to, types[to], out);
     }
   }
-  while (west_captures)
+
+  for (i = 0; i < set->num_specials; ++i)
+    out->moves[out->size++] = set->specials[i];
+
+  set->cursor = set->num_origins;
+  set->num_specials = 0;
+  return out->size;
+}
+
+
+ALWAYS_INLINE size_t
+generate_moves_color(game_state *game, irreversable_state meta, const color us, struct move_buffer *out)
+{
+  struct move_set set;
+
+  generate_move_set_color(game, meta, us, &set);
+  return move_set_serialize(&set, game->board.types, out);
+}
+
+size_t
+generate_moves_white(game_state *game, irreversable_state meta, struct move_buffer *out)
+{
+  return generate_moves_color(game, meta, COLOR_WHITE, out);
+}
+size_t
+generate_moves_black(game_state *game, irreversable_state meta, struct move_buffer *out)
+{
+  return generate_moves_color(game, meta, COLOR_BLACK, out);
+}
+size_t
+generate_moves(game_state *game, irreversable_state meta, struct move_buffer *out)
+{
+  return game->active == COLOR_WHITE
+    ? generate_moves_white(game, meta, out)
+    : generate_moves_black(game, meta, out);
+}
+
+/* CHECKS */
+// full line through two aligned squares and the squares strictly between them; empty if not aligned
+static bitboard line_bb[NUM_SQUARES][NUM_SQUARES];
+static bitboard between_bb[NUM_SQUARES][NUM_SQUARES];
+
+static void
+init_lines(void)
+{
+  square a, b;
+
+  for (a = a1; a < NUM_SQUARES; ++a)
   {
-    to = pop_bit(&west_captures);
-    from = to + 0x9;
-    if (sq2bb(to) & ~rank_1) // no promotion
+    for (b = a1; b < NUM_SQUARES; ++b)
     {
-      move_buffer_append_move(from, to, types[to], MT_NORMAL, out);
-    }
-    else // promotion
-    {
-      move_buffer_append_promotions(from, to, types[to], out);
+      line_bb[a][b] = between_bb[a][b] = 0;
+      if (a == b) continue;
+
+      if (bishop_attacks(0, a) & sq2bb(b))
+      {
+        line_bb[a][b]    = (bishop_attacks(0, a) & bishop_attacks(0, b)) | sq2bb(a) | sq2bb(b);
+        between_bb[a][b] = bishop_attacks(sq2bb(b), a) & bishop_attacks(sq2bb(a), b);
+      }
+      if (rook_attacks(0, a) & sq2bb(b))
+      {
+        line_bb[a][b]    = (rook_attacks(0, a) & rook_attacks(0, b)) | sq2bb(a) | sq2bb(b);
+        between_bb[a][b] = rook_attacks(sq2bb(b), a) & rook_attacks(sq2bb(a), b);
+      }
     }
   }
 }
 
-
-size_t
-generate_moves(game_state *game, irreversable_state meta, struct move_buffer *out)
+ALWAYS_INLINE void
+check_info_init_color(board_state *board, const color us, struct check_info *out)
 {
-  board_state *board = &game->board;
-  color color_own = game->active,
-        color_other = OTHER_COLOR(color_own);
-  bitboard *own = board->bitboards + color_own,
-           *other = board->bitboards + color_other;
+  const color them = OTHER_COLOR(us);
+  bitboard *own = board->bitboards + us;
   bitboard own_union = own[PR_P] | own[PR_N] | own[PR_B] | own[PR_R] | own[PR_Q] | own[PR_K];
-  bitboard other_union = other[PR_P] | other[PR_N] | other[PR_B] | other[PR_R] | other[PR_Q] | other[PR_K];
+  bitboard snipers, blockers;
+  square ksq, sniper;
+
+  out->occ  = own_union;
+  out->occ |= board->bitboards[them + PR_P] | board->bitboards[them + PR_N] | board->bitboards[them + PR_B];
+  out->occ |= board->bitboards[them + PR_R] | board->bitboards[them + PR_Q] | board->bitboards[them + PR_K];
+  out->king = ksq = log_bit(board->bitboards[them + PR_K]);
+
+  // a piece of ours checks from the squares it would attack from the king's square
+  out->squares[PR_P] = pawn_east_attacks(sq2bb(ksq), them) | pawn_west_attacks(sq2bb(ksq), them);
+  out->squares[PR_N] = knight_attacks[ksq];
+  out->squares[PR_B] = bishop_attacks(out->occ, ksq);
+  out->squares[PR_R] = rook_attacks(out->occ, ksq);
+  out->squares[PR_Q] = out->squares[PR_B] | out->squares[PR_R];
+  out->squares[PR_K] = 0;
+
+  // own pieces standing alone between one of our sliders and the king discover check when they leave the line
+  out->discoverers = 0;
+  snipers  = rook_attacks(0, ksq)   & (own[PR_R] | own[PR_Q]);
+  snipers |= bishop_attacks(0, ksq) & (own[PR_B] | own[PR_Q]);
+  while (snipers)
+  {
+    sniper = pop_bit(&snipers);
+    blockers = between_bb[ksq][sniper] & out->occ;
+    if (blockers && !(blockers & (blockers - 1)) && (blockers & own_union))
+      out->discoverers |= blockers;
+  }
+}
 
-  bitboard copy;
-#define GENERATE_ALL_MOVES(PT, own, other, pieces, types, out) \
-  copy = pieces; \
-  while (copy) \
-  { \
-    square from = pop_bit(&copy); \
-    generate_## PT ##_moves(own, other, from, types, out); \
+ALWAYS_INLINE int
+gives_check_color(board_state *board, const struct check_info *ci, const move *m, const color us)
+{
+  bitboard *own = board->bitboards + us;
+  bitboard occ;
+  square rook_from, rook_to;
+
+  if (sq2bb(m->to) & ci->squares[board->types[m->from] - us]) return 1;
+  if ((ci->discoverers & sq2bb(m->from)) && !(line_bb[ci->king][m->from] & sq2bb(m->to))) return 1;
+
+  switch (m->type)
+  {
+  case MT_NORMAL:
+  case MT_DOUBLE_PAWN:
+  case MT_NULL:
+    return 0;
+
+  case MT_PROMOTION_KNIGHT:
+    return (knight_attacks[m->to] & sq2bb(ci->king)) != 0;
+  case MT_PROMOTION_BISHOP:
+    return (bishop_attacks(ci->occ ^ sq2bb(m->from), m->to) & sq2bb(ci->king)) != 0;
+  case MT_PROMOTION_ROOK:
+    return (rook_attacks(ci->occ ^ sq2bb(m->from), m->to) & sq2bb(ci->king)) != 0;
+  case MT_PROMOTION_QUEEN:
+    return (queen_attacks(ci->occ ^ sq2bb(m->from), m->to) & sq2bb(ci->king)) != 0;
+
+  case MT_EN_PASSANT:
+    // the captured pawn may uncover a line the moving pawn did not
+    occ = ci->occ ^ sq2bb(m->from) ^ sq2bb(m->to) ^ sq2bb(m->to - PAWN_PUSH(us));
+    return ((rook_attacks(occ, ci->king)   & (own[PR_R] | own[PR_Q])) |
+            (bishop_attacks(occ, ci->king) & (own[PR_B] | own[PR_Q]))) != 0;
+
+  case MT_CASTLE_KING:
+  case MT_CASTLE_QUEEN:
+    rook_from = m->type == MT_CASTLE_KING ? m->to + 1 : m->to - 2;
+    rook_to   = m->type == MT_CASTLE_KING ? m->from + 1 : m->from - 1;
+    occ = ci->occ ^ sq2bb(m->from) ^ sq2bb(m->to) ^ sq2bb(rook_from) ^ sq2bb(rook_to);
+    return (rook_attacks(occ, rook_to) & sq2bb(ci->king)) != 0;
   }
 
-  out->size = 0;
+  return 0;
+}
 
-  // generate sliding moves
-  GENERATE_ALL_MOVES(bishop, own_union, other_union, own[PR_B], board->types, out);
-  GENERATE_ALL_MOVES(rook, own_union, other_union, own[PR_R], board->types, out);
-  GENERATE_ALL_MOVES(queen, own_union, other_union, own[PR_Q], board->types, out);
+ALWAYS_INLINE size_t
+generate_checks_color(game_state *game, irreversable_state meta, const int quiet, const color us, struct move_buffer *out)
+{
+  board_state *board = &game->board;
+  const color them = OTHER_COLOR(us);
+  struct move_set set;
+  struct check_info ci;
+  bitboard other_union, excluded, mask, pawn_discoverers, copy, promos[PS_COUNT];
+  move specials[MAX_SPECIALS_NUM], m;
+  size_t i, num_specials;
+  enum PAWN_SET ps;
+  enum MOVE_TYPE type;
+  square from, to;
+
+  COLORED(generate_move_set, us)(game, meta, &set);
+  check_info_init_color(board, us, &ci);
+
+  other_union  = board->bitboards[them + PR_P] | board->bitboards[them + PR_N] | board->bitboards[them + PR_B];
+  other_union |= board->bitboards[them + PR_R] | board->bitboards[them + PR_Q] | board->bitboards[them + PR_K];
+  excluded = quiet ? other_union : 0;
+
+  for (i = 0; i < set.num_origins; ++i)
+  {
+    from = set.origins[i];
+    mask = ci.squares[board->types[from] - us];
+    if (ci.discoverers & sq2bb(from)) mask |= ~line_bb[ci.king][from];
+    set.targets[i] &= mask & ~excluded;
+  }
+
+  pawn_discoverers = ci.discoverers & board->bitboards[us + PR_P];
+  for (ps = PS_SINGLE; ps < PS_SINGLE_PROMO; ++ps)
+  {
+    mask = ci.squares[PR_P];
+    for (copy = pawn_discoverers; copy;)
+    {
+      from = pop_bit(&copy);
+      to = from + set.pawn_offsets[ps];
+      if (!(line_bb[ci.king][from] & sq2bb(to))) mask |= sq2bb(to);
+    }
+    set.pawn_targets[ps] &= mask & ~excluded;
+  }
 
-  GENERATE_ALL_MOVES(knight, own_union, other_union, own[PR_N], board->types, out);
+  // promotions, en passant and castling are rare enough to be tested one by one
+  for (ps = PS_SINGLE_PROMO; ps < PS_COUNT; ++ps)
+  {
+    promos[ps] = quiet ? 0 : set.pawn_targets[ps];
+    set.pawn_targets[ps] = 0;
+  }
+  num_specials = set.num_specials;
+  for (i = 0; i < num_specials; ++i) specials[i] = set.specials[i];
+  set.num_specials = 0;
 
-#undef GENERATE_ALL_MOVES
+  move_set_serialize(&set, board->types, out);
 
-  bitboard other_pawn_attacks;
-  if (color_own == COLOR_WHITE) // white's move
+  for (ps = PS_SINGLE_PROMO; ps < PS_COUNT; ++ps)
   {
-    generate_pawn_moves_white(own_union, other_union, board->bitboards[PT_WP], board->types, game->en_passant_potential, out);
-    other_pawn_attacks  = (other[PR_P] >> 9) & ~h_file;
-    other_pawn_attacks |= (other[PR_P] >> 7) & ~a_file;
-    // TODO: may fail if king dead
-    generate_king_moves(own_union, other_union, other, other_pawn_attacks, log_bit(own[PR_K]), board->types, meta, out);
+    while (promos[ps])
+    {
+      to = pop_bit(&promos[ps]);
+      for (type = MT_PROMOTION_KNIGHT; type <= MT_PROMOTION_QUEEN; ++type)
+      {
+        m = (move) { to - set.pawn_offsets[ps], to, board->types[to], type };
+        if (gives_check_color(board, &ci, &m, us)) out->moves[out->size++] = m;
+      }
+    }
   }
-  else // black's move
+  for (i = 0; i < num_specials; ++i)
   {
-    generate_pawn_moves_black(own_union, other_union, board->bitboards[PT_BP], board->types, game->en_passant_potential, out);
-    other_pawn_attacks  = (other[PR_P] << 7) & ~h_file;
-    other_pawn_attacks |= (other[PR_P] << 9) & ~a_file;
-    generate_king_moves(own_union, other_union, other, other_pawn_attacks, log_bit(own[PR_K]), board->types, meta, out);
+    if (quiet && specials[i].type == MT_EN_PASSANT) continue;
+    if (gives_check_color(board, &ci, &specials[i], us)) out->moves[out->size++] = specials[i];
   }
 
   return out->size;
 }
 
+void
+check_info_init(game_state *game, struct check_info *out)
+{
+  if (game->active == COLOR_WHITE) check_info_init_color(&game->board, COLOR_WHITE, out);
+  else check_info_init_color(&game->board, COLOR_BLACK, out);
+}
+
+int
+gives_check(game_state *game, const struct check_info *ci, const move *m)
+{
+  return game->active == COLOR_WHITE
+    ? gives_check_color(&game->board, ci, m, COLOR_WHITE)
+    : gives_check_color(&game->board, ci, m, COLOR_BLACK);
+}
+
+size_t
+generate_checks(game_state *game, irreversable_state meta, struct move_buffer *out)
+{
+  return game->active == COLOR_WHITE
+    ? generate_checks_color(game, meta, 0, COLOR_WHITE, out)
+    : generate_checks_color(game, meta, 0, COLOR_BLACK, out);
+}
+
+size_t
+generate_quiet_checks(game_state *game, irreversable_state meta, struct move_buffer *out)
+{
+  return game->active == COLOR_WHITE
+    ? generate_checks_color(game, meta, 1, COLOR_WHITE, out)
+    : generate_checks_color(game, meta, 1, COLOR_BLACK, out);
+}
+
 struct move_buffer *
 move_buffer_create(size_t max_ply)
 {
@@ -377,30 +625,57 @@ move_buffer_destroy(struct move_buffer *mbuf) { free(mbuf); }
 void
 move_gen_init_LUTs(void)
 {
+  // every slider lookup is a PEXT (-mbmi2), which would fault with SIGILL on the first move
+  if (!cpu_has_bmi2())
+  {
+    fprintf(stderr, "Error: this cpu does not support BMI2, which schess is built for\n");
+    exit(EXIT_FAILURE);
+  }
+
   lut_gen_knight(knight_attacks);
   lut_gen_bishop_rook(attack_table, bishop_mask, rook_mask, bishop_offset, rook_offset);
   lut_gen_king(king_attacks);
+  init_lines();
+  kpk_init();
+  // the AVX2 serializer loses to the scalar loop on the sparse target sets of real positions
+  serialize_init(cpu_detect() == CPU_AVX512 ? CPU_AVX512 : CPU_SCALAR);
+}
+
+// checks whether the side that just moved (`OTHER_COLOR(active)`) left its king en prise
+ALWAYS_INLINE int
+is_board_legal_color(board_state *board, const color active)
+{
+  const color mover = OTHER_COLOR(active);
+  bitboard *attacker = board->bitboards + active,
+           *defender = board->bitboards + mover;
+  bitboard attacker_union = attacker[PR_P] | attacker[PR_N] | attacker[PR_B] | attacker[PR_R] | attacker[PR_Q] | attacker[PR_K];
+  bitboard defender_union = defender[PR_P] | defender[PR_N] | defender[PR_B] | defender[PR_R] | defender[PR_Q] | defender[PR_K];
+  bitboard attacker_pawn_attacks = pawn_east_attacks(attacker[PR_P], active) | pawn_west_attacks(attacker[PR_P], active);
+
+  return !is_square_checked(defender_union, attacker_union, attacker, attacker_pawn_attacks, log_bit(defender[PR_K]));
 }
 
+int
+is_board_legal_white(board_state *board) { return is_board_legal_color(board, COLOR_WHITE); }
+int
+is_board_legal_black(board_state *board) { return is_board_legal_color(board, COLOR_BLACK); }
 int
 is_board_legal(board_state *board, color active)
 {
-  bitboard wocc = board->bitboards[PT_WP] | board->bitboards[PT_WN] | board->bitboards[PT_WB] | board->bitboards[PT_WR] | board->bitboards[PT_WQ] | board->bitboards[PT_WK];
-  bitboard bocc = board->bitboards[PT_BP] | board->bitboards[PT_BN] | board->bitboards[PT_BB] | board->bitboards[PT_BR] | board->bitboards[PT_BQ] | board->bitboards[PT_BK];
-  bitboard wpawn_attacks, bpawn_attacks;
-
-  wpawn_attacks  = (board->bitboards[PT_WP] << 9) & ~a_file;
-  wpawn_attacks |= (board->bitboards[PT_WP] << 7) & ~h_file;
-  bpawn_attacks  = (board->bitboards[PT_BP] >> 9) & ~h_file;
-  bpawn_attacks |= (board->bitboards[PT_BP] >> 7) & ~a_file;
-
   switch (active)
   {
   case COLOR_WHITE:
-    return !is_square_checked(bocc, wocc, &board->bitboards[COLOR_WHITE], wpawn_attacks, log_bit(board->bitboards[PT_BK]));
+    return is_board_legal_white(board);
   case COLOR_BLACK:
-    return !is_square_checked(wocc, bocc, &board->bitboards[COLOR_BLACK], bpawn_attacks, log_bit(board->bitboards[PT_WK]));
+    return is_board_legal_black(board);
   default:
     return 0;
   }
 }
+
+int
+is_in_check(board_state *board, color c)
+{
+  // `c` is in check iff the other side could capture its king
+  return !is_board_legal(board, OTHER_COLOR(c));
+}
@@ -3,6 +3,7 @@
 
 #include <schess/types.h>
 #include <stddef.h>
+#include <x86intrin.h>
 
 #define MAX_MOVES_NUM 256
 struct move_buffer
@@ -11,14 +12,105 @@ struct move_buffer
   move moves[MAX_MOVES_NUM];
 };
 
+/*
+ * set-wise form of the pseudo-legal moves: one target bitboard per origin piece,
+ * the pawn targets per push/capture direction and the few special moves (en passant,
+ * castling). moves are only serialized when iterated; counting is a popcount.
+ */
+#define MAX_ORIGINS_NUM 16
+#define MAX_SPECIALS_NUM 4
+enum PAWN_SET
+{
+  PS_SINGLE,
+  PS_DOUBLE,
+  PS_EAST,
+  PS_WEST,
+  PS_SINGLE_PROMO,
+  PS_EAST_PROMO,
+  PS_WEST_PROMO,
+  PS_COUNT
+};
+struct move_set
+{
+  size_t num_origins, num_specials, cursor;
+  square origins[MAX_ORIGINS_NUM];
+  bitboard targets[MAX_ORIGINS_NUM];
+  bitboard pawn_targets[PS_COUNT];
+  int pawn_offsets[PS_COUNT]; // from = to - offset
+  move specials[MAX_SPECIALS_NUM];
+  enum MOVE_TYPE promotion;
+};
+
 struct move_buffer *move_buffer_create(size_t max_ply);
 void move_buffer_destroy(struct move_buffer *mbuf);
 
 
 void move_gen_init_LUTs(void);
 
+/* attack sets, valid once move_gen_init_LUTs ran */
+extern bitboard attack_table[];
+extern bitboard rook_mask[NUM_SQUARES];
+extern size_t rook_offset[NUM_SQUARES];
+extern bitboard bishop_mask[NUM_SQUARES];
+extern size_t bishop_offset[NUM_SQUARES];
+extern bitboard knight_attacks[NUM_SQUARES];
+extern bitboard king_attacks[NUM_SQUARES];
+
+static inline bitboard
+rook_attacks(bitboard occ, square sq)
+{
+  // X86
+  return attack_table[rook_offset[sq] + _pext_u64(occ, rook_mask[sq])];
+}
+static inline bitboard
+bishop_attacks(bitboard occ, square sq)
+{
+  // X86
+  return attack_table[bishop_offset[sq] + _pext_u64(occ, bishop_mask[sq])];
+}
+static inline bitboard
+queen_attacks(bitboard occ, square sq)
+{
+  return rook_attacks(occ, sq) | bishop_attacks(occ, sq);
+}
+
+void generate_move_set(game_state *game, irreversable_state meta, struct move_set *out);
+void generate_move_set_white(game_state *game, irreversable_state meta, struct move_set *out);
+void generate_move_set_black(game_state *game, irreversable_state meta, struct move_set *out);
+
+// number of moves left in the set
+size_t move_set_count(const struct move_set *set);
+// pops the next move off the set; returns 0 once it is exhausted
+int move_set_next(struct move_set *set, piece_type types[NUM_SQUARES], move *out);
+// whether the pseudo-legal move `m` is still in the set, e.g. a move remembered from another node
+int move_set_contains(const struct move_set *set, const move *m);
+// writes all moves left in the set to `out` and empties the set
+size_t move_set_serialize(struct move_set *set, piece_type types[NUM_SQUARES], struct move_buffer *out);
+
 size_t generate_moves(game_state *game, irreversable_state meta, struct move_buffer *out);
+size_t generate_moves_white(game_state *game, irreversable_state meta, struct move_buffer *out);
+size_t generate_moves_black(game_state *game, irreversable_state meta, struct move_buffer *out);
+
+/* moves giving check: direct checks from the enemy king's attack sets, discovered ones via own blockers of own sliders */
+struct check_info
+{
+  square king;                 // enemy king
+  bitboard occ;
+  bitboard discoverers;        // own pieces alone between an own slider and the enemy king
+  bitboard squares[PR_K + 1];  // squares from which each own piece type gives direct check
+};
+
+void check_info_init(game_state *game, struct check_info *out);
+// whether the pseudo-legal move `m` of the side to move checks the enemy king
+int gives_check(game_state *game, const struct check_info *ci, const move *m);
+
+size_t generate_checks(game_state *game, irreversable_state meta, struct move_buffer *out);
+// checking moves that neither capture nor promote
+size_t generate_quiet_checks(game_state *game, irreversable_state meta, struct move_buffer *out);
 
 int is_board_legal(board_state *board, color active);
+int is_board_legal_white(board_state *board);
+int is_board_legal_black(board_state *board);
+int is_in_check(board_state *board, color c);
 
 #endif // SCHESS_GEN_H
@@ -0,0 +1,38 @@
+#include <schess/kpk.h>
+#include <schess/lut.h>
+#include <stdint.h>
+
+static uint32_t bitbase[LUT_KPK_SIZE];
+static int ready;
+
+void
+kpk_init(void)
+{
+  if (!ready) ready = !lut_gen_kpk(bitbase);
+}
+
+int
+kpk_probe(square strong_king, square strong_pawn, square weak_king, color strong, color active)
+{
+  size_t index;
+
+  if (!ready) return -1;
+
+  // the bitbase is stored for white with the pawn on files a-d
+  if (strong == COLOR_BLACK)
+  {
+    strong_king ^= 56;
+    strong_pawn ^= 56;
+    weak_king   ^= 56;
+  }
+  if ((strong_pawn & 7) >= 4)
+  {
+    strong_king ^= 7;
+    strong_pawn ^= 7;
+    weak_king   ^= 7;
+  }
+
+  index = strong_king | weak_king << 6 | (active != strong) << 12
+        | (strong_pawn & 7) << 13 | (6 - (strong_pawn >> 3)) << 15;
+  return bitbase[index / 32] >> (index % 32) & 1;
+}
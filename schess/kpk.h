@@ -0,0 +1,12 @@
+#ifndef SCHESS_KPK_H
+#define SCHESS_KPK_H
+
+#include <schess/types.h>
+
+// generates the bitbase once; called by move_gen_init_LUTs
+void kpk_init(void);
+
+// 1 if the side with the pawn wins, 0 if it is a draw, -1 if the bitbase is not available
+int kpk_probe(square strong_king, square strong_pawn, square weak_king, color strong, color active);
+
+#endif // SCHESS_KPK_H
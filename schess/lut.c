@@ -1,4 +1,5 @@
 #include <schess/lut.h>
+#include <stdlib.h>
 #include <x86intrin.h>
 
 static const bitboard file_attack = 0x0001010101010100;
@@ -198,6 +199,104 @@ lut_fill_king_attacks(bitboard lut[NUM_SQUARES])
 }
 
 
+/* KPK BITBASE */
+// white king, black king, side to move (1 = black), pawn file a-d, pawn rank 7 down to 2
+static inline size_t
+lut_kpk_index(unsigned black_to_move, square white_king, square black_king, square pawn)
+{
+  return white_king | black_king << 6 | black_to_move << 12 | (pawn & 7) << 13 | (6 - (pawn >> 3)) << 15;
+}
+
+enum LUT_KPK_RESULT { KPK_INVALID = 0, KPK_UNKNOWN = 1, KPK_DRAW = 2, KPK_WIN = 4 };
+
+static unsigned char
+lut_kpk_classify_initial(size_t index, const bitboard king[NUM_SQUARES])
+{
+  unsigned black_to_move = index >> 12 & 1;
+  square white_king = index & 63,
+         black_king = index >> 6 & 63,
+         pawn = (6 - (index >> 15)) * 8 + (index >> 13 & 3),
+         promo = pawn + 8;
+  bitboard pawn_attacks = noea(sq2bb(pawn)) | nowe(sq2bb(pawn));
+
+  if (white_king == black_king || white_king == pawn || black_king == pawn) return KPK_INVALID;
+  if (king[white_king] & sq2bb(black_king)) return KPK_INVALID;
+  // black in check with white to move
+  if (!black_to_move && (pawn_attacks & sq2bb(black_king))) return KPK_INVALID;
+
+  // white promotes without the queen being taken
+  if (!black_to_move && pawn >> 3 == 6 && promo != white_king && promo != black_king &&
+      (!(king[black_king] & sq2bb(promo)) || (king[white_king] & sq2bb(promo))))
+    return KPK_WIN;
+
+  // black is stalemated or takes the undefended pawn
+  if (black_to_move &&
+      (!(king[black_king] & ~(king[white_king] | pawn_attacks)) ||
+       (king[black_king] & ~king[white_king] & sq2bb(pawn))))
+    return KPK_DRAW;
+
+  return KPK_UNKNOWN;
+}
+
+static unsigned char
+lut_kpk_classify(size_t index, const unsigned char *db, const bitboard king[NUM_SQUARES])
+{
+  unsigned black_to_move = index >> 12 & 1, r = KPK_INVALID;
+  square white_king = index & 63,
+         black_king = index >> 6 & 63,
+         pawn = (6 - (index >> 15)) * 8 + (index >> 13 & 3);
+  bitboard moves = king[black_to_move ? black_king : white_king];
+
+  // king moves next to the other king or into check lead to invalid positions, which add nothing
+  for (; moves; moves &= moves - 1)
+  {
+    square to = __builtin_ctzll(moves); // GCC
+    r |= black_to_move ? db[lut_kpk_index(0, white_king, to, pawn)]
+                       : db[lut_kpk_index(1, to, black_king, pawn)];
+  }
+
+  if (!black_to_move && pawn >> 3 < 6)
+  {
+    r |= db[lut_kpk_index(1, white_king, black_king, pawn + 8)];
+    if (pawn >> 3 == 1 && pawn + 8 != white_king && pawn + 8 != black_king)
+      r |= db[lut_kpk_index(1, white_king, black_king, pawn + 16)];
+  }
+
+  if (black_to_move) return r & KPK_DRAW ? KPK_DRAW : r & KPK_UNKNOWN ? KPK_UNKNOWN : KPK_WIN;
+  return r & KPK_WIN ? KPK_WIN : r & KPK_UNKNOWN ? KPK_UNKNOWN : KPK_DRAW;
+}
+
+int
+lut_gen_kpk(uint32_t bitbase[LUT_KPK_SIZE])
+{
+  bitboard king[NUM_SQUARES];
+  unsigned char *db = malloc(LUT_KPK_POSITIONS);
+  size_t index;
+  int changed;
+
+  if (!db) return 1;
+  lut_fill_king_attacks(king);
+
+  for (index = 0; index < LUT_KPK_POSITIONS; ++index)
+    db[index] = lut_kpk_classify_initial(index, king);
+
+  // retrograde: resolve unknown positions from their successors until nothing changes
+  do
+  {
+    changed = 0;
+    for (index = 0; index < LUT_KPK_POSITIONS; ++index)
+      if (db[index] == KPK_UNKNOWN && (db[index] = lut_kpk_classify(index, db, king)) != KPK_UNKNOWN)
+        changed = 1;
+  } while (changed);
+
+  for (index = 0; index < LUT_KPK_SIZE; ++index) bitbase[index] = 0;
+  for (index = 0; index < LUT_KPK_POSITIONS; ++index)
+    if (db[index] == KPK_WIN) bitbase[index / 32] |= 1u << (index % 32);
+
+  free(db);
+  return 0;
+}
+
 
 void
 lut_gen_knight(bitboard lut[NUM_SQUARES]) { lut_fill_knight_attacks(lut); }
@@ -222,9 +321,9 @@ lut_gen_bishop_rook(bitboard lut[LUT_BISHOP_SIZE + LUT_ROOK_SIZE], bitboard bish
 int
 main(int argc, char **argv)
 {
-  if (argc != 8)
+  if (argc != 9)
   {
-    fprintf(stderr, "Required arguments: <knightLUT_file> <kingLUT_file> <bishop_rookLUT_file> <bishop_mask_file> <rook_mask_file> <bishop_offset_file> <rook_offset_file>\n");
+    fprintf(stderr, "Required arguments: <knightLUT_file> <kingLUT_file> <bishop_rookLUT_file> <bishop_mask_file> <rook_mask_file> <bishop_offset_file> <rook_offset_file> <kpk_file>\n");
     exit(EXIT_FAILURE);
   }
 
@@ -255,6 +354,7 @@ main(int argc, char **argv)
   LUT_GEN_MAP_FILE(rook_mask,     argv[5], NUM_SQUARES, bitboard);
   LUT_GEN_MAP_FILE(bishop_offset, argv[6], NUM_SQUARES, size_t);
   LUT_GEN_MAP_FILE(rook_offset,   argv[7], NUM_SQUARES, size_t);
+  LUT_GEN_MAP_FILE(kpk,           argv[8], LUT_KPK_SIZE, uint32_t);
 
 #undef LUT_GEN_MAP_FILE
 
@@ -263,6 +363,11 @@ main(int argc, char **argv)
   lut_gen_knight(knight);
   lut_gen_king(king);
   lut_gen_bishop_rook(bishop_rook, bishop_mask, rook_mask, bishop_offset, rook_offset);
+  if (lut_gen_kpk(kpk))
+  {
+    fprintf(stderr, "Error generating the KPK bitbase: %s\n", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
 
 
 
@@ -286,6 +391,7 @@ main(int argc, char **argv)
   LUT_GEN_UNMAP_FILE(rook_mask,     argv[5], NUM_SQUARES, bitboard);
   LUT_GEN_UNMAP_FILE(bishop_offset, argv[6], NUM_SQUARES, size_t);
   LUT_GEN_UNMAP_FILE(rook_offset,   argv[7], NUM_SQUARES, size_t);
+  LUT_GEN_UNMAP_FILE(kpk,           argv[8], LUT_KPK_SIZE, uint32_t);
 
 #undef LUT_GEN_UNMAP_FILE
 
@@ -3,9 +3,13 @@
 
 #include <schess/types.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #define LUT_BISHOP_SIZE 5248
 #define LUT_ROOK_SIZE 102400
+// 2 sides to move x 64 x 64 king squares x 24 pawn squares (files a-d, ranks 2-7), one bit each
+#define LUT_KPK_POSITIONS (2 * 64 * 64 * 24)
+#define LUT_KPK_SIZE (LUT_KPK_POSITIONS / 32)
 
 void lut_gen_knight(bitboard lut[NUM_SQUARES]);
 void lut_gen_king  (bitboard lut[NUM_SQUARES]);
@@ -14,4 +18,7 @@ void lut_gen_bishop_rook(bitboard lut[LUT_BISHOP_SIZE + LUT_ROOK_SIZE],
     bitboard bishop_mask[NUM_SQUARES], bitboard rook_mask[NUM_SQUARES],
     size_t bishop_offset[NUM_SQUARES], size_t rook_offset[NUM_SQUARES]);
 
+// bit set where the side with the pawn (white, pawn on files a-d) wins; returns 0 on success
+int lut_gen_kpk(uint32_t bitbase[LUT_KPK_SIZE]);
+
 #endif // SCHESS_LUT_H
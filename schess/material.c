@@ -0,0 +1,151 @@
+#include <schess/eval.h>
+#include <schess/material.h>
+#include <stdlib.h>
+
+#define NIBBLE(rel, side) (1ull << (4 * ((rel) + (side) * PR_K)))
+const uint64_t material_inc[PT_COUNT] =
+{
+  [PT_WP] = NIBBLE(PR_P, 0), [PT_WN] = NIBBLE(PR_N, 0), [PT_WB] = NIBBLE(PR_B, 0),
+  [PT_WR] = NIBBLE(PR_R, 0), [PT_WQ] = NIBBLE(PR_Q, 0),
+  [PT_BP] = NIBBLE(PR_P, 1), [PT_BN] = NIBBLE(PR_N, 1), [PT_BB] = NIBBLE(PR_B, 1),
+  [PT_BR] = NIBBLE(PR_R, 1), [PT_BQ] = NIBBLE(PR_Q, 1),
+};
+#undef NIBBLE
+
+// the table covers up to this many pieces of each type and side; promotions fall outside
+static const unsigned table_max[PR_K] = { 8, 2, 2, 2, 1 };
+#define TABLE_SIDE_SIZE (9 * 3 * 3 * 3 * 2)
+
+static struct material_entry table[TABLE_SIDE_SIZE * TABLE_SIDE_SIZE];
+static _Thread_local struct material_entry spare;
+
+// endgame values, for the drawishness rules only
+static const int npm_value[PR_K] = { 0, 281, 297, 512, 936 };
+
+static const int bishop_pair    = 30;
+static const int knight_by_pawn =  4; // per knight and own pawn above five
+static const int rook_by_pawn   = -8; // per rook and own pawn above five
+
+void
+material_refresh(game_state *game)
+{
+  piece_type pt;
+
+  game->material_key = 0;
+  for (pt = PT_WP; pt < PT_COUNT; ++pt)
+    // GCC
+    game->material_key += material_inc[pt] * __builtin_popcountll(game->board.bitboards[pt]);
+}
+
+static void
+material_compute(const unsigned count[2][PR_K], struct material_entry *out)
+{
+  int npm[2] = { 0, 0 }, minors[2], phase = 0, imbalance = 0, sign;
+  unsigned side, other, rel, total_pieces;
+
+  for (side = 0; side < 2; ++side)
+  {
+    sign = side ? -1 : 1;
+    for (rel = PR_N; rel < PR_K; ++rel)
+    {
+      npm[side] += npm_value[rel] * count[side][rel];
+      phase     += eval_phase_inc[COLOR_WHITE + rel] * count[side][rel];
+    }
+    minors[side] = count[side][PR_N] + count[side][PR_B];
+
+    if (count[side][PR_B] >= 2) imbalance += sign * bishop_pair;
+    imbalance += sign * knight_by_pawn * (int) count[side][PR_N] * ((int) count[side][PR_P] - 5);
+    imbalance += sign * rook_by_pawn   * (int) count[side][PR_R] * ((int) count[side][PR_P] - 5);
+  }
+
+  out->imbalance = imbalance;
+  out->phase = phase < EVAL_PHASE_MAX ? phase : EVAL_PHASE_MAX;
+  out->flags = 0;
+
+  for (side = 0; side < 2; ++side)
+  {
+    other = !side;
+    out->scale[side] = MATERIAL_SCALE_NORMAL;
+    if (count[side][PR_P]) continue;
+
+    // without pawns, less than a rook up is hard to win and a minor alone cannot mate
+    if (npm[side] - npm[other] <= npm_value[PR_B])
+      out->scale[side] = npm[side] < npm_value[PR_R] ? 0 : npm[other] <= npm_value[PR_B] ? 4 : 14;
+    // two knights cannot force mate
+    if (count[side][PR_N] == 2 && npm[side] == 2 * npm_value[PR_N] && !npm[other] && !count[other][PR_P])
+      out->scale[side] = 0;
+  }
+
+  total_pieces = minors[0] + minors[1]
+               + count[0][PR_R] + count[1][PR_R] + count[0][PR_Q] + count[1][PR_Q];
+  if (!count[0][PR_P] && !count[1][PR_P] && total_pieces == (unsigned) (minors[0] + minors[1]) && minors[0] + minors[1] <= 1)
+  {
+    out->flags |= MF_DRAW;
+    return;
+  }
+
+  for (side = 0; side < 2; ++side)
+  {
+    other = !side;
+    if (npm[other] || count[other][PR_P]) continue;
+
+    if (!npm[side] && count[side][PR_P] == 1) out->flags |= MF_KPK;
+    // knights alone cannot force mate either
+    else if (npm[side] >= npm_value[PR_R] && out->scale[side]) out->flags |= MF_KXK;
+  }
+}
+
+// GCC
+__attribute__((constructor)) static void
+material_init_table(void)
+{
+  unsigned count[2][PR_K], side, rel;
+  size_t index, rest;
+
+  for (index = 0; index < TABLE_SIDE_SIZE * TABLE_SIDE_SIZE; ++index)
+  {
+    // mixed radix digits, white pawns least significant
+    rest = index;
+    for (side = 0; side < 2; ++side)
+      for (rel = PR_P; rel < PR_K; ++rel)
+      {
+        count[side][rel] = rest % (table_max[rel] + 1);
+        rest /= table_max[rel] + 1;
+      }
+    material_compute(count, &table[index]);
+  }
+}
+
+const struct material_entry *
+material_probe(uint64_t key)
+{
+  unsigned count[2][PR_K], side, rel, c;
+  size_t index = 0, radix = 1;
+  int inside = 1;
+
+  for (side = 0; side < 2; ++side)
+    for (rel = PR_P; rel < PR_K; ++rel)
+    {
+      c = count[side][rel] = key & 0xF;
+      key >>= 4;
+      if (c > table_max[rel]) inside = 0;
+      index += radix * c;
+      radix *= table_max[rel] + 1;
+    }
+
+  if (inside) return &table[index];
+
+  material_compute(count, &spare);
+  return &spare;
+}
+
+int
+material_insufficient(const game_state *game)
+{
+  const bitboard *bb = game->board.bitboards, light = 0x55AA55AA55AA55AAull;
+  const bitboard bishops = bb[PT_WB] | bb[PT_BB];
+
+  if (material_probe(game->material_key)->flags & MF_DRAW) return 1;
+  if (bb[PT_WP] | bb[PT_BP] | bb[PT_WN] | bb[PT_BN] | bb[PT_WR] | bb[PT_BR] | bb[PT_WQ] | bb[PT_BQ]) return 0;
+  return !(bishops & light) || !(bishops & ~light);
+}
@@ -0,0 +1,47 @@
+#ifndef SCHESS_MATERIAL_H
+#define SCHESS_MATERIAL_H
+
+#include <schess/types.h>
+#include <stdint.h>
+
+/*
+ * material key: the count of every non-king piece type in one nibble, white pawns in
+ * the lowest. kept incrementally in game_state by adding and subtracting material_inc.
+ */
+extern const uint64_t material_inc[PT_COUNT];
+
+#define MATERIAL_SCALE_NORMAL 64
+
+enum MATERIAL_FLAG
+{
+  MF_DRAW = 1 << 0, // neither side can mate
+  MF_KXK  = 1 << 1, // a lone king against mating material
+  MF_KPK  = 1 << 2, // king and pawn against king
+};
+
+struct material_entry
+{
+  int16_t imbalance; // white relative, centipawns
+  uint8_t phase;     // clamped to EVAL_PHASE_MAX
+  uint8_t scale[2];  // endgame scale when white / black is ahead, of MATERIAL_SCALE_NORMAL
+  uint8_t flags;
+};
+
+// recomputes the material key of `game` from scratch
+void material_refresh(game_state *game);
+
+// precomputed for the usual counts, computed into a thread local entry for the others
+const struct material_entry *material_probe(uint64_t key);
+
+// no sequence of legal moves mates: MF_DRAW material, or bishops only, all on one square colour
+int material_insufficient(const game_state *game);
+
+// number of pieces of the non-king type `pt`
+static inline unsigned
+material_count(uint64_t key, piece_type pt)
+{
+  unsigned nibble = pt < PT_BP ? pt - PT_WP : pt - PT_BP + PR_K;
+  return (key >> (4 * nibble)) & 0xF;
+}
+
+#endif // SCHESS_MATERIAL_H
@@ -1,72 +1,101 @@
 #include <schess/eval.h>
+#include <schess/material.h>
 #include <schess/move.h>
+#include <schess/nnue.h>
+#include <schess/zobrist.h>
 
-static inline void
-bitboard_set(square sq, bitboard *b) { *b |= sq2bb(sq); }
+/* all board changes go through these, so the incremental terms follow every piece */
+ALWAYS_INLINE void
+piece_put(game_state *game, piece_type pt, square sq)
+{
+  game->board.bitboards[pt] |= sq2bb(sq);
+  game->board.types[sq] = pt;
+  game->psqt_mg += eval_psqt_mg[pt][sq];
+  game->psqt_eg += eval_psqt_eg[pt][sq];
+  game->phase   += eval_phase_inc[pt];
+  game->key ^= zobrist_pieces[pt][sq];
+  if (pt == PT_WP || pt == PT_BP) game->pawn_key ^= zobrist_pieces[pt][sq];
+  game->material_key += material_inc[pt];
+  if (game->nnue) nnue_record(game->nnue, pt, sq, 1);
+}
 
-static inline void
-bitboard_unset(square sq, bitboard *b) { *b &= ~sq2bb(sq); }
+ALWAYS_INLINE void
+piece_remove(game_state *game, piece_type pt, square sq)
+{
+  game->board.bitboards[pt] &= ~sq2bb(sq);
+  game->board.types[sq] = PT_NONE;
+  game->psqt_mg -= eval_psqt_mg[pt][sq];
+  game->psqt_eg -= eval_psqt_eg[pt][sq];
+  game->phase   -= eval_phase_inc[pt];
+  game->key ^= zobrist_pieces[pt][sq];
+  if (pt == PT_WP || pt == PT_BP) game->pawn_key ^= zobrist_pieces[pt][sq];
+  game->material_key -= material_inc[pt];
+  if (game->nnue) nnue_record(game->nnue, pt, sq, 0);
+}
 
+// square of the pawn captured en passant by a pawn of color `us` landing on `to`
+#define EN_PASSANT_VICTIM(us, to) ((us) == COLOR_WHITE ? (to) - 8 : (to) + 8)
 
-int
-move_make(move *m, game_state *game, irreversable_state *meta)
+
+ALWAYS_INLINE int
+move_make_color(move *m, game_state *game, irreversable_state *meta, const color us)
 {
+  const color them = OTHER_COLOR(us);
   board_state *board = &game->board;
   piece_type piece = board->types[m->from],
   capture = board->types[m->to];
 
-  // clear board
-  bitboard_unset(m->from, &board->bitboards[piece]);
-  bitboard_unset(m->to, &board->bitboards[capture]);
-  board->types[m->from] = PT_NONE;
+  // the changes below are recorded on a fresh accumulator
+  if (game->nnue)
+  {
+    ++game->nnue;
+    game->nnue->num_dirty = 0;
+    game->nnue->computed[0] = game->nnue->computed[1] = 0;
+  }
 
-  if (capture != PT_NONE) meta->halfmove_clock = 0;
+  // reset below by captures and pawn moves
+  ++meta->halfmove_clock;
 
-  game->en_passant_potential = 0ull;
+  // clear board
+  piece_remove(game, piece, m->from);
+  if (capture != PT_NONE)
+  {
+    piece_remove(game, capture, m->to);
+    meta->halfmove_clock = 0;
+  }
+
+  meta->en_passant_potential = 0ull;
 
   piece_type promo_type, castle_rook;
 
   switch (m->type)
   {
   case MT_NORMAL:
-    if (piece == PT_WP || piece == PT_BP) meta->halfmove_clock = 0;
+    if (piece == us + PR_P) meta->halfmove_clock = 0;
     break;
   case MT_DOUBLE_PAWN:
-    game->en_passant_potential = sq2bb(m->to);
+    meta->en_passant_potential = sq2bb(m->to);
     meta->halfmove_clock = 0;
     break;
   case MT_EN_PASSANT:
-    if (piece == PT_WP)
-    {
-      bitboard_unset(m->to - 8, &board->bitboards[PT_BP]);
-      board->types[m->to - 8] = PT_NONE;
-    }
-    else // piece = PT_BP
-    {
-      bitboard_unset(m->to + 8, &board->bitboards[PT_WP]);
-      board->types[m->to + 8] = PT_NONE;
-    }
+    piece_remove(game, them + PR_P, EN_PASSANT_VICTIM(us, m->to));
     meta->halfmove_clock = 0;
     break;
 
   case MT_CASTLE_KING:
-    castle_rook = piece + (PR_R - PR_K);
-    bitboard_unset(m->to + 1, &board->bitboards[castle_rook]);
-    bitboard_set(m->from + 1, &board->bitboards[castle_rook]);
-    board->types[m->to + 1] = PT_NONE;
-    board->types[m->from + 1] = castle_rook;
+    castle_rook = us + PR_R;
+    piece_remove(game, castle_rook, m->to + 1);
+    piece_put(game, castle_rook, m->from + 1);
     break;
   case MT_CASTLE_QUEEN:
-    castle_rook = piece + (PR_R - PR_K);
-    bitboard_unset(m->to - 2, &board->bitboards[castle_rook]);
-    bitboard_set(m->from - 1, &board->bitboards[castle_rook]);
-    board->types[m->to - 2] = PT_NONE;
-    board->types[m->from - 1] = castle_rook;
+    castle_rook = us + PR_R;
+    piece_remove(game, castle_rook, m->to - 2);
+    piece_put(game, castle_rook, m->from - 1);
     break;
 
 #define MOVE_MAKE_HANDLE_PROMOTION(rel_type) \
     { \
-      promo_type = piece + (rel_type - PR_P); \
+      promo_type = us + (rel_type); \
       meta->halfmove_clock = 0; \
       piece = promo_type; \
     }
@@ -102,29 +131,30 @@ move_make(move *m, game_state *game, irreversable_state *meta)
   }
 
   // set board
-  bitboard_set(m->to, &board->bitboards[piece]);
-  board->types[m->to] = piece;
+  piece_put(game, piece, m->to);
 
-  game->active = OTHER_COLOR(game->active);
+  game->active = them;
+  game->key ^= zobrist_side;
 
-  if (capture == PT_WK) return -oo;
-  if (capture == PT_BK) return +oo;
+  if (capture == them + PR_K) return us == COLOR_WHITE ? +oo : -oo;
   return 0;
 }
 
 
-void
-move_unmake(move *m, game_state *game)
+ALWAYS_INLINE void
+move_unmake_color(move *m, game_state *game, const color us)
 {
-  board_state *board = &game->board;
-  piece_type piece = board->types[m->to],
+  const color them = OTHER_COLOR(us);
+  piece_type piece = game->board.types[m->to],
   capture = m->capture;
+  // detached while restoring, the parent accumulator is still valid
+  struct nnue_accumulator *acc = game->nnue;
+  game->nnue = NULL;
 
-  bitboard_unset(m->to, &board->bitboards[piece]);
-  bitboard_set(m->to, &board->bitboards[capture]);
-  board->types[m->to] = capture;
+  piece_remove(game, piece, m->to);
+  if (capture != PT_NONE) piece_put(game, capture, m->to);
 
-  piece_type prepromo_type, castle_rook;
+  piece_type castle_rook;
 
   switch (m->type)
   {
@@ -132,49 +162,58 @@ move_unmake(move *m, game_state *game)
   case MT_DOUBLE_PAWN:
     break;
   case MT_EN_PASSANT:
-    if (piece == PT_WP)
-    {
-      bitboard_set(m->to - 8, &board->bitboards[PT_BP]);
-      board->types[m->to - 8] = PT_BP;
-    }
-    else // piece = PT_BP
-    {
-      bitboard_set(m->to + 8, &board->bitboards[PT_WP]);
-      board->types[m->to + 8] = PT_WP;
-    }
+    piece_put(game, them + PR_P, EN_PASSANT_VICTIM(us, m->to));
     break;
 
   case MT_CASTLE_KING:
-    castle_rook = piece + (PR_R - PR_K);
-    bitboard_unset(m->from + 1, &board->bitboards[castle_rook]);
-    bitboard_set(m->to + 1, &board->bitboards[castle_rook]);
-    board->types[m->to + 1] = castle_rook;
-    board->types[m->from + 1] = PT_NONE;
+    castle_rook = us + PR_R;
+    piece_remove(game, castle_rook, m->from + 1);
+    piece_put(game, castle_rook, m->to + 1);
     break;
   case MT_CASTLE_QUEEN:
-    castle_rook = piece + (PR_R - PR_K);
-    bitboard_unset(m->from - 1, &board->bitboards[castle_rook]);
-    bitboard_set(m->to - 2, &board->bitboards[castle_rook]);
-    board->types[m->to - 2] = castle_rook;
-    board->types[m->from - 1] = PT_NONE;
+    castle_rook = us + PR_R;
+    piece_remove(game, castle_rook, m->from - 1);
+    piece_put(game, castle_rook, m->to - 2);
     break;
 
-#define MOVE_UNMAKE_HANDLE_PROMOTION(rel_type) \
-    { \
-      prepromo_type = piece + (PR_P - rel_type); \
-      piece = prepromo_type; \
-    }
-  case MT_PROMOTION_KNIGHT: MOVE_UNMAKE_HANDLE_PROMOTION(PR_N); break;
-  case MT_PROMOTION_BISHOP: MOVE_UNMAKE_HANDLE_PROMOTION(PR_B); break;
-  case MT_PROMOTION_ROOK: MOVE_UNMAKE_HANDLE_PROMOTION(PR_R); break;
-  case MT_PROMOTION_QUEEN: MOVE_UNMAKE_HANDLE_PROMOTION(PR_Q); break;
-#undef MOVE_UNMAKE_HANDLE_PROMOTION
+  case MT_PROMOTION_KNIGHT:
+  case MT_PROMOTION_BISHOP:
+  case MT_PROMOTION_ROOK:
+  case MT_PROMOTION_QUEEN:
+    piece = us + PR_P;
+    break;
 
   case MT_NULL: break;
   }
 
-  bitboard_set(m->from, &board->bitboards[piece]);
-  board->types[m->from] = piece;
+  piece_put(game, piece, m->from);
+
+  game->active = us;
+  game->key ^= zobrist_side;
+  game->nnue = acc ? acc - 1 : NULL;
+}
+
+
+int
+move_make_white(move *m, game_state *game, irreversable_state *meta) { return move_make_color(m, game, meta, COLOR_WHITE); }
+int
+move_make_black(move *m, game_state *game, irreversable_state *meta) { return move_make_color(m, game, meta, COLOR_BLACK); }
+int
+move_make(move *m, game_state *game, irreversable_state *meta)
+{
+  return game->active == COLOR_WHITE
+    ? move_make_white(m, game, meta)
+    : move_make_black(m, game, meta);
+}
 
-  game->active = OTHER_COLOR(game->active);
+void
+move_unmake_white(move *m, game_state *game) { move_unmake_color(m, game, COLOR_WHITE); }
+void
+move_unmake_black(move *m, game_state *game) { move_unmake_color(m, game, COLOR_BLACK); }
+void
+move_unmake(move *m, game_state *game)
+{
+  // the side that made the move is the one not to move anymore
+  if (game->active == COLOR_BLACK) move_unmake_white(m, game);
+  else move_unmake_black(m, game);
 }
@@ -5,8 +5,16 @@
 
 int
 move_make(move *m, game_state *game, irreversable_state *meta);
+int
+move_make_white(move *m, game_state *game, irreversable_state *meta);
+int
+move_make_black(move *m, game_state *game, irreversable_state *meta);
 
 void
 move_unmake(move *m, game_state *game);
+void
+move_unmake_white(move *m, game_state *game);
+void
+move_unmake_black(move *m, game_state *game);
 
 #endif // SCHESS_MOVES_H
@@ -0,0 +1,526 @@
+#include <schess/evalcache.h>
+#include <schess/nnue.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
+
+#define NNUE_MAGIC "SCHESSNN"
+#define NNUE_VERSION 1u
+
+// hidden layer sums are scaled down by 2^6 before the clipped ReLU
+#define NNUE_WEIGHT_SHIFT 6
+// network output units per centipawn
+#define NNUE_OUTPUT_SCALE 16
+
+static int16_t *ft_weights;                                          // [NNUE_INPUTS][NNUE_L1]
+static int16_t ft_biases[NNUE_L1] __attribute__((aligned(64)));
+static int8_t  l1_weights[NNUE_L2][2 * NNUE_L1] __attribute__((aligned(64)));
+static int32_t l1_biases[NNUE_L2];
+static int8_t  l2_weights[NNUE_L3][NNUE_L2] __attribute__((aligned(64)));
+static int32_t l2_biases[NNUE_L3];
+static int8_t  out_weights[NNUE_L3] __attribute__((aligned(64)));
+static int32_t out_bias;
+static int loaded;
+
+static _Thread_local struct nnue_accumulator *stack;
+static _Thread_local struct nnue_stats stats;
+
+
+/* KERNELS */
+typedef void (*row_fn)(int16_t *acc, const int16_t *row);
+typedef void (*crelu16_fn)(const int16_t *in, uint8_t *out, size_t n);
+typedef void (*affine_fn)(const uint8_t *in, size_t in_dims, const int8_t *weights,
+                          const int32_t *biases, size_t out_dims, int32_t *out);
+
+static void
+add_row_scalar(int16_t *acc, const int16_t *row)
+{
+  size_t i;
+  for (i = 0; i < NNUE_L1; ++i) acc[i] += row[i];
+}
+static void
+sub_row_scalar(int16_t *acc, const int16_t *row)
+{
+  size_t i;
+  for (i = 0; i < NNUE_L1; ++i) acc[i] -= row[i];
+}
+static void
+crelu16_scalar(const int16_t *in, uint8_t *out, size_t n)
+{
+  size_t i;
+  for (i = 0; i < n; ++i) out[i] = in[i] < 0 ? 0 : in[i] > 127 ? 127 : in[i];
+}
+static void
+affine_scalar(const uint8_t *in, size_t in_dims, const int8_t *weights,
+              const int32_t *biases, size_t out_dims, int32_t *out)
+{
+  size_t i, o;
+  int32_t sum;
+
+  for (o = 0; o < out_dims; ++o)
+  {
+    sum = biases[o];
+    for (i = 0; i < in_dims; ++i) sum += in[i] * weights[o * in_dims + i];
+    out[o] = sum;
+  }
+}
+
+__attribute__((target("sse2"))) // GCC // X86
+static void
+add_row_sse(int16_t *acc, const int16_t *row)
+{
+  size_t i;
+  for (i = 0; i < NNUE_L1; i += 8)
+  {
+    __m128i *a = (__m128i *) (acc + i);
+    _mm_store_si128(a, _mm_add_epi16(_mm_load_si128(a), _mm_load_si128((const __m128i *) (row + i))));
+  }
+}
+__attribute__((target("sse2"))) // GCC // X86
+static void
+sub_row_sse(int16_t *acc, const int16_t *row)
+{
+  size_t i;
+  for (i = 0; i < NNUE_L1; i += 8)
+  {
+    __m128i *a = (__m128i *) (acc + i);
+    _mm_store_si128(a, _mm_sub_epi16(_mm_load_si128(a), _mm_load_si128((const __m128i *) (row + i))));
+  }
+}
+__attribute__((target("sse2"))) // GCC // X86
+static void
+crelu16_sse(const int16_t *in, uint8_t *out, size_t n)
+{
+  const __m128i zero = _mm_setzero_si128();
+  size_t i;
+
+  // negatives are dropped first, the signed pack then saturates at 127
+  for (i = 0; i < n; i += 16)
+  {
+    __m128i lo = _mm_max_epi16(_mm_load_si128((const __m128i *) (in + i)), zero),
+            hi = _mm_max_epi16(_mm_load_si128((const __m128i *) (in + i + 8)), zero);
+    _mm_store_si128((__m128i *) (out + i), _mm_packs_epi16(lo, hi));
+  }
+}
+__attribute__((target("ssse3"))) // GCC // X86
+static void
+affine_sse(const uint8_t *in, size_t in_dims, const int8_t *weights,
+           const int32_t *biases, size_t out_dims, int32_t *out)
+{
+  const __m128i ones = _mm_set1_epi16(1);
+  size_t i, o;
+
+  for (o = 0; o < out_dims; ++o)
+  {
+    __m128i sum = _mm_setzero_si128();
+    for (i = 0; i < in_dims; i += 16)
+    {
+      __m128i x = _mm_load_si128((const __m128i *) (in + i));
+      __m128i w = _mm_load_si128((const __m128i *) (weights + o * in_dims + i));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(x, w), ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    out[o] = biases[o] + _mm_cvtsi128_si32(sum);
+  }
+}
+
+__attribute__((target("avx2"))) // GCC // X86
+static void
+add_row_avx2(int16_t *acc, const int16_t *row)
+{
+  size_t i;
+  for (i = 0; i < NNUE_L1; i += 16)
+  {
+    __m256i *a = (__m256i *) (acc + i);
+    _mm256_store_si256(a, _mm256_add_epi16(_mm256_load_si256(a), _mm256_load_si256((const __m256i *) (row + i))));
+  }
+}
+__attribute__((target("avx2"))) // GCC // X86
+static void
+sub_row_avx2(int16_t *acc, const int16_t *row)
+{
+  size_t i;
+  for (i = 0; i < NNUE_L1; i += 16)
+  {
+    __m256i *a = (__m256i *) (acc + i);
+    _mm256_store_si256(a, _mm256_sub_epi16(_mm256_load_si256(a), _mm256_load_si256((const __m256i *) (row + i))));
+  }
+}
+__attribute__((target("avx2"))) // GCC // X86
+static void
+crelu16_avx2(const int16_t *in, uint8_t *out, size_t n)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  size_t i;
+
+  for (i = 0; i < n; i += 32)
+  {
+    __m256i lo = _mm256_max_epi16(_mm256_load_si256((const __m256i *) (in + i)), zero),
+            hi = _mm256_max_epi16(_mm256_load_si256((const __m256i *) (in + i + 16)), zero);
+    __m256i packed = _mm256_packs_epi16(lo, hi);
+    // packs works per 128 bit lane, restore the element order
+    packed = _mm256_permute4x64_epi64(packed, 0xD8);
+    _mm256_store_si256((__m256i *) (out + i), packed);
+  }
+}
+__attribute__((target("avx2"))) // GCC // X86
+static void
+affine_avx2(const uint8_t *in, size_t in_dims, const int8_t *weights,
+            const int32_t *biases, size_t out_dims, int32_t *out)
+{
+  const __m256i ones = _mm256_set1_epi16(1);
+  size_t i, o;
+
+  for (o = 0; o < out_dims; ++o)
+  {
+    __m256i sum = _mm256_setzero_si256();
+    for (i = 0; i < in_dims; i += 32)
+    {
+      __m256i x = _mm256_load_si256((const __m256i *) (in + i));
+      __m256i w = _mm256_load_si256((const __m256i *) (weights + o * in_dims + i));
+      sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    out[o] = biases[o] + _mm_cvtsi128_si32(half);
+  }
+}
+
+static row_fn add_row = add_row_scalar, sub_row = sub_row_scalar;
+static crelu16_fn crelu16 = crelu16_scalar;
+static affine_fn affine = affine_scalar;
+
+enum CPU_LEVEL
+nnue_select_kernels(enum CPU_LEVEL level)
+{
+  // the AVX2 kernels are the widest ones, AVX-512 machines run them as well
+  if (level > CPU_AVX2) level = CPU_AVX2;
+  if (level > cpu_detect()) level = cpu_detect();
+
+  switch (level)
+  {
+  case CPU_AVX2:
+    add_row = add_row_avx2; sub_row = sub_row_avx2; crelu16 = crelu16_avx2; affine = affine_avx2;
+    break;
+  case CPU_SSE:
+    add_row = add_row_sse; sub_row = sub_row_sse; crelu16 = crelu16_sse; affine = affine_sse;
+    break;
+  default:
+    level = CPU_SCALAR;
+    add_row = add_row_scalar; sub_row = sub_row_scalar; crelu16 = crelu16_scalar; affine = affine_scalar;
+    break;
+  }
+
+  return level;
+}
+
+// GCC
+__attribute__((constructor)) static void
+nnue_init_kernels(void)
+{
+  nnue_select_kernels(cpu_detect());
+}
+
+
+/* WEIGHTS */
+static int
+alloc_weights(void)
+{
+  if (ft_weights) return 0;
+  ft_weights = aligned_alloc(64, sizeof(int16_t) * NNUE_INPUTS * NNUE_L1);
+  return ft_weights == NULL;
+}
+
+static int
+read_array(FILE *file, void *data, size_t size, size_t count)
+{
+  return fread(data, size, count, file) != count;
+}
+
+int
+nnue_load(const char *path)
+{
+  char magic[sizeof(NNUE_MAGIC) - 1];
+  uint32_t header[5];
+  FILE *file;
+  int err;
+
+  if (alloc_weights()) return 1;
+
+  file = fopen(path, "rb");
+  if (!file) return 1;
+
+  // magic, version and the layer sizes the file was written for
+  err = read_array(file, magic, 1, sizeof(magic))
+     || memcmp(magic, NNUE_MAGIC, sizeof(magic))
+     || read_array(file, header, sizeof(uint32_t), 5)
+     || header[0] != NNUE_VERSION || header[1] != NNUE_INPUTS
+     || header[2] != NNUE_L1 || header[3] != NNUE_L2 || header[4] != NNUE_L3
+     || read_array(file, ft_biases, sizeof(int16_t), NNUE_L1)
+     || read_array(file, ft_weights, sizeof(int16_t), (size_t) NNUE_INPUTS * NNUE_L1)
+     || read_array(file, l1_biases, sizeof(int32_t), NNUE_L2)
+     || read_array(file, l1_weights, sizeof(int8_t), NNUE_L2 * 2 * NNUE_L1)
+     || read_array(file, l2_biases, sizeof(int32_t), NNUE_L3)
+     || read_array(file, l2_weights, sizeof(int8_t), NNUE_L3 * NNUE_L2)
+     || read_array(file, &out_bias, sizeof(int32_t), 1)
+     || read_array(file, out_weights, sizeof(int8_t), NNUE_L3);
+
+  fclose(file);
+  loaded = !err;
+  // cached scores belong to the previous network
+  eval_cache_clear();
+  return err;
+}
+
+static uint64_t
+xorshift64star(uint64_t *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1Dull;
+}
+
+// uniform in [-range, range]
+static int
+random_weight(uint64_t *state, int range)
+{
+  return (int) (xorshift64star(state) % (2 * range + 1)) - range;
+}
+
+void
+nnue_init_random(uint64_t seed)
+{
+  uint64_t state = seed ? seed : 1;
+  size_t i, j;
+
+  if (alloc_weights()) return;
+
+  for (i = 0; i < NNUE_L1; ++i) ft_biases[i] = random_weight(&state, 64);
+  for (i = 0; i < (size_t) NNUE_INPUTS * NNUE_L1; ++i) ft_weights[i] = random_weight(&state, 32);
+  for (i = 0; i < NNUE_L2; ++i)
+  {
+    l1_biases[i] = random_weight(&state, 1024);
+    for (j = 0; j < 2 * NNUE_L1; ++j) l1_weights[i][j] = random_weight(&state, 16);
+  }
+  for (i = 0; i < NNUE_L3; ++i)
+  {
+    l2_biases[i] = random_weight(&state, 1024);
+    for (j = 0; j < NNUE_L2; ++j) l2_weights[i][j] = random_weight(&state, 32);
+  }
+  out_bias = random_weight(&state, 256);
+  for (i = 0; i < NNUE_L3; ++i) out_weights[i] = random_weight(&state, 64);
+
+  loaded = 1;
+  eval_cache_clear();
+}
+
+int
+nnue_is_loaded(void)
+{
+  return loaded;
+}
+
+void
+nnue_unload(void)
+{
+  loaded = 0;
+  eval_cache_clear();
+}
+
+
+/* ACCUMULATOR */
+static inline int
+is_king(piece_type pt)
+{
+  return pt == PT_WK || pt == PT_BK;
+}
+
+static inline unsigned
+piece_color_index(piece_type pt)
+{
+  return pt >= PT_BP;
+}
+
+// feature of a non-king piece seen from `perspective`; black sees the board mirrored
+static inline size_t
+feature_index(unsigned perspective, square king, piece_type pt, square sq)
+{
+  unsigned relative = pt - (piece_color_index(pt) ? PT_BP : PT_WP),
+           index    = 2 * relative + (piece_color_index(pt) != perspective);
+
+  if (perspective)
+  {
+    king ^= 56;
+    sq   ^= 56;
+  }
+  return ((size_t) king * 10 + index) * NUM_SQUARES + sq;
+}
+
+static inline square
+king_square(const game_state *game, unsigned perspective)
+{
+  // GCC
+  return __builtin_ctzll(game->board.bitboards[perspective ? PT_BK : PT_WK]);
+}
+
+static void
+refresh(struct nnue_accumulator *acc, const game_state *game, unsigned perspective)
+{
+  square king = king_square(game, perspective), sq;
+  piece_type pt;
+
+  memcpy(acc->values[perspective], ft_biases, sizeof(ft_biases));
+  for (sq = a1; sq < NUM_SQUARES; ++sq)
+  {
+    pt = game->board.types[sq];
+    if (pt == PT_NONE || is_king(pt)) continue;
+    add_row(acc->values[perspective], ft_weights + feature_index(perspective, king, pt, sq) * NNUE_L1);
+  }
+  acc->computed[perspective] = 1;
+  ++stats.refreshes;
+}
+
+static inline int
+moves_own_king(const struct nnue_accumulator *acc, unsigned perspective)
+{
+  size_t i;
+
+  for (i = 0; i < acc->num_dirty; ++i)
+    if (acc->dirty[i].pt == (perspective ? PT_BK : PT_WK)) return 1;
+  return 0;
+}
+
+// brings the accumulator of `perspective` up to date from the closest computed ancestor
+static void
+update(struct nnue_accumulator *acc, const game_state *game, unsigned perspective)
+{
+  struct nnue_accumulator *source = acc, *next;
+  square king = king_square(game, perspective);
+  const struct nnue_dirty *d;
+  size_t i;
+
+  if (acc->computed[perspective]) return;
+
+  // a king move of the perspective changes every feature, rebuilding is cheaper than replaying
+  while (!source->computed[perspective])
+  {
+    if (source == stack || moves_own_king(source, perspective))
+    {
+      refresh(acc, game, perspective);
+      return;
+    }
+    --source;
+  }
+
+  for (next = source + 1; next <= acc; ++next)
+  {
+    memcpy(next->values[perspective], (next - 1)->values[perspective], sizeof(next->values[perspective]));
+    for (i = 0; i < next->num_dirty; ++i)
+    {
+      d = &next->dirty[i];
+      if (is_king(d->pt)) continue;
+      (d->add ? add_row : sub_row)(next->values[perspective],
+                                   ft_weights + feature_index(perspective, king, d->pt, d->sq) * NNUE_L1);
+    }
+    next->computed[perspective] = 1;
+    ++stats.updates;
+  }
+}
+
+void
+nnue_attach(game_state *game)
+{
+  if (!stack) stack = aligned_alloc(64, sizeof(struct nnue_accumulator) * NNUE_STACK_SIZE);
+  if (!stack) return;
+
+  stack->num_dirty = 0;
+  refresh(stack, game, 0);
+  refresh(stack, game, 1);
+  game->nnue = stack;
+}
+
+void
+nnue_detach(game_state *game)
+{
+  game->nnue = NULL;
+}
+
+void
+nnue_stack_free(void)
+{
+  free(stack);
+  stack = NULL;
+}
+
+
+/* EVALUATION */
+static int
+propagate(const struct nnue_accumulator *acc, color active)
+{
+  uint8_t input[2 * NNUE_L1] __attribute__((aligned(64)));
+  uint8_t hidden1[NNUE_L2] __attribute__((aligned(64)));
+  uint8_t hidden2[NNUE_L3] __attribute__((aligned(64)));
+  int32_t sums[NNUE_L2 > NNUE_L3 ? NNUE_L2 : NNUE_L3];
+  unsigned us = COLOR_INDEX(active);
+  int32_t output;
+  size_t i;
+
+  // the side to move comes first, so the net always sees its own half in the same place
+  crelu16(acc->values[us], input, NNUE_L1);
+  crelu16(acc->values[!us], input + NNUE_L1, NNUE_L1);
+
+#define NNUE_CRELU_HIDDEN(out, n) \
+  for (i = 0; i < (n); ++i) \
+  { \
+    int32_t v = sums[i] >> NNUE_WEIGHT_SHIFT; \
+    (out)[i] = v < 0 ? 0 : v > 127 ? 127 : v; \
+  }
+
+  affine(input, 2 * NNUE_L1, &l1_weights[0][0], l1_biases, NNUE_L2, sums);
+  NNUE_CRELU_HIDDEN(hidden1, NNUE_L2);
+  affine(hidden1, NNUE_L2, &l2_weights[0][0], l2_biases, NNUE_L3, sums);
+  NNUE_CRELU_HIDDEN(hidden2, NNUE_L3);
+#undef NNUE_CRELU_HIDDEN
+
+  affine(hidden2, NNUE_L3, out_weights, &out_bias, 1, &output);
+
+  return output / NNUE_OUTPUT_SCALE;
+}
+
+int
+nnue_evaluate(game_state *game)
+{
+  struct nnue_accumulator *acc = game->nnue;
+
+  ++stats.evaluations;
+  update(acc, game, 0);
+  update(acc, game, 1);
+  return propagate(acc, game->active);
+}
+
+int
+nnue_evaluate_fresh(game_state *game)
+{
+  static _Thread_local struct nnue_accumulator acc;
+
+  ++stats.evaluations;
+  refresh(&acc, game, 0);
+  refresh(&acc, game, 1);
+  return propagate(&acc, game->active);
+}
+
+struct nnue_stats
+nnue_stats(void)
+{
+  return stats;
+}
+
+void
+nnue_stats_reset(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,73 @@
+#ifndef SCHESS_NNUE_H
+#define SCHESS_NNUE_H
+
+#include <schess/cpu.h>
+#include <schess/types.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * HalfKP network: (own king square x non-king piece x square) features per perspective,
+ * a 2 x NNUE_L1 int16 accumulator, then two clipped ReLU int8 layers and one output.
+ */
+#define NNUE_INPUTS (NUM_SQUARES * 10 * NUM_SQUARES)
+#define NNUE_L1 256
+#define NNUE_L2 32
+#define NNUE_L3 32
+#define NNUE_STACK_SIZE 256
+
+struct nnue_dirty
+{
+  piece_type pt;
+  square sq;
+  int add;
+};
+
+struct nnue_accumulator
+{
+  int16_t values[2][NNUE_L1] __attribute__((aligned(64))); // per COLOR_INDEX perspective
+  int computed[2];
+  // board changes of the move that led here
+  size_t num_dirty;
+  struct nnue_dirty dirty[4];
+};
+
+struct nnue_stats
+{
+  uint64_t evaluations, refreshes, updates;
+};
+
+// records a piece change on the current accumulator; called by move_make
+static inline void
+nnue_record(struct nnue_accumulator *acc, piece_type pt, square sq, int add)
+{
+  acc->dirty[acc->num_dirty++] = (struct nnue_dirty) { pt, sq, add };
+}
+
+// reads a network file; returns 0 on success
+int nnue_load(const char *path);
+// random weights of the right shape, for benchmarks and tests
+void nnue_init_random(uint64_t seed);
+int nnue_is_loaded(void);
+// back to the handcrafted evaluation; the weights stay allocated for the next network
+void nnue_unload(void);
+
+// kernels used by the evaluation; returns the level actually in use
+enum CPU_LEVEL nnue_select_kernels(enum CPU_LEVEL level);
+
+// points `game` at the calling thread's accumulator stack and refreshes its root
+void nnue_attach(game_state *game);
+void nnue_detach(game_state *game);
+// releases the calling thread's stack
+void nnue_stack_free(void);
+
+// score from the point of view of the side to move
+int nnue_evaluate(game_state *game);
+// evaluation with both accumulators rebuilt from the board, ignoring the stack
+int nnue_evaluate_fresh(game_state *game);
+
+// counters of the calling thread
+struct nnue_stats nnue_stats(void);
+void nnue_stats_reset(void);
+
+#endif // SCHESS_NNUE_H
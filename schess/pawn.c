@@ -0,0 +1,203 @@
+#include <schess/pawn.h>
+#include <stdlib.h>
+
+static const bitboard a_file = 0x0101010101010101;
+static const bitboard h_file = 0x8080808080808080;
+
+static int doubled[2]  = { -10, -25 };  // midgame, endgame
+static int isolated[2] = {  -5, -15 };
+// by relative rank
+static int passed_mg[8] = { 0,  0,  5, 10, 20, 35,  60, 0 };
+static int passed_eg[8] = { 0, 10, 15, 25, 45, 75, 120, 0 };
+// by distance of the closest own pawn in front of the king; 0 is no pawn in reach
+static int shield_mg[3] = { -20, 15, 8 };
+
+#define PARAM(array) { "pawn_" #array, (int *) (array), sizeof(array) / sizeof(int) }
+const struct eval_param pawn_params[] =
+{
+  PARAM(doubled),
+  PARAM(isolated),
+  PARAM(passed_mg),
+  PARAM(passed_eg),
+  PARAM(shield_mg),
+};
+#undef PARAM
+const size_t pawn_num_params = sizeof(pawn_params) / sizeof(*pawn_params);
+
+static bitboard file_bb[8];
+static bitboard adjacent_files[8];
+static bitboard front_span[2][NUM_SQUARES];   // same file, ahead of the square
+static bitboard passed_mask[2][NUM_SQUARES];  // own and adjacent files, ahead of the square
+
+static inline bitboard
+north_fill(bitboard b)
+{
+  b |= b << 8;
+  b |= b << 16;
+  b |= b << 32;
+  return b;
+}
+static inline bitboard
+south_fill(bitboard b)
+{
+  b |= b >> 8;
+  b |= b >> 16;
+  b |= b >> 32;
+  return b;
+}
+
+// GCC
+__attribute__((constructor)) static void
+pawn_init_masks(void)
+{
+  unsigned file;
+  square sq;
+  bitboard ahead;
+
+  for (file = 0; file < 8; ++file)
+    file_bb[file] = a_file << file;
+  for (file = 0; file < 8; ++file)
+    adjacent_files[file] = (file > 0 ? file_bb[file - 1] : 0) | (file < 7 ? file_bb[file + 1] : 0);
+
+  for (sq = a1; sq < NUM_SQUARES; ++sq)
+  {
+    ahead = north_fill(sq2bb(sq) << 8);
+    front_span[0][sq]  = ahead;
+    passed_mask[0][sq] = ahead | (((ahead << 1) & ~a_file) | ((ahead >> 1) & ~h_file));
+
+    ahead = south_fill(sq2bb(sq) >> 8);
+    front_span[1][sq]  = ahead;
+    passed_mask[1][sq] = ahead | (((ahead << 1) & ~a_file) | ((ahead >> 1) & ~h_file));
+  }
+}
+
+static void
+pawn_evaluate(board_state *board, struct pawn_entry *e)
+{
+  bitboard own, other, copy;
+  square sq;
+  unsigned side, file, rank;
+  int mg, eg;
+
+  e->mg = e->eg = 0;
+
+  for (side = 0; side < 2; ++side)
+  {
+    own   = board->bitboards[side ? PT_BP : PT_WP];
+    other = board->bitboards[side ? PT_WP : PT_BP];
+    mg = eg = 0;
+
+    e->attacks[side] = side
+      ? ((own >> 7) & ~a_file) | ((own >> 9) & ~h_file)
+      : ((own << 9) & ~a_file) | ((own << 7) & ~h_file);
+    e->attack_spans[side] = side ? south_fill(e->attacks[side]) : north_fill(e->attacks[side]);
+    e->passed[side] = 0;
+
+    for (copy = own; copy; copy &= copy - 1)
+    {
+      // GCC
+      sq = __builtin_ctzll(copy);
+      file = sq & 7;
+      rank = side ? 7 - (sq >> 3) : sq >> 3;
+
+      if (own & front_span[side][sq])
+      {
+        // only the front pawn of a file can be passed
+        mg += doubled[0];
+        eg += doubled[1];
+      }
+      else if (!(other & passed_mask[side][sq]))
+      {
+        e->passed[side] |= sq2bb(sq);
+        mg += passed_mg[rank];
+        eg += passed_eg[rank];
+      }
+
+      if (!(own & adjacent_files[file]))
+      {
+        mg += isolated[0];
+        eg += isolated[1];
+      }
+    }
+
+    e->mg += side ? -mg : mg;
+    e->eg += side ? -eg : eg;
+  }
+}
+
+static int
+pawn_shield(board_state *board, unsigned side, square king)
+{
+  bitboard own = board->bitboards[side ? PT_BP : PT_WP], in_front;
+  unsigned file = king & 7, f;
+  int shield = 0;
+  square closest;
+  int distance;
+
+  for (f = file > 0 ? file - 1 : 0; f <= file + 1 && f < 8; ++f)
+  {
+    in_front = own & file_bb[f] & passed_mask[side][king];
+    if (!in_front)
+    {
+      shield += shield_mg[0];
+      continue;
+    }
+
+    // GCC
+    closest = side ? 63 - __builtin_clzll(in_front) : __builtin_ctzll(in_front);
+    distance = side ? (king >> 3) - (closest >> 3) : (closest >> 3) - (king >> 3);
+    shield += distance < 3 ? shield_mg[distance] : shield_mg[0];
+  }
+
+  return shield;
+}
+
+
+static _Thread_local struct pawn_entry *pawn_table;
+// what pawn_probe evaluates into while the table could not be allocated
+static _Thread_local struct pawn_entry pawn_uncached;
+
+struct pawn_entry *
+pawn_probe(game_state *game)
+{
+  struct pawn_entry *e;
+  square king;
+  size_t i;
+  unsigned side;
+
+  if (!pawn_table)
+  {
+    pawn_table = calloc(1ull << PAWN_TABLE_BITS, sizeof(struct pawn_entry));
+    // key 0 (no pawns) hits fresh entries, so only the shields need invalidating
+    for (i = 0; pawn_table && i < (1ull << PAWN_TABLE_BITS); ++i)
+      pawn_table[i].shield_king[0] = pawn_table[i].shield_king[1] = NUM_SQUARES;
+  }
+
+  // without a table every probe misses; the allocation is retried by the next one
+  e = pawn_table ? &pawn_table[game->pawn_key & ((1ull << PAWN_TABLE_BITS) - 1)] : &pawn_uncached;
+  if (e->key != game->pawn_key || !pawn_table)
+  {
+    e->key = game->pawn_key;
+    pawn_evaluate(&game->board, e);
+    e->shield_king[0] = e->shield_king[1] = NUM_SQUARES;
+  }
+
+  for (side = 0; side < 2; ++side)
+  {
+    // GCC
+    king = __builtin_ctzll(game->board.bitboards[side ? PT_BK : PT_WK] | (1ull << 63));
+    if (e->shield_king[side] == king) continue;
+
+    e->shield_king[side] = king;
+    e->shield[side] = pawn_shield(&game->board, side, king);
+  }
+
+  return e;
+}
+
+void
+pawn_table_free(void)
+{
+  free(pawn_table);
+  pawn_table = NULL;
+}
@@ -0,0 +1,33 @@
+#ifndef SCHESS_PAWN_H
+#define SCHESS_PAWN_H
+
+#include <schess/eval.h>
+#include <schess/types.h>
+#include <stdint.h>
+
+#define PAWN_TABLE_BITS 13
+
+/* pawn structure terms, cached per thread under the pawn zobrist key */
+struct pawn_entry
+{
+  uint64_t key;
+  int mg, eg;                // white relative passed, isolated and doubled pawn terms
+  bitboard passed[2];        // per COLOR_INDEX
+  bitboard attacks[2];
+  bitboard attack_spans[2];  // every square the pawns could attack while advancing
+  square shield_king[2];     // king square the shield below was computed for
+  int shield[2];             // midgame pawn shelter of that king, from its own side's view
+};
+
+// entry for the pawns of `game`, evaluated on a miss; the shields follow the current king squares.
+// if the table cannot be allocated, the entry is evaluated uncached and valid until the next probe
+struct pawn_entry *pawn_probe(game_state *game);
+
+// tunable weights of the pawn terms, see eval_params
+extern const struct eval_param pawn_params[];
+extern const size_t pawn_num_params;
+
+// releases the calling thread's table
+void pawn_table_free(void);
+
+#endif // SCHESS_PAWN_H
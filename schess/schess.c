@@ -1,20 +1,92 @@
 #include <errno.h>
+#include <schess/eval.h>
 #include <schess/gen.h>
 #include <schess/move.h>
+#include <schess/nnue.h>
 #include <schess/search.h>
+#include <schess/tb.h>
 #include <schess/types.h>
+#include <schess/uci.h>
 #include <schess/utils.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define EVAL_STREAM_BATCH 4096
+
+// one FEN per line in, one score (side to move, centipawns) per line out; '-' for a bad FEN
+static int
+eval_stream(FILE *in, FILE *out)
+{
+  static game_state games[EVAL_STREAM_BATCH];
+  static int scores[EVAL_STREAM_BATCH];
+  static char valid[EVAL_STREAM_BATCH];
+  irreversable_state meta;
+  char line[256];
+  size_t i, n, count;
+  int done = 0;
+
+  while (!done)
+  {
+    // invalid lines keep their place, so the output stays aligned with the input
+    for (n = count = 0; n < EVAL_STREAM_BATCH; ++n)
+    {
+      if (!fgets(line, sizeof(line), in)) { done = 1; break; }
+      line[strcspn(line, "\r\n")] = '\0';
+      valid[n] = !parse_FEN(line, &games[count], &meta);
+      count += valid[n];
+    }
+
+    eval_batch(games, count, scores);
+    for (i = count = 0; i < n; ++i)
+    {
+      if (valid[i]) fprintf(out, "%d\n", scores[count++]);
+      else fputs("-\n", out);
+    }
+  }
+
+  return fflush(out) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 int main(int argc, char **argv)
 {
-  printf("SCHESS ENGINE by Kilian Chung\n");
   move_gen_init_LUTs();
 
-  if (argc == 1) return EXIT_SUCCESS;
-  if (argc != 3) return EXIT_FAILURE;
+  // schess --eval [network]: labels positions without searching them
+  if (argc >= 2 && !strcmp(argv[1], "--eval"))
+  {
+    if (argc > 3) return EXIT_FAILURE;
+    if (argc == 3 && nnue_load(argv[2]))
+    {
+      fprintf(stderr, "Error loading network %s\n", argv[2]);
+      return EXIT_FAILURE;
+    }
+    return eval_stream(stdin, stdout);
+  }
+
+  printf("SCHESS ENGINE by Kilian Chung\n");
+  tb_init(TB_DEFAULT_DIR);
+
+  // without arguments the engine talks UCI on stdin/stdout
+  if (argc == 1) return uci_loop(stdin, stdout) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+  // schess [--multipv n] <FEN file> <depth> [network]: the n best moves, one per line
+  size_t multipv = 1;
+  if (argc >= 3 && !strcmp(argv[1], "--multipv"))
+  {
+    multipv = strtoul(argv[2], NULL, 10);
+    if (multipv < 1 || multipv > SEARCH_MAX_MULTIPV) return EXIT_FAILURE;
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc != 3 && argc != 4) return EXIT_FAILURE;
+
+  // optional network file, the classical evaluation is used without one
+  if (argc == 4 && nnue_load(argv[3]))
+  {
+    fprintf(stderr, "Error loading network %s\n", argv[3]);
+    return EXIT_FAILURE;
+  }
 
   FILE *fp = fopen (argv[1], "rb");
   size_t length;
@@ -29,24 +101,50 @@ int main(int argc, char **argv)
   fseek(fp, 0, SEEK_END);
   length = ftell(fp);
   fseek(fp, 0, SEEK_SET);
-  FEN = malloc(length);
+  FEN = malloc(length + 1);
   if (!FEN)
   {
     fprintf(stderr, "Error allocating string buffer: %s\n", strerror(errno));
     return EXIT_FAILURE;
   }
-  fread(FEN, 1, length, fp);
+  length = fread(FEN, 1, length, fp);
   fclose (fp);
+  FEN[length] = '\0';
+  FEN[strcspn(FEN, "\r\n")] = '\0';
 
   unsigned depth = strtoul(argv[2], NULL, 10);
 
   game_state game;
   irreversable_state meta;
 
-  parse_FEN(FEN, &game, &meta);
-  move best = search_best_move(&game, meta, depth);
-  print_move(&game.board, best);
-  printf("\n");
+  if (parse_FEN(FEN, &game, &meta))
+  {
+    fprintf(stderr, "Invalid FEN in %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  if (multipv == 1)
+  {
+    move best = search_best_move(&game, meta, depth);
+    print_move(&game.board, best);
+    printf("\n");
+    return EXIT_SUCCESS;
+  }
+
+  static struct search_line lines[SEARCH_MAX_MULTIPV];
+  size_t i, j, num_lines = search_best_moves(&game, meta, depth, lines, multipv);
+  char name[6];
+  for (i = 0; i < num_lines; ++i)
+  {
+    printf("%zu. ", i + 1);
+    print_move(&game.board, lines[i].best);
+    printf(" score %d depth %u nodes %llu pv", lines[i].score, lines[i].depth, (unsigned long long) lines[i].nodes);
+    for (j = 0; j < lines[i].pv_length; ++j)
+    {
+      move_to_UCI(lines[i].pv[j], name);
+      printf(" %s", name);
+    }
+    printf("\n");
+  }
 
   return EXIT_SUCCESS;
 }
@@ -1,77 +1,1531 @@
+#include <pthread.h>
+#include <sched.h>
+#include <schess/attacks.h>
 #include <schess/eval.h>
 #include <schess/gen.h>
+#include <schess/material.h>
 #include <schess/move.h>
+#include <schess/nnue.h>
+#include <schess/pawn.h>
 #include <schess/search.h>
+#include <schess/tb.h>
+#include <schess/tt.h>
 #include <schess/utils.h>
+#include <schess/zobrist.h>
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-int quiesce(game_state *game, irreversable_state meta, int alpha, int beta)
+// nodes between two looks at the clock
+#define SEARCH_CHECK_INTERVAL 1024
+// milliseconds kept back from the clock for the GUI and the wire
+#define SEARCH_MOVE_OVERHEAD 30
+// moves the remaining time is split into without movestogo
+#define SEARCH_MOVES_TO_GO 30
+// remaining depth from which a hashed move is tested for being singular
+#define SEARCH_SINGULAR_DEPTH 6
+// centipawns per ply of depth every other move must stay below the hashed one's score
+#define SEARCH_SINGULAR_MARGIN 8
+// remaining depth from which a node without a hashed move is searched SEARCH_IID_REDUCTION
+// plies shallower first for one (SCHESS_SEARCH_IID), or else searched a ply shallower itself
+#ifdef SCHESS_SEARCH_IID
+#define SEARCH_IID_DEPTH 5
+#define SEARCH_IID_REDUCTION 2
+#else
+#define SEARCH_IIR_DEPTH 6
+#endif
+// the history scores stay within +-SEARCH_HISTORY_MAX, a cutoff at depth d moves them by d * d * 16 at most
+#define SEARCH_HISTORY_MAX 16384
+#define SEARCH_HISTORY_BONUS_MAX 1536
+
+// move ordering after the hashed move: captures by MVV-LVA, killers, the countermove, the
+// other quiet moves by history
+#define ORDER_CAPTURE (1 << 24)
+#define ORDER_KILLER (1 << 20)
+#define ORDER_COUNTER (ORDER_KILLER - 2)
+
+// remaining depth from which the moves after a node's first one are shared with idle threads
+#define SEARCH_SPLIT_DEPTH 4
+// split points a thread can have open at once, one per ply it is the master of
+#define SEARCH_MAX_SPLITS 8
+
+// the moving piece and its destination, what continuation histories are keyed by
+struct search_played
+{
+  piece_type piece;
+  square to;
+};
+
+/*
+ * quiet move ordering, learnt from the cutoffs of a thread's searches. kept from one search
+ * to the next, where the histories start at half their scores and the killers are dropped
+ */
+struct search_tables
+{
+  move killers[MAX_PLY + 1][2];                  // the last two quiet cutoffs at the ply
+  move countermoves[PT_COUNT][NUM_SQUARES];      // the quiet cutoff answering the previous move
+  int16_t history[2][NUM_SQUARES][NUM_SQUARES];  // butterfly, by COLOR_INDEX, from and to
+  // by the move one ([0]) or two ([1]) plies back, then by the move itself
+  int16_t continuation[2][PT_COUNT][NUM_SQUARES][PT_COUNT][NUM_SQUARES];
+};
+
+/*
+ * a node whose remaining moves are searched by its thread and the idle threads it recruited
+ * (YBWC). each worker searches from its own copy of the position; the fields below `lock` are
+ * only touched with it held
+ */
+struct split_point
 {
-  (void) alpha;
-  (void) beta;
+  struct split_point *parent;  // of the thread opening it, a cutoff there ends this one too
+  game_state game;
+  irreversable_state meta;
+  uint64_t keys[SEARCH_MAX_HISTORY + MAX_PLY + 1];
+  size_t num_keys, root_index;
+  struct search_played played[MAX_PLY + 1];
+  unsigned root_depth, depth;
+  int ply, beta, futile;
+  move hashed;
+  uint64_t workers;            // atomic, a bit per thread index still searching here
+
+  char lock;                   // spinlock
+  struct move_buffer *moves;   // the master's ordered moves, taken from `next` on
+  int *scores;
+  size_t next;
+  int alpha, alpha_raised, cutoff;
+  unsigned legal;
+  move best;
+  unsigned pv_length;
+  move pv[MAX_PLY];
+};
+
+struct search_thread
+{
+  pthread_t id;
+  unsigned index;              // 0 is the thread that reports
+  game_state game;
+  irreversable_state meta;
+  uint64_t nodes;              // written by its thread only, summed up by the first
+  // keys of the game before the root, the root and the nodes above the current one
+  uint64_t keys[SEARCH_MAX_HISTORY + MAX_PLY + 1];
+  size_t num_keys, root_index;
+  struct move_buffer *root;    // legal root moves, best first
+  struct search_info result;
+
+  // triangular: the line below the node at ply p, from the move played there on
+  move pv[MAX_PLY + 1][MAX_PLY];
+  unsigned pv_length[MAX_PLY + 1];
+  // the previous iteration's line of the root move searched first, followed while
+  // follow_pv is set; only the first child of a node on it stays on it
+  const struct search_line *previous_pv;
+  int follow_pv;
+
+  // a path may extend by as many plies as the iteration is deep, so it ends by 2 * root_depth
+  unsigned root_depth;
+  // the move a singular extension test leaves out at the ply, NULL outside one
+  const move *excluded[MAX_PLY + 1];
+
+  struct search_played played[MAX_PLY + 1];      // the move made at the ply
+  struct search_tables *tables;                  // tables[index]
+
+  // YBWC: the split point handed to the thread while it idles (atomic), the innermost one it
+  // searches below, and the ones it opened
+  struct split_point *work;
+  struct split_point *split;
+  struct split_point splits[SEARCH_MAX_SPLITS];
+  unsigned num_splits;
+  int idle;                    // atomic, changed under control.pool_lock
 
-  int res = eval_position(game, meta);
+  struct search_stats stats;   // added to the global ones once the search is over
+};
 
-  return res;
+/* shared by the threads of the running search */
+static struct
+{
+  int stop, pondering;         // atomic
+  uint64_t start;              // milliseconds, atomic: ponderhit restarts the clock
+  unsigned long soft, hard;    // no iteration starts after soft, hard stops the search; 0 for none
+  struct search_limits limits;
+  struct search_thread *threads;
+  unsigned num_threads;
+
+  // YBWC: threads waiting for a split point, and whether the search is over for them
+  char pool_lock;              // spinlock
+  unsigned idle;               // atomic, changed under pool_lock
+  int finished;                // under pool_lock
+} control;
+
+static unsigned num_threads = 1;
+// one per thread index, grown to the largest thread count searched with so far
+static struct search_tables *tables;
+static unsigned num_tables;
+static enum SEARCH_PARALLEL parallel = SEARCH_LAZY_SMP;
+
+struct search_pruning search_pruning =
+{
+  .reverse_futility_depth = 6, .reverse_futility_margin = 80,
+  .futility_depth = 4, .futility_margin = 120,
+  .razoring_depth = 2, .razoring_margin = 300,
+  .probcut_depth = 3, .probcut_margin = 100, .probcut_reduction = 2,
+};
+
+// of the searches since the last search_stats_reset, summed over their threads
+static struct search_stats stats;
+
+// LINUX
+static uint64_t
+now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-int
-alpha_beta(game_state *game, irreversable_state meta, int alpha, int beta, unsigned depth, struct move_buffer *mbuf)
+static inline int
+stopped(void)
 {
-  if (!depth) return quiesce(game, meta, alpha, beta);
-  depth -= 1;
+  return __atomic_load_n(&control.stop, __ATOMIC_RELAXED); // GCC
+}
 
-  size_t i, num_moves;
-  int score = 42;
-  irreversable_state meta_copy;
-  int mate;
+// GCC // X86
+static inline void
+spin_lock(char *lock)
+{
+  while (__atomic_test_and_set(lock, __ATOMIC_ACQUIRE))
+    while (__atomic_load_n(lock, __ATOMIC_RELAXED)) __builtin_ia32_pause();
+}
+
+static inline void
+spin_unlock(char *lock)
+{
+  __atomic_clear(lock, __ATOMIC_RELEASE); // GCC
+}
+
+// a stop, or a cutoff at one of the split points the thread searches below
+static inline int
+aborted(const struct search_thread *thread)
+{
+  const struct split_point *sp;
+
+  if (stopped()) return 1;
+  for (sp = thread->split; sp; sp = sp->parent)
+    if (__atomic_load_n(&sp->cutoff, __ATOMIC_RELAXED)) return 1; // GCC
+  return 0;
+}
+
+static inline unsigned long
+elapsed_ms(void)
+{
+  return now_ms() - __atomic_load_n(&control.start, __ATOMIC_RELAXED); // GCC
+}
+
+static uint64_t
+total_nodes(void)
+{
+  uint64_t nodes = 0;
+  unsigned t;
 
-  num_moves = generate_moves(game, meta, &mbuf[depth]);
+  for (t = 0; t < control.num_threads; ++t)
+    nodes += __atomic_load_n(&control.threads[t].nodes, __ATOMIC_RELAXED); // GCC
+  return nodes;
+}
+
+// called by the first thread every SEARCH_CHECK_INTERVAL nodes
+static void
+search_check_limits(void)
+{
+  if (control.hard && !__atomic_load_n(&control.pondering, __ATOMIC_RELAXED) && elapsed_ms() >= control.hard) // GCC
+    search_stop();
+  if (control.limits.nodes && total_nodes() >= control.limits.nodes)
+    search_stop();
+}
+
+
+/*
+ * whether the position occurred before since the last capture or pawn move: once inside
+ * the tree is enough, as the side that allowed it could repeat it, before the root it
+ * takes two occurrences
+ */
+static inline int
+is_repetition(const struct search_thread *thread, uint64_t key, unsigned halfmove_clock)
+{
+  size_t n = thread->num_keys, back;
+  unsigned seen = 0;
 
-  for (i = 0; i < num_moves; ++i)
+  // the side to move must be the same and no position repeats within four plies
+  for (back = 4; back <= halfmove_clock && back <= n; back += 2)
+  {
+    if (thread->keys[n - back] != key) continue;
+    if (n - back > thread->root_index || ++seen == 2) return 1;
+  }
+  return 0;
+}
+
+static int alpha_beta_white(struct search_thread *thread, game_state *game, irreversable_state meta, int alpha, int beta, unsigned depth);
+static int alpha_beta_black(struct search_thread *thread, game_state *game, irreversable_state meta, int alpha, int beta, unsigned depth);
+
+static inline int
+move_equal(move a, move b)
+{
+  return a.from == b.from && a.to == b.to && a.type == b.type;
+}
+
+// `m` followed by the line below it
+static inline void
+pv_update(struct search_thread *thread, int ply, move m)
+{
+  thread->pv[ply][0] = m;
+  memcpy(thread->pv[ply] + 1, thread->pv[ply + 1], thread->pv_length[ply + 1] * sizeof(move));
+  thread->pv_length[ply] = thread->pv_length[ply + 1] + 1;
+}
+
+// mate scores count plies from the root, the table keeps them from the node they belong to
+static inline int
+score_to_tt(int score, int ply)
+{
+  return score >= MATE_BOUND ? score + ply : score <= -MATE_BOUND ? score - ply : score;
+}
+
+static inline int
+score_from_tt(int score, int ply)
+{
+  return score >= MATE_BOUND ? score - ply : score <= -MATE_BOUND ? score + ply : score;
+}
+
+// for the few nodes that must tell mate apart before their moves are searched
+ALWAYS_INLINE int
+has_legal_move_color(game_state *game, irreversable_state meta, const color us)
+{
+  struct move_set set;
+  irreversable_state meta_copy;
+  int legal = 0;
+  move m;
+
+  COLORED(generate_move_set, us)(game, meta, &set);
+  while (!legal && move_set_next(&set, game->board.types, &m))
   {
-    move *m = mbuf[depth].moves + i;
     meta_copy = meta;
+    COLORED(move_make, us)(&m, game, &meta_copy);
+    legal = COLORED(is_board_legal, OTHER_COLOR(us))(&game->board);
+    COLORED(move_unmake, us)(&m, game);
+  }
+  return legal;
+}
+
+static int
+has_legal_move_white(game_state *game, irreversable_state meta)
+{
+  return has_legal_move_color(game, meta, COLOR_WHITE);
+}
+static int
+has_legal_move_black(game_state *game, irreversable_state meta)
+{
+  return has_legal_move_color(game, meta, COLOR_BLACK);
+}
+
+
+/* MOVE ORDERING */
+static inline int
+is_quiet(move m)
+{
+  return m.capture == PT_NONE && m.type != MT_EN_PASSANT && m.type < MT_PROMOTION_KNIGHT;
+}
+
+// the moves one and two plies above the node at `ply`, PT_NONE ones before the root
+static inline void
+played_before(const struct search_thread *thread, int ply, struct search_played before[2])
+{
+  before[0] = ply > 0 ? thread->played[ply - 1] : (struct search_played) { PT_NONE, a1 };
+  before[1] = ply > 1 ? thread->played[ply - 2] : (struct search_played) { PT_NONE, a1 };
+}
+
+// gravity: the closer a score gets to the bound, the less a bonus of its sign moves it
+static inline void
+history_update(int16_t *h, int bonus)
+{
+  *h += bonus - *h * abs(bonus) / SEARCH_HISTORY_MAX;
+}
+
+static void
+history_add(struct search_thread *thread, const board_state *board, const struct search_played before[2],
+            move m, int side, int bonus)
+{
+  piece_type piece = board->types[m.from];
+  int back;
+
+  history_update(&thread->tables->history[side][m.from][m.to], bonus);
+  for (back = 0; back < 2; ++back)
+    if (before[back].piece != PT_NONE)
+      history_update(&thread->tables->continuation[back][before[back].piece][before[back].to][piece][m.to], bonus);
+}
+
+// the quiet move `best` failed high after the quiet moves `tried` did not
+static void
+history_reward(struct search_thread *thread, const board_state *board, int ply, const struct search_played before[2],
+               move best, const move *tried, size_t num_tried, unsigned depth, int side)
+{
+  const int bonus = depth * depth * 16 < SEARCH_HISTORY_BONUS_MAX ? (int) (depth * depth * 16) : SEARCH_HISTORY_BONUS_MAX;
+  size_t i;
+
+  if (!move_equal(thread->tables->killers[ply][0], best))
+  {
+    thread->tables->killers[ply][1] = thread->tables->killers[ply][0];
+    thread->tables->killers[ply][0] = best;
+  }
+  if (before[0].piece != PT_NONE) thread->tables->countermoves[before[0].piece][before[0].to] = best;
+
+  history_add(thread, board, before, best, side, bonus);
+  for (i = 0; i < num_tried; ++i) history_add(thread, board, before, tried[i], side, -bonus);
+}
+
+// most valuable victim, least valuable attacker; a queen promotion wins a queen
+static inline int
+capture_order(const board_state *board, move m)
+{
+  return ORDER_CAPTURE - (board->types[m.from] - 1) % 6
+       + 8 * (m.type == MT_EN_PASSANT ? PR_P : m.capture != PT_NONE ? (int) (m.capture - 1) % 6 : 0)
+       + 8 * (m.type == MT_PROMOTION_QUEEN ? PR_Q : 0);
+}
+
+static void
+order_moves(const struct search_thread *thread, const board_state *board, int ply, const struct search_played before[2],
+            const struct move_buffer *moves, int side, int *scores)
+{
+  const move counter = thread->tables->countermoves[before[0].piece][before[0].to];
+  const int16_t (*one)[NUM_SQUARES] = thread->tables->continuation[0][before[0].piece][before[0].to],
+                (*two)[NUM_SQUARES] = thread->tables->continuation[1][before[1].piece][before[1].to];
+  piece_type piece;
+  size_t i;
+  move m;
+
+  for (i = 0; i < moves->size; ++i)
+  {
+    m = moves->moves[i];
+    piece = board->types[m.from];
+    if (!is_quiet(m))
+    {
+      scores[i] = capture_order(board, m);
+      continue;
+    }
+    scores[i] = move_equal(m, thread->tables->killers[ply][0]) ? ORDER_KILLER
+              : move_equal(m, thread->tables->killers[ply][1]) ? ORDER_KILLER - 1
+              : move_equal(m, counter) ? ORDER_COUNTER
+              : thread->tables->history[side][m.from][m.to] + one[piece][m.to] + two[piece][m.to];
+  }
+}
+
+// moves the best scored move from `next` on to `next`
+static inline move
+order_pick(struct move_buffer *moves, int *scores, size_t next)
+{
+  size_t i, best = next;
+  move m;
+  int score;
+
+  for (i = next + 1; i < moves->size; ++i)
+    if (scores[i] > scores[best]) best = i;
+
+  m = moves->moves[best];
+  score = scores[best];
+  moves->moves[best] = moves->moves[next];
+  scores[best] = scores[next];
+  moves->moves[next] = m;
+  scores[next] = score;
+  return m;
+}
+
 
-    mate = move_make(m, game, &meta_copy);
-    if (mate) score = -mate;
-    else score = -alpha_beta(game, meta_copy, -beta, -alpha, depth, mbuf);
-    move_unmake(m, game);
+/* QUIESCENCE */
+static int quiesce_white(struct search_thread *thread, game_state *game, irreversable_state meta, int alpha, int beta, int ply);
+static int quiesce_black(struct search_thread *thread, game_state *game, irreversable_state meta, int alpha, int beta, int ply);
 
+/*
+ * captures until the position is quiet: the side to move may stand pat on the static score,
+ * or take with a capture or queen promotion that does not lose material by SEE. in check
+ * there is no standing pat, every evasion is tried. `thread` (may be NULL) counts the nodes.
+ */
+ALWAYS_INLINE int
+quiesce_color(struct search_thread *thread, game_state *game, irreversable_state meta, int alpha, int beta, int ply,
+              const color us)
+{
+  const int in_check = is_in_check(&game->board, us);
+  struct move_set set;
+  struct move_buffer moves;
+  irreversable_state meta_copy;
+  int score, scores[MAX_MOVES_NUM];
+  unsigned legal = 0;
+  size_t i, next;
+  move m;
+
+  if (thread)
+  {
+    __atomic_store_n(&thread->nodes, thread->nodes + 1, __ATOMIC_RELAXED); // GCC
+    if (!thread->index && !(thread->nodes % SEARCH_CHECK_INTERVAL)) search_check_limits();
+    if (aborted(thread)) return 0;
+  }
+
+  if (!in_check || ply >= MAX_PLY - 1)
+  {
+    score = eval_position_window(game, meta, alpha, beta);
+    if (score >= beta || ply >= MAX_PLY - 1) return score >= beta ? beta : score <= alpha ? alpha : score;
+    if (score > alpha) alpha = score;
+  }
+
+  COLORED(generate_move_set, us)(game, meta, &set);
+  move_set_serialize(&set, game->board.types, &moves);
+  for (i = 0; i < moves.size; ++i) scores[i] = is_quiet(moves.moves[i]) ? 0 : capture_order(&game->board, moves.moves[i]);
+
+  for (next = 0; next < moves.size;)
+  {
+    m = order_pick(&moves, scores, next++);
+    if (!in_check)
+    {
+      // the quiet moves come last
+      if (is_quiet(m)) break;
+      if (m.capture == PT_NONE && m.type != MT_EN_PASSANT && m.type != MT_PROMOTION_QUEEN) continue;
+      if (m.capture != PT_NONE && see(&game->board, NULL, m.from, m.to) < 0) continue;
+    }
+
+    meta_copy = meta;
+    if (COLORED(move_make, us)(&m, game, &meta_copy)) score = MATE - ply;
+    else if (!COLORED(is_board_legal, OTHER_COLOR(us))(&game->board))
+    {
+      COLORED(move_unmake, us)(&m, game);
+      continue;
+    }
+    else score = -COLORED(quiesce, OTHER_COLOR(us))(thread, game, meta_copy, -beta, -alpha, ply + 1);
+    COLORED(move_unmake, us)(&m, game);
+    ++legal;
+
+    if (thread && aborted(thread)) return 0;
     if (score >= beta) return beta;
     if (score > alpha) alpha = score;
   }
+
+  // no evasion is mate
+  if (in_check && !legal)
+  {
+    score = -MATE + ply;
+    return score >= beta ? beta : score <= alpha ? alpha : score;
+  }
   return alpha;
 }
 
-move
-search_best_move(game_state *game, irreversable_state meta, unsigned depth)
+static int
+quiesce_white(struct search_thread *thread, game_state *game, irreversable_state meta, int alpha, int beta, int ply)
+{
+  return quiesce_color(thread, game, meta, alpha, beta, ply, COLOR_WHITE);
+}
+static int
+quiesce_black(struct search_thread *thread, game_state *game, irreversable_state meta, int alpha, int beta, int ply)
+{
+  return quiesce_color(thread, game, meta, alpha, beta, ply, COLOR_BLACK);
+}
+
+int
+quiesce(game_state *game, irreversable_state meta, int alpha, int beta)
+{
+  return game->active == COLOR_WHITE
+    ? quiesce_white(NULL, game, meta, alpha, beta, 0)
+    : quiesce_black(NULL, game, meta, alpha, beta, 0);
+}
+
+
+/* SPLIT POINTS */
+/*
+ * shares the moves of the node at `ply` from `next` on with the idle threads, once its first
+ * move was searched without a cutoff; NULL if no thread is idle, then the node goes on alone
+ */
+static struct split_point *
+split_open(struct search_thread *thread, const game_state *game, irreversable_state meta, int ply, unsigned depth,
+           int alpha, int beta, int futile, move hashed, struct move_buffer *moves, int *scores, size_t next)
 {
-  size_t i, num_moves;
-  struct move_buffer *mbuf = move_buffer_create(depth);
-  int score, best_score = -oo;
-  move best = { 0 };
+  struct split_point *sp;
+  uint64_t workers = 0;
+  unsigned t;
+
+  if (parallel != SEARCH_YBWC || thread->num_splits == SEARCH_MAX_SPLITS
+      || !__atomic_load_n(&control.idle, __ATOMIC_RELAXED)) return NULL; // GCC
+
+  sp = &thread->splits[thread->num_splits];
+  sp->parent = thread->split;
+  sp->game = *game;
+  sp->meta = meta;
+  memcpy(sp->keys, thread->keys, thread->num_keys * sizeof(uint64_t));
+  sp->num_keys = thread->num_keys;
+  sp->root_index = thread->root_index;
+  memcpy(sp->played, thread->played, ply * sizeof(*sp->played));
+  sp->root_depth = thread->root_depth;
+  sp->depth = depth;
+  sp->ply = ply;
+  sp->beta = beta;
+  sp->futile = futile;
+  sp->hashed = hashed;
+  sp->lock = 0;
+  sp->moves = moves;
+  sp->scores = scores;
+  sp->next = next;
+  sp->alpha = alpha;
+  sp->alpha_raised = sp->cutoff = 0;
+  sp->legal = 0;
+  sp->best = (move) { .type = MT_NULL };
+  sp->pv_length = 0;
+
+  // a thread that sees itself no longer idle already sees its work
+  spin_lock(&control.pool_lock);
+  for (t = 1; t < control.num_threads; ++t)
+    if (control.threads[t].idle) workers |= 1ull << t;
+  sp->workers = workers;
+  for (t = 1; t < control.num_threads; ++t)
+  {
+    if (!(workers & (1ull << t))) continue;
+    __atomic_store_n(&control.threads[t].work, sp, __ATOMIC_RELEASE); // GCC
+    __atomic_store_n(&control.threads[t].idle, 0, __ATOMIC_RELEASE);
+    __atomic_sub_fetch(&control.idle, 1, __ATOMIC_RELAXED);
+  }
+  spin_unlock(&control.pool_lock);
+  if (!workers) return NULL;
+
+  ++thread->num_splits;
+  ++thread->stats.splits;
+  thread->split = sp;
+  return sp;
+}
+
+// the master's share ended: it waits for the workers to leave before its moves go out of scope
+static void
+split_close(struct search_thread *thread, struct split_point *sp)
+{
+  while (__atomic_load_n(&sp->workers, __ATOMIC_ACQUIRE)) // GCC
+  {
+    if (!thread->index) search_check_limits();
+    sched_yield();
+  }
+  thread->split = sp->parent;
+  --thread->num_splits;
+}
+
+// takes moves off the split point until none is left or one failed high, on the thread's `game`
+ALWAYS_INLINE void
+split_search_color(struct search_thread *thread, struct split_point *sp, game_state *game, const color us)
+{
+  const int ply = sp->ply;
+  struct search_played before[2];
   irreversable_state meta_copy;
+  int alpha, score;
+  move m;
 
-  if (depth == 0) return (move) { .type = MT_NULL };
-  depth -= 1;
+  played_before(thread, ply, before);
+  for (;;)
+  {
+    spin_lock(&sp->lock);
+    if (sp->cutoff || sp->next == sp->moves->size)
+    {
+      spin_unlock(&sp->lock);
+      break;
+    }
+    m = order_pick(sp->moves, sp->scores, sp->next++);
+    alpha = sp->alpha;
+    spin_unlock(&sp->lock);
+    if (move_equal(m, sp->hashed)) continue;
+
+    meta_copy = sp->meta;
+    thread->played[ply] = (struct search_played) { game->board.types[m.from], m.to };
+    if (COLORED(move_make, us)(&m, game, &meta_copy))
+    {
+      score = MATE - ply;
+      thread->pv_length[ply + 1] = 0;
+    }
+    else if (!COLORED(is_board_legal, OTHER_COLOR(us))(&game->board))
+    {
+      COLORED(move_unmake, us)(&m, game);
+      continue;
+    }
+    // the first move was searched before the split, so every other quiet one is futile
+    else if (sp->futile && is_quiet(m) && !is_in_check(&game->board, OTHER_COLOR(us)))
+    {
+      COLORED(move_unmake, us)(&m, game);
+      spin_lock(&sp->lock);
+      ++sp->legal;
+      spin_unlock(&sp->lock);
+      ++thread->stats.futility;
+      continue;
+    }
+    else score = -COLORED(alpha_beta, OTHER_COLOR(us))(thread, game, meta_copy, -sp->beta, -alpha, sp->depth - 1);
+    COLORED(move_unmake, us)(&m, game);
+
+    if (aborted(thread)) break;
+
+    spin_lock(&sp->lock);
+    ++sp->legal;
+    if (score > sp->alpha && !sp->cutoff)
+    {
+      sp->alpha = score;
+      sp->alpha_raised = 1;
+      sp->best = m;
+      sp->pv[0] = m;
+      memcpy(sp->pv + 1, thread->pv[ply + 1], thread->pv_length[ply + 1] * sizeof(move));
+      sp->pv_length = thread->pv_length[ply + 1] + 1;
+      if (score >= sp->beta) __atomic_store_n(&sp->cutoff, 1, __ATOMIC_RELAXED); // GCC
+    }
+    spin_unlock(&sp->lock);
+
+    if (score >= sp->beta)
+    {
+      if (is_quiet(m)) history_reward(thread, &game->board, ply, before, m, NULL, 0, sp->depth, COLOR_INDEX(us));
+      break;
+    }
+  }
+}
+
+static void
+split_search_white(struct search_thread *thread, struct split_point *sp, game_state *game)
+{
+  split_search_color(thread, sp, game, COLOR_WHITE);
+}
+static void
+split_search_black(struct search_thread *thread, struct split_point *sp, game_state *game)
+{
+  split_search_color(thread, sp, game, COLOR_BLACK);
+}
+
+// a recruited thread's share of the split point, from its own copy of the node
+static void
+split_work(struct search_thread *thread, struct split_point *sp)
+{
+  thread->game = sp->game;
+  memcpy(thread->keys, sp->keys, sp->num_keys * sizeof(uint64_t));
+  thread->num_keys = sp->num_keys;
+  thread->root_index = sp->root_index;
+  memcpy(thread->played, sp->played, sp->ply * sizeof(*sp->played));
+  thread->root_depth = sp->root_depth;
+  thread->follow_pv = 0;
+  thread->split = sp;
+
+  if (nnue_is_loaded()) nnue_attach(&thread->game);
+  if (thread->game.active == COLOR_WHITE) split_search_white(thread, sp, &thread->game);
+  else split_search_black(thread, sp, &thread->game);
+  nnue_detach(&thread->game);
+
+  thread->split = NULL;
+  __atomic_and_fetch(&sp->workers, ~(1ull << thread->index), __ATOMIC_RELEASE); // GCC
+}
+
+
+/* ALPHA-BETA */
+ALWAYS_INLINE int
+alpha_beta_color(struct search_thread *thread, game_state *game, irreversable_state meta, int alpha, int beta, unsigned depth, const color us)
+{
+  // the keys above the root are the plies played since
+  const int ply = thread->num_keys - thread->root_index;
+  int on_pv = thread->follow_pv;
+
+  thread->follow_pv = 0;
+  thread->pv_length[ply] = 0;
+  __atomic_store_n(&thread->nodes, thread->nodes + 1, __ATOMIC_RELAXED); // GCC
+  if (!thread->index && !(thread->nodes % SEARCH_CHECK_INTERVAL)) search_check_limits();
+  if (aborted(thread)) return 0;
+
+  // draws by rule need no moves generated, except that a mate ending the fifty moves stands
+  uint64_t key = zobrist_position_key(game, meta);
+  if (meta.halfmove_clock >= FIFTY_MOVE_PLIES)
+  {
+    if (!is_in_check(&game->board, us) || COLORED(has_legal_move, us)(game, meta)) return 0;
+    return -MATE + ply >= beta ? beta : -MATE + ply <= alpha ? alpha : -MATE + ply;
+  }
+  if (material_insufficient(game) || is_repetition(thread, key, meta.halfmove_clock)) return 0;
+
+  // nothing found here beats mating on the next ply or being mated on this one
+  if (alpha < -MATE + ply) alpha = -MATE + ply;
+  if (beta > MATE - ply - 1) beta = MATE - ply - 1;
+  if (alpha >= beta) return alpha;
+
+  // exact below TB_MAX_PIECES men, with the distance to mate counted from the root
+  int wdl, plies, score;
+  if (!tb_probe(game, meta, &wdl, &plies))
+  {
+    score = tb_score(wdl, ply + plies);
+    return score >= beta ? beta : score <= alpha ? alpha : score;
+  }
+
+  // checks are not cut off at the horizon: the evasions get the ply the check took
+  const move *excluded = thread->excluded[ply];
+  const int in_check = is_in_check(&game->board, us);
+  if (in_check && ply + depth < 2 * thread->root_depth) ++depth;
+
+  if (!depth || ply >= MAX_PLY - 1) return COLORED(quiesce, us)(thread, game, meta, alpha, beta, ply);
+
+  // a deep enough bound answers the node, any other entry still knows a move to try first;
+  // a search without one of the moves is not the node the table knows
+  struct tt_entry entry;
+  move hashed = { .type = MT_NULL };
+  int hit = !excluded && tt_probe(key, &entry);
+  if (hit)
+  {
+    if (entry.depth >= depth)
+    {
+      score = score_from_tt(entry.score, ply);
+      if (entry.bound == TT_EXACT) return score >= beta ? beta : score <= alpha ? alpha : score;
+      if (entry.bound == TT_LOWER && score >= beta) return beta;
+      if (entry.bound == TT_UPPER && score <= alpha) return alpha;
+    }
+    hashed = entry.best;
+  }
+  // the previous iteration's best line is tried first, the table may have lost it
+  on_pv = on_pv && ply < (int) thread->previous_pv->pv_length;
+  if (on_pv) hashed = thread->previous_pv->pv[ply];
+
+#ifndef SCHESS_SEARCH_IID
+  // without a move to try first the node orders badly: it is cheaper to search it shallower
+  // and let the next iteration, which finds the move in the table, search it in full
+  if (hashed.type == MT_NULL && !excluded && depth >= SEARCH_IIR_DEPTH)
+  {
+    --depth;
+    ++thread->stats.internal_iterative;
+  }
+#endif
+
+  // far outside the window the static score is trusted to answer the node, except for
+  // the best line, in check, or once the bound it is held against is a mate; the other
+  // bound is often still open, a fail-hard search has no window around the best line
+  const int prune = !in_check && !excluded && !on_pv,
+            prune_high = prune && beta > -MATE_BOUND && beta < MATE_BOUND,
+            prune_low = prune && alpha > -MATE_BOUND && alpha < MATE_BOUND;
+  const int static_eval = prune_high || prune_low ? eval_position(game, meta) : 0;
+  if (prune_high && depth <= search_pruning.reverse_futility_depth
+      && static_eval - search_pruning.reverse_futility_margin * (int) depth >= beta)
+  {
+    ++thread->stats.reverse_futility;
+    return beta;
+  }
+  // the capture search razoring trusts cannot see a quiet mate, so it needs a window whose
+  // bounds are both scores, not only the one it fails against
+  if (prune_low && prune_high && depth <= search_pruning.razoring_depth
+      && static_eval + search_pruning.razoring_margin * (int) depth <= alpha
+      && COLORED(quiesce, us)(thread, game, meta, alpha, beta, ply) <= alpha)
+  {
+    ++thread->stats.razoring;
+    return alpha;
+  }
+  // no quiet move lifts such a score to alpha, unless it gives check
+  const int futile = prune_low && depth <= search_pruning.futility_depth
+                  && static_eval + search_pruning.futility_margin * (int) depth <= alpha;
+
+#ifdef SCHESS_SEARCH_IID
+  // without a move to try first the node orders badly: a shallower search of it leaves its
+  // best move in the table
+  if (hashed.type == MT_NULL && !excluded && depth >= SEARCH_IID_DEPTH)
+  {
+    ++thread->stats.internal_iterative;
+    COLORED(alpha_beta, us)(thread, game, meta, alpha, beta, depth - SEARCH_IID_REDUCTION);
+    if (aborted(thread)) return 0;
+    thread->pv_length[ply] = 0;
+    hit = tt_probe(key, &entry);
+    if (hit) hashed = entry.best;
+  }
+#endif
+
+  struct move_set set;
+  struct move_buffer moves;
+  struct split_point *sp;
+  struct search_played before[2];
+  move m, best = { .type = MT_NULL }, quiets[64];
+  irreversable_state meta_copy;
+  int first, is_hashed, singular = 0, alpha_raised = 0, scores[MAX_MOVES_NUM];
+  unsigned legal = 0;
+  size_t next = 0, num_quiets = 0;
 
-  num_moves = generate_moves(game, meta, &mbuf[depth]);
-  for (i = 0; i < num_moves; ++i)
+  COLORED(generate_move_set, us)(game, meta, &set);
+  // the hashed move may come from a colliding key
+  first = move_set_contains(&set, &hashed);
+  hashed.capture = game->board.types[hashed.to];
+  // the hashed move alone often cuts, the others are only ordered once it did not
+  moves.size = 0;
+  played_before(thread, ply, before);
+
+  // a hashed move that beats every other one by a margin is searched a ply deeper: the
+  // others are verified below the margin at half the depth, with the hashed move left out
+  if (first && hit && depth >= SEARCH_SINGULAR_DEPTH && entry.bound != TT_UPPER && entry.depth + 3 >= depth
+      && entry.score < MATE_BOUND && entry.score > -MATE_BOUND && ply + depth < 2 * thread->root_depth)
   {
-    move *m = mbuf[depth].moves + i;
+    const int singular_beta = entry.score - SEARCH_SINGULAR_MARGIN * (int) depth;
+
+    thread->excluded[ply] = &hashed;
+    score = COLORED(alpha_beta, us)(thread, game, meta, singular_beta - 1, singular_beta, (depth - 1) / 2);
+    thread->excluded[ply] = NULL;
+    if (aborted(thread)) return 0;
+    singular = score < singular_beta;
+  }
+  thread->keys[thread->num_keys++] = key;
+
+  // a capture that wins enough to hold beta plus a margin at a reduced depth is trusted
+  // to hold beta at the full one (ProbCut)
+  if (prune_high && search_pruning.probcut_depth && depth >= search_pruning.probcut_depth
+      && depth > search_pruning.probcut_reduction)
+  {
+    const int probcut_beta = beta + search_pruning.probcut_margin;
+    int gain;
+    const unsigned probcut_depth = depth - search_pruning.probcut_reduction;
+    // a copy of the node's moves, generated before the singular search ran below it
+    struct move_set captures = set;
+
+    while (move_set_next(&captures, game->board.types, &m))
+    {
+      if (m.capture == PT_NONE && m.type != MT_EN_PASSANT) continue;
+      // SEE sees an empty square where the pawn taken en passant is not
+      gain = see(&game->board, NULL, m.from, m.to) + (m.type == MT_EN_PASSANT ? eval_piece_value(PT_WP) : 0);
+      if (static_eval + gain < probcut_beta) continue;
+
+      meta_copy = meta;
+      thread->played[ply] = (struct search_played) { game->board.types[m.from], m.to };
+      COLORED(move_make, us)(&m, game, &meta_copy);
+      score = COLORED(is_board_legal, OTHER_COLOR(us))(&game->board)
+            ? -COLORED(alpha_beta, OTHER_COLOR(us))(thread, game, meta_copy, -probcut_beta, -probcut_beta + 1, probcut_depth)
+            : -oo;
+      COLORED(move_unmake, us)(&m, game);
+
+      if (aborted(thread)) break;
+      if (score >= probcut_beta)
+      {
+        --thread->num_keys;
+        ++thread->stats.probcut;
+        tt_store(key, m, score_to_tt(beta, ply), probcut_depth + 1, TT_LOWER);
+        return beta;
+      }
+    }
+  }
+
+  for (;;)
+  {
+    if (first) m = hashed;
+    else
+    {
+      if (!next && !moves.size)
+      {
+        move_set_serialize(&set, game->board.types, &moves);
+        order_moves(thread, &game->board, ply, before, &moves, COLOR_INDEX(us), scores);
+      }
+      // young brothers wait for the eldest: the others are only shared once it did not cut
+      if (legal && next < moves.size && depth >= SEARCH_SPLIT_DEPTH && !excluded
+          && (sp = split_open(thread, game, meta, ply, depth, alpha, beta, futile, hashed, &moves, scores, next)))
+      {
+        COLORED(split_search, us)(thread, sp, game);
+        split_close(thread, sp);
+        next = moves.size;
+        legal += sp->legal;
+        if (aborted(thread)) break;
+        if (sp->cutoff)
+        {
+          --thread->num_keys;
+          ++thread->stats.cutoffs;
+          tt_store(key, sp->best, score_to_tt(beta, ply), depth, TT_LOWER);
+          return beta;
+        }
+        if (sp->alpha_raised)
+        {
+          alpha = sp->alpha;
+          alpha_raised = 1;
+          best = sp->best;
+          memcpy(thread->pv[ply], sp->pv, sp->pv_length * sizeof(move));
+          thread->pv_length[ply] = sp->pv_length;
+        }
+        break;
+      }
+      if (next == moves.size) break;
+      m = order_pick(&moves, scores, next++);
+      if (move_equal(m, hashed)) continue;
+    }
+    if (excluded && move_equal(m, *excluded)) continue;
+    is_hashed = first;
+    first = 0;
+
     meta_copy = meta;
+    thread->played[ply] = (struct search_played) { game->board.types[m.from], m.to };
+
+    // a king left en prise means the move that led here was illegal
+    if (COLORED(move_make, us)(&m, game, &meta_copy))
+    {
+      score = MATE - ply;
+      thread->pv_length[ply + 1] = 0;
+    }
+    // only legal moves count, so no move left is mate or stalemate
+    else if (!COLORED(is_board_legal, OTHER_COLOR(us))(&game->board))
+    {
+      COLORED(move_unmake, us)(&m, game);
+      continue;
+    }
+    else if (futile && legal && is_quiet(m) && !is_in_check(&game->board, OTHER_COLOR(us)))
+    {
+      COLORED(move_unmake, us)(&m, game);
+      ++legal;
+      ++thread->stats.futility;
+      continue;
+    }
+    else
+    {
+      thread->follow_pv = on_pv && is_hashed;
+      score = -COLORED(alpha_beta, OTHER_COLOR(us))(thread, game, meta_copy, -beta, -alpha, depth - 1 + (is_hashed && singular));
+    }
+    COLORED(move_unmake, us)(&m, game);
+    ++legal;
+
+    // an interrupted subtree has no score worth storing
+    if (aborted(thread)) break;
+
+    if (score >= beta)
+    {
+      --thread->num_keys;
+      ++thread->stats.cutoffs;
+      if (legal == 1) ++thread->stats.first_cutoffs;
+      if (is_quiet(m)) history_reward(thread, &game->board, ply, before, m, quiets, num_quiets, depth, COLOR_INDEX(us));
+      if (!excluded) tt_store(key, m, score_to_tt(beta, ply), depth, TT_LOWER);
+      return beta;
+    }
+    if (score > alpha)
+    {
+      alpha = score;
+      alpha_raised = 1;
+      best = m;
+      pv_update(thread, ply, m);
+    }
+    if (is_quiet(m) && num_quiets < sizeof(quiets) / sizeof(*quiets)) quiets[num_quiets++] = m;
+  }
+
+  --thread->num_keys;
+  if (aborted(thread)) return 0;
+  if (excluded) return alpha;
+  if (!legal)
+  {
+    score = in_check ? -MATE + ply : 0;
+    return score >= beta ? beta : score <= alpha ? alpha : score;
+  }
+  tt_store(key, best, score_to_tt(alpha, ply), depth, alpha_raised ? TT_EXACT : TT_UPPER);
+  return alpha;
+}
+
+static int
+alpha_beta_white(struct search_thread *thread, game_state *game, irreversable_state meta, int alpha, int beta, unsigned depth)
+{
+  return alpha_beta_color(thread, game, meta, alpha, beta, depth, COLOR_WHITE);
+}
+static int
+alpha_beta_black(struct search_thread *thread, game_state *game, irreversable_state meta, int alpha, int beta, unsigned depth)
+{
+  return alpha_beta_color(thread, game, meta, alpha, beta, depth, COLOR_BLACK);
+}
+
+static int
+alpha_beta(struct search_thread *thread, game_state *game, irreversable_state meta, int alpha, int beta, unsigned depth)
+{
+  return game->active == COLOR_WHITE
+    ? alpha_beta_white(thread, game, meta, alpha, beta, depth)
+    : alpha_beta_black(thread, game, meta, alpha, beta, depth);
+}
+
+
+/* ITERATIVE DEEPENING */
+// searches the root moves from `first` on in order, leaving the line of `best` in pv[0];
+// `best` stays MT_NULL if not even the first one finished
+static int
+search_root(struct search_thread *thread, unsigned depth, size_t first, move *best)
+{
+  struct move_buffer *root = thread->root;
+  irreversable_state meta_copy;
+  int score, alpha = -oo;
+  size_t i;
+
+  thread->pv_length[0] = 0;
+  thread->root_depth = depth;
+  // the move ranked here last iteration comes first, its line is followed down the tree
+  thread->previous_pv = first < thread->result.num_lines ? &thread->result.lines[first] : NULL;
+
+  for (i = first; i < root->size; ++i)
+  {
+    thread->follow_pv = i == first && thread->previous_pv && move_equal(thread->previous_pv->best, root->moves[i]);
+    meta_copy = thread->meta;
+    thread->played[0] = (struct search_played) { thread->game.board.types[root->moves[i].from], root->moves[i].to };
+    move_make(&root->moves[i], &thread->game, &meta_copy);
+    score = -alpha_beta(thread, &thread->game, meta_copy, -oo, -alpha, depth - 1);
+    move_unmake(&root->moves[i], &thread->game);
+
+    if (stopped()) break;
+    if (score > alpha || i == first)
+    {
+      alpha = score;
+      *best = root->moves[i];
+      pv_update(thread, 0, root->moves[i]);
+    }
+  }
+  return alpha;
+}
+
+/*
+ * cutoffs on the table end a collected line early; the moves the table knows to reach
+ * its score carry the line on as far as extensions let it go, as long as they are legal
+ */
+static void
+search_complete_pv(struct search_thread *thread, struct search_line *line)
+{
+  irreversable_state meta = thread->meta;
+  struct tt_entry entry;
+  struct move_set set;
+  unsigned i;
+  move m;
+
+  for (i = 0; i < line->pv_length; ++i) move_make(&line->pv[i], &thread->game, &meta);
+
+  while (line->pv_length < 2 * line->depth && line->pv_length < MAX_PLY
+         && tt_probe(zobrist_position_key(&thread->game, meta), &entry) && entry.bound != TT_UPPER)
+  {
+    m = entry.best;
+    generate_move_set(&thread->game, meta, &set);
+    if (!move_set_contains(&set, &m)) break;
+    m.capture = thread->game.board.types[m.to];
+    move_make(&m, &thread->game, &meta);
+    if (!is_board_legal(&thread->game.board, thread->game.active))
+    {
+      move_unmake(&m, &thread->game);
+      break;
+    }
+    line->pv[line->pv_length++] = m;
+  }
+
+  for (i = line->pv_length; i-- > 0;) move_unmake(&line->pv[i], &thread->game);
+}
+
+/*
+ * takes the lines of an iteration; after a stop the lines it finished come first and the
+ * previous iteration fills the ranks below with the moves it has not named yet
+ */
+static void
+search_set_lines(struct search_thread *thread, const struct search_line *lines, unsigned found, unsigned wanted)
+{
+  struct search_info *result = &thread->result;
+  struct search_line previous[SEARCH_MAX_MULTIPV];
+  unsigned i, j, num_previous = result->num_lines;
+
+  memcpy(previous, result->lines, num_previous * sizeof(*previous));
+  memcpy(result->lines, lines, found * sizeof(*lines));
+  result->num_lines = found;
+
+  for (i = 0; i < num_previous && result->num_lines < wanted; ++i)
+  {
+    for (j = 0; j < found && !move_equal(lines[j].best, previous[i].best); ++j);
+    if (j == found) result->lines[result->num_lines++] = previous[i];
+  }
+
+  result->best = result->lines[0].best;
+  result->score = result->lines[0].score;
+}
+
+// every thread ages its own tables as it starts, so they are not all walked by the first
+static void
+search_tables_age(struct search_tables *t)
+{
+  int16_t *h;
+  size_t i;
+
+  memset(t->killers, 0, sizeof(t->killers));
+  for (h = &t->history[0][0][0], i = 0; i < sizeof(t->history) / sizeof(*h); ++i) h[i] /= 2;
+  for (h = &t->continuation[0][0][0][0][0], i = 0; i < sizeof(t->continuation) / sizeof(*h); ++i) h[i] /= 2;
+}
+
+// grows tables to n, the new ones empty; nonzero if they could not be allocated
+static int
+search_tables_reserve(unsigned n)
+{
+  struct search_tables *grown;
+
+  if (n <= num_tables) return 0;
+  grown = realloc(tables, n * sizeof(*tables));
+  if (!grown) return 1;
+  memset(grown + num_tables, 0, (n - num_tables) * sizeof(*tables));
+  tables = grown;
+  num_tables = n;
+  return 0;
+}
+
+void
+search_clear(void)
+{
+  if (tables) memset(tables, 0, num_tables * sizeof(*tables));
+}
+
+static void
+search_iterate(struct search_thread *thread, search_report_fn report, void *ctx)
+{
+  struct move_buffer *root = thread->root;
+  unsigned depth, max = control.limits.depth && control.limits.depth < MAX_PLY ? control.limits.depth : MAX_PLY,
+           wanted = control.limits.multipv ? control.limits.multipv : 1, found;
+  struct search_line lines[SEARCH_MAX_MULTIPV];
+  uint64_t nodes;
+  move best;
+  size_t i;
+  int score;
+
+  if (wanted > SEARCH_MAX_MULTIPV) wanted = SEARCH_MAX_MULTIPV;
+  if (wanted > root->size) wanted = root->size;
+  search_tables_age(thread->tables);
+
+  // every other helper runs one ply ahead, so the threads spread over more of the tree
+  for (depth = 1 + (thread->index & 1); depth <= max; ++depth)
+  {
+    // each line leaves out the moves ranked above it; the table still holds their
+    // subtrees, so the later lines mostly confirm what the earlier ones refuted
+    for (found = 0; found < wanted && !stopped(); ++found)
+    {
+      nodes = total_nodes();
+      best = (move) { .type = MT_NULL };
+      score = search_root(thread, depth, found, &best);
+      // moves that finished before a stop were searched as deep as the whole iteration
+      if (best.type == MT_NULL) break;
+
+      lines[found].best = best;
+      lines[found].score = score;
+      lines[found].depth = depth;
+      lines[found].nodes = total_nodes() - nodes;
+      lines[found].pv_length = thread->pv_length[0];
+      memcpy(lines[found].pv, thread->pv[0], thread->pv_length[0] * sizeof(move));
+      search_complete_pv(thread, &lines[found]);
+      for (i = found; !move_equal(root->moves[i], best); ++i);
+      memmove(root->moves + found + 1, root->moves + found, (i - found) * sizeof(move));
+      root->moves[found] = best;
+    }
+
+    if (found) search_set_lines(thread, lines, found, wanted);
+    if (stopped()) break;
+    thread->result.depth = depth;
+
+    // mated positions are told apart one ply above the horizon: a mate shorter than the
+    // depth is proven the shortest, deeper iterations would only find it again
+    if (wanted == 1 && (thread->result.score >= MATE_BOUND || thread->result.score <= -MATE_BOUND))
+      if ((unsigned) (MATE - abs(thread->result.score)) < depth) max = depth;
+
+    if (thread->index) continue;
+    thread->result.nodes = total_nodes();
+    thread->result.ms = elapsed_ms();
+    thread->result.hashfull = tt_hashfull();
+    if (report) report(&thread->result, ctx);
+
+    if (__atomic_load_n(&control.pondering, __ATOMIC_RELAXED)) continue; // GCC
+    // the next iteration would not finish in time, and a forced move needs no second one
+    if (control.soft && (thread->result.ms >= control.soft || root->size == 1)) break;
+  }
+}
+
+static void *
+search_helper(void *arg)
+{
+  struct search_thread *thread = arg;
+
+  if (nnue_is_loaded()) nnue_attach(&thread->game);
+  search_iterate(thread, NULL, NULL);
+  nnue_detach(&thread->game);
+
+  nnue_stack_free();
+  pawn_table_free();
+  return NULL;
+}
+
+// a YBWC helper: idles until a split point recruits it, until the search is over
+static void *
+search_worker(void *arg)
+{
+  struct search_thread *thread = arg;
+  struct split_point *sp;
 
-    move_make(m, game, &meta_copy);
-    score = -alpha_beta(game, meta_copy, -oo, +oo, depth, mbuf);
-    move_unmake(m, game);
+  search_tables_age(thread->tables);
+  spin_lock(&control.pool_lock);
+  thread->idle = !control.finished;
+  if (thread->idle) __atomic_add_fetch(&control.idle, 1, __ATOMIC_RELAXED); // GCC
+  spin_unlock(&control.pool_lock);
 
-    if (score > best_score)
+  while (__atomic_load_n(&thread->idle, __ATOMIC_ACQUIRE) || __atomic_load_n(&thread->work, __ATOMIC_ACQUIRE)) // GCC
+  {
+    if ((sp = __atomic_load_n(&thread->work, __ATOMIC_ACQUIRE)))
+    {
+      split_work(thread, sp);
+      spin_lock(&control.pool_lock);
+      thread->work = NULL;
+      thread->idle = 1;
+      __atomic_add_fetch(&control.idle, 1, __ATOMIC_RELAXED);
+      spin_unlock(&control.pool_lock);
+      continue;
+    }
+
+    spin_lock(&control.pool_lock);
+    // a split point may have recruited the thread after the look above
+    if (control.finished && thread->idle)
     {
-      best_score = score;
-      best = *m;
+      thread->idle = 0;
+      __atomic_sub_fetch(&control.idle, 1, __ATOMIC_RELAXED);
     }
+    spin_unlock(&control.pool_lock);
+    sched_yield();
   }
 
-  return best;
+  nnue_stack_free();
+  pawn_table_free();
+  return NULL;
+}
+
+static void
+search_allot_time(const struct search_limits *limits, color active)
+{
+  unsigned long time = limits->time[COLOR_INDEX(active)], inc = limits->inc[COLOR_INDEX(active)], optimum;
+
+  control.soft = control.hard = 0;
+  if (limits->infinite) return;
+
+  if (limits->movetime)
+  {
+    control.soft = control.hard = limits->movetime;
+    return;
+  }
+  if (!time) return;
+
+  time = time > SEARCH_MOVE_OVERHEAD ? time - SEARCH_MOVE_OVERHEAD : 1;
+  optimum = time / (limits->movestogo ? limits->movestogo : SEARCH_MOVES_TO_GO) + inc * 3 / 4;
+  control.hard = optimum * 4 < time / 2 ? optimum * 4 : time / 2;
+  if (control.hard < optimum) control.hard = optimum < time ? optimum : time;
+  // an iteration takes about as long as all before it, so none starts past half the optimum
+  control.soft = optimum / 2 ? optimum / 2 : 1;
+}
+
+// clears the stop flag and sets the clock; runs on the thread that starts the search
+static void
+search_prepare(const struct search_limits *limits)
+{
+  __atomic_store_n(&control.stop, 0, __ATOMIC_RELAXED); // GCC
+  __atomic_store_n(&control.pondering, limits->ponder, __ATOMIC_RELAXED);
+  __atomic_store_n(&control.start, now_ms(), __ATOMIC_RELAXED);
+}
+
+static struct search_info
+search_run(const game_state *game, irreversable_state meta, const struct search_limits *limits,
+           search_report_fn report, void *ctx)
+{
+  struct search_info result = { .best = { .type = MT_NULL } };
+  struct search_thread *threads;
+  struct move_buffer *root;
+  game_state position = *game;
+  irreversable_state meta_copy;
+  size_t i, legal = 0, history;
+  unsigned t;
+
+  control.limits = *limits;
+  search_allot_time(limits, game->active);
+  tt_new_search();
+
+  root = move_buffer_create(1);
+  threads = calloc(num_threads, sizeof(*threads));
+  if (!root || !threads || search_tables_reserve(num_threads))
+  {
+    free(threads);
+    move_buffer_destroy(root);
+    return result;
+  }
+
+  // only legal moves at the root, so the best move is always one that may be played
+  generate_moves(&position, meta, root);
+  for (i = 0; i < root->size; ++i)
+  {
+    meta_copy = meta;
+    move_make(&root->moves[i], &position, &meta_copy);
+    if (is_board_legal(&position.board, position.active)) root->moves[legal++] = root->moves[i];
+    move_unmake(&root->moves[i], &position);
+  }
+  root->size = legal;
+
+  if (!legal)
+  {
+    result.score = is_in_check(&position.board, position.active) ? -MATE : 0;
+    free(threads);
+    move_buffer_destroy(root);
+    return result;
+  }
+
+  control.threads = threads;
+  control.num_threads = 1;
+  control.idle = 0;
+  control.finished = 0;
+  // the game's positions since its last capture or pawn move can still repeat
+  history = limits->history_length < meta.halfmove_clock ? limits->history_length : meta.halfmove_clock;
+  if (history > SEARCH_MAX_HISTORY) history = SEARCH_MAX_HISTORY;
+  if (!limits->history) history = 0;
+
+  for (t = 0; t < num_threads; ++t)
+  {
+    threads[t].index = t;
+    threads[t].tables = &tables[t];
+    threads[t].game = *game;
+    threads[t].meta = meta;
+    if (history) memcpy(threads[t].keys, limits->history + limits->history_length - history, history * sizeof(uint64_t));
+    threads[t].keys[history] = zobrist_position_key(game, meta);
+    threads[t].root_index = history;
+    threads[t].num_keys = history + 1;
+    threads[t].root = t ? move_buffer_create(1) : root;
+    threads[t].result = (struct search_info) { .best = root->moves[0] };
+  }
+  // helpers that cannot be started are left out
+  for (t = 1; t < num_threads; ++t)
+  {
+    if (!threads[t].root) break;
+    *threads[t].root = *root;
+    if (pthread_create(&threads[t].id, NULL, parallel == SEARCH_YBWC ? search_worker : search_helper, &threads[t])) break;
+    control.num_threads = t + 1;
+  }
+
+  if (nnue_is_loaded()) nnue_attach(&threads[0].game);
+  search_iterate(&threads[0], report, ctx);
+  nnue_detach(&threads[0].game);
+
+  // infinite and pondering searches keep their result until they are told to move
+  while ((limits->infinite || __atomic_load_n(&control.pondering, __ATOMIC_RELAXED)) && !stopped()) // GCC
+    nanosleep(&(struct timespec) { 0, 1000000 }, NULL);
+
+  search_stop();
+  spin_lock(&control.pool_lock);
+  control.finished = 1;
+  spin_unlock(&control.pool_lock);
+  for (t = 1; t < control.num_threads; ++t) pthread_join(threads[t].id, NULL);
+
+  // the counters are all uint64_t
+  for (t = 0; t < control.num_threads; ++t)
+    for (i = 0; i < sizeof(stats) / sizeof(uint64_t); ++i)
+      ((uint64_t *) &stats)[i] += ((const uint64_t *) &threads[t].stats)[i];
+
+  result = threads[0].result;
+  result.nodes = total_nodes();
+  result.ms = elapsed_ms();
+  result.hashfull = tt_hashfull();
+
+  for (t = 0; t < num_threads; ++t) move_buffer_destroy(threads[t].root);
+  control.threads = NULL;
+  control.num_threads = 0;
+  free(threads);
+  return result;
+}
+
+struct search_info
+search(game_state *game, irreversable_state meta, const struct search_limits *limits,
+       search_report_fn report, void *ctx)
+{
+  search_prepare(limits);
+  return search_run(game, meta, limits, report, ctx);
+}
+
+move
+search_best_move(game_state *game, irreversable_state meta, unsigned depth)
+{
+  struct search_limits limits = { .depth = depth };
+
+  if (depth == 0) return (move) { .type = MT_NULL };
+  return search(game, meta, &limits, NULL, NULL).best;
+}
+
+size_t
+search_best_moves(game_state *game, irreversable_state meta, unsigned depth,
+                  struct search_line *lines, size_t n)
+{
+  struct search_limits limits = { .depth = depth, .multipv = n < SEARCH_MAX_MULTIPV ? n : SEARCH_MAX_MULTIPV };
+  struct search_info info;
+
+  if (depth == 0 || n == 0) return 0;
+  info = search(game, meta, &limits, NULL, NULL);
+  memcpy(lines, info.lines, info.num_lines * sizeof(*lines));
+  return info.num_lines;
+}
+
+void
+search_stop(void)
+{
+  __atomic_store_n(&control.stop, 1, __ATOMIC_RELAXED); // GCC
+}
+
+void
+search_ponderhit(void)
+{
+  __atomic_store_n(&control.start, now_ms(), __ATOMIC_RELAXED); // GCC
+  __atomic_store_n(&control.pondering, 0, __ATOMIC_RELAXED);
+}
+
+void
+search_set_threads(unsigned threads)
+{
+  num_threads = threads < 1 ? 1 : threads > SEARCH_MAX_THREADS ? SEARCH_MAX_THREADS : threads;
+}
+
+void
+search_set_parallel(enum SEARCH_PARALLEL mode)
+{
+  parallel = mode;
+}
+
+struct search_stats
+search_stats(void)
+{
+  return stats;
+}
+
+void
+search_stats_reset(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+
+/* ASYNCHRONOUS */
+static struct
+{
+  pthread_t id;
+  int started;                 // not waited for yet
+  game_state game;
+  irreversable_state meta;
+  struct search_limits limits;
+  search_report_fn report, done;
+  void *ctx;
+} async;
+
+static void *
+search_async_run(void *arg)
+{
+  struct search_info result;
+
+  (void) arg;
+  result = search_run(&async.game, async.meta, &async.limits, async.report, async.ctx);
+  if (async.done) async.done(&result, async.ctx);
+
+  nnue_stack_free();
+  pawn_table_free();
+  return NULL;
+}
+
+int
+search_start(const game_state *game, irreversable_state meta, const struct search_limits *limits,
+             search_report_fn report, search_report_fn done, void *ctx)
+{
+  if (async.started) return 1;
+
+  async.game = *game;
+  async.meta = meta;
+  async.limits = *limits;
+  async.report = report;
+  async.done = done;
+  async.ctx = ctx;
+
+  // a stop sent right after this returns already belongs to the new search
+  search_prepare(limits);
+  if (pthread_create(&async.id, NULL, search_async_run, NULL)) return 1;
+  async.started = 1;
+  return 0;
+}
+
+void
+search_wait(void)
+{
+  if (!async.started) return;
+  pthread_join(async.id, NULL);
+  async.started = 0;
 }
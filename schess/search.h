@@ -2,7 +2,141 @@
 #define SCHESS_SEARCH_H
 
 #include <schess/types.h>
+#include <stddef.h>
+#include <stdint.h>
 
+#define MAX_PLY 128
+#define SEARCH_MAX_THREADS 64
+// earlier positions of the game a search looks at for repetitions
+#define SEARCH_MAX_HISTORY 128
+// plies without a capture or pawn move after which the game is drawn
+#define FIFTY_MOVE_PLIES 100
+// root moves a MultiPV search ranks at most
+#define SEARCH_MAX_MULTIPV 16
+
+/* what ends a search; zero fields do not limit it */
+struct search_limits
+{
+  unsigned depth;
+  uint64_t nodes;
+  unsigned movetime;         // milliseconds
+  unsigned time[2], inc[2];  // clock and increment per COLOR_INDEX, milliseconds
+  unsigned movestogo;
+  int infinite;              // only search_stop ends the search
+  int ponder;                // like infinite until search_ponderhit starts the clock
+  unsigned multipv;          // best root moves to rank, up to SEARCH_MAX_MULTIPV; 0 for one
+
+  // zobrist_position_key of the game's earlier positions, oldest first (may be NULL);
+  // read when the search starts
+  const uint64_t *history;
+  size_t history_length;
+};
+
+/* one ranked root move */
+struct search_line
+{
+  move best;
+  int score;                 // side to move
+  unsigned depth;            // lines finished before a stop are a ply deeper than the rest
+  uint64_t nodes;            // spent on the line in its iteration, by all threads
+  unsigned pv_length;
+  move pv[MAX_PLY];          // the expected moves of both sides, from best on
+};
+
+/* the last finished iteration */
+struct search_info
+{
+  unsigned depth;
+  int score;                 // side to move; MATE - n mates in n plies
+  uint64_t nodes;            // of all threads
+  unsigned long ms;
+  unsigned hashfull;         // permille
+  move best;                 // MT_NULL without a legal move
+  // the searched root moves, best first: lines[0] repeats score and best
+  unsigned num_lines;
+  struct search_line lines[SEARCH_MAX_MULTIPV];
+};
+
+typedef void (*search_report_fn)(const struct search_info *info, void *ctx);
+
+/*
+ * forward pruning near the leaves. each technique applies up to a remaining depth (ProbCut
+ * from one on), a depth of 0 turns it off; margins are centipawns per ply of depth, ProbCut's
+ * is a fixed one over beta. read by the search threads, so only changed between searches.
+ */
+struct search_pruning
+{
+  unsigned reverse_futility_depth;  // static eval - margin * depth >= beta: the node fails high
+  int reverse_futility_margin;
+  unsigned futility_depth;          // static eval + margin * depth <= alpha: quiet moves are skipped
+  int futility_margin;
+  unsigned razoring_depth;          // static eval + margin * depth <= alpha: a capture search decides
+  int razoring_margin;
+  unsigned probcut_depth;           // a winning capture holds beta + margin at depth - reduction
+  int probcut_margin;
+  unsigned probcut_reduction;
+};
+extern struct search_pruning search_pruning;
+
+// nodes or moves each technique pruned, and how often the first move searched already failed high
+struct search_stats
+{
+  uint64_t reverse_futility, futility, razoring, probcut;
+  uint64_t cutoffs, first_cutoffs;
+  uint64_t internal_iterative;      // nodes without a hashed move, reduced or searched shallower first
+  uint64_t splits;                  // split points opened, see SEARCH_YBWC
+};
+
+// score of the side to move once the captures that win material are played out
+int quiesce(game_state *game, irreversable_state meta, int alpha, int beta);
+
+/*
+ * iterative deepening over the transposition table, on search_set_threads threads
+ * that share the table (see search_set_parallel). `report` (may be NULL) is called by the calling
+ * thread after every finished iteration; returns the last one.
+ */
+struct search_info search(game_state *game, irreversable_state meta, const struct search_limits *limits,
+                          search_report_fn report, void *ctx);
 move search_best_move(game_state *game, irreversable_state meta, unsigned depth);
+/*
+ * the `n` best root moves at `depth`, best first. each line is searched with the ones
+ * above it left out, over the table the earlier lines filled; returns the lines found.
+ */
+size_t search_best_moves(game_state *game, irreversable_state meta, unsigned depth,
+                         struct search_line *lines, size_t n);
+
+/*
+ * the same search on a thread of its own, so the caller stays responsive; `done` is
+ * called on the search thread with the result. returns 0 on success, nonzero if a
+ * search is still running or the thread could not be started.
+ */
+int search_start(const game_state *game, irreversable_state meta, const struct search_limits *limits,
+                 search_report_fn report, search_report_fn done, void *ctx);
+// ends the running search as soon as possible; safe from any thread
+void search_stop(void);
+// a pondering search turns into a normal one with its clock starting now
+void search_ponderhit(void);
+// blocks until the search started by search_start returned
+void search_wait(void);
+
+// 1 up to SEARCH_MAX_THREADS
+void search_set_threads(unsigned threads);
+
+/* how the threads of a search share the work */
+enum SEARCH_PARALLEL
+{
+  SEARCH_LAZY_SMP,   // every thread runs its own iterative deepening, they share the table only
+  SEARCH_YBWC,       // one iterative deepening; once the first move of a deep enough node was
+                     // searched, idle threads join it at a split point for the others (YBWC)
+};
+// takes effect with the next search
+void search_set_parallel(enum SEARCH_PARALLEL mode);
+
+// forgets the move ordering the threads learnt in earlier searches, e.g. for a new game
+void search_clear(void);
+
+// counters of every thread of the searches since the last reset; read between searches
+struct search_stats search_stats(void);
+void search_stats_reset(void);
 
 #endif // SCHESS_SEARCH_H
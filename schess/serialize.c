@@ -0,0 +1,185 @@
+#include <schess/serialize.h>
+#include <stdint.h>
+#include <x86intrin.h>
+
+// the vector kernels write moves as four packed 32 bit lanes: from, to, capture, type
+_Static_assert(sizeof(move) == 4 * sizeof(int32_t), "move must be four packed 32 bit fields");
+_Static_assert(MT_NORMAL == 0, "vector kernels zero the type lane");
+
+serialize_fn serialize_targets = serialize_targets_scalar;
+
+// below this many targets the scalar loop beats the vector setup cost
+#define SERIALIZE_VECTOR_MIN 6
+
+size_t
+serialize_targets_scalar(bitboard targets, square from, const piece_type types[NUM_SQUARES], move *out)
+{
+  size_t n = 0;
+  square to;
+
+  while (targets)
+  {
+    // GCC
+    to = __builtin_ctzll(targets);
+    targets &= targets - 1;
+
+    out[n].from    = from;
+    out[n].to      = to;
+    out[n].capture = types[to];
+    out[n].type    = MT_NORMAL;
+    ++n;
+  }
+
+  return n;
+}
+
+
+/* AVX2: byte wise LUT of set bit positions, widened to 8 lanes */
+static uint8_t bit_positions[256][8];
+
+__attribute__((constructor)) static void // GCC
+serialize_fill_bit_positions(void)
+{
+  unsigned byte, bit, n;
+
+  for (byte = 0; byte < 256; ++byte)
+    for (bit = 0, n = 0; bit < 8; ++bit)
+      if (byte & (1u << bit)) bit_positions[byte][n++] = bit;
+}
+
+__attribute__((target("avx2"))) // GCC // X86
+size_t
+serialize_targets_avx2(bitboard targets, square from, const piece_type types[NUM_SQUARES], move *out)
+{
+  const __m256i fill = _mm256_set1_epi32(from);
+  const __m256i zero = _mm256_setzero_si256();
+  // index of the move stored in each lane of the four output pairs
+  const __m256i pair_index[4] =
+  {
+    _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1),
+    _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3),
+    _mm256_setr_epi32(4, 4, 4, 4, 5, 5, 5, 5),
+    _mm256_setr_epi32(6, 6, 6, 6, 7, 7, 7, 7),
+  };
+  size_t n = 0;
+  unsigned base, byte, count;
+
+  // GCC
+  if (__builtin_popcountll(targets) < SERIALIZE_VECTOR_MIN)
+    return serialize_targets_scalar(targets, from, types, out);
+
+  while (targets)
+  {
+    // GCC
+    base = __builtin_ctzll(targets) & ~7u;
+    byte = (targets >> base) & 0xFF;
+    targets &= ~(0xFFull << base);
+    count = __builtin_popcount(byte);
+
+    // the eight types of this rank are permuted instead of gathered
+    __m256i local = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) bit_positions[byte]));
+    __m256i to = _mm256_add_epi32(local, _mm256_set1_epi32(base));
+    __m256i capture = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *) &types[base]), local);
+
+    // [from to capture type] per move; the unpacks work per 128 bit half
+    __m256i from_to_lo = _mm256_unpacklo_epi32(fill, to),       // f t0 f t1 | f t4 f t5
+            from_to_hi = _mm256_unpackhi_epi32(fill, to),       // f t2 f t3 | f t6 f t7
+            cap_lo     = _mm256_unpacklo_epi32(capture, zero),  // c0 0 c1 0 | c4 0 c5 0
+            cap_hi     = _mm256_unpackhi_epi32(capture, zero);  // c2 0 c3 0 | c6 0 c7 0
+    __m256i m04 = _mm256_unpacklo_epi64(from_to_lo, cap_lo),
+            m15 = _mm256_unpackhi_epi64(from_to_lo, cap_lo),
+            m26 = _mm256_unpacklo_epi64(from_to_hi, cap_hi),
+            m37 = _mm256_unpackhi_epi64(from_to_hi, cap_hi);
+
+    // masked stores keep the tail branch free and never write past the last move
+    __m256i left = _mm256_set1_epi32(count);
+    int *dst = (int *) &out[n];
+    _mm256_maskstore_epi32(dst +  0, _mm256_cmpgt_epi32(left, pair_index[0]), _mm256_permute2x128_si256(m04, m15, 0x20));
+    _mm256_maskstore_epi32(dst +  8, _mm256_cmpgt_epi32(left, pair_index[1]), _mm256_permute2x128_si256(m26, m37, 0x20));
+    _mm256_maskstore_epi32(dst + 16, _mm256_cmpgt_epi32(left, pair_index[2]), _mm256_permute2x128_si256(m04, m15, 0x31));
+    _mm256_maskstore_epi32(dst + 24, _mm256_cmpgt_epi32(left, pair_index[3]), _mm256_permute2x128_si256(m26, m37, 0x31));
+    n += count;
+  }
+
+  return n;
+}
+
+
+/* AVX-512: VPCOMPRESSB packs all 64 square indices at once */
+static const uint8_t square_indices[NUM_SQUARES] =
+{
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+  16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+  32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,
+  48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63,
+};
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi2"))) // GCC // X86
+size_t
+serialize_targets_avx512(bitboard targets, square from, const piece_type types[NUM_SQUARES], move *out)
+{
+  const __m512i squares = _mm512_loadu_si512(square_indices);
+  // lanes 0 mod 4 hold `from`, lanes 3 mod 4 the (zero) type
+  const __m512i fill = _mm512_maskz_set1_epi32(0x1111, from);
+  // move k of group g takes `to` from lane 4 * g + k and `capture` from 16 + 4 * g + k
+  const __m512i pick[4] =
+  {
+    _mm512_setr_epi32(0,  0, 16, 0, 0,  1, 17, 0, 0,  2, 18, 0, 0,  3, 19, 0),
+    _mm512_setr_epi32(0,  4, 20, 0, 0,  5, 21, 0, 0,  6, 22, 0, 0,  7, 23, 0),
+    _mm512_setr_epi32(0,  8, 24, 0, 0,  9, 25, 0, 0, 10, 26, 0, 0, 11, 27, 0),
+    _mm512_setr_epi32(0, 12, 28, 0, 0, 13, 29, 0, 0, 14, 30, 0, 0, 15, 31, 0),
+  };
+  const __m512i types_lo = _mm512_loadu_si512(&types[0]),
+                types_mid_lo = _mm512_loadu_si512(&types[16]),
+                types_mid_hi = _mm512_loadu_si512(&types[32]),
+                types_hi = _mm512_loadu_si512(&types[48]);
+  uint8_t indices[NUM_SQUARES];
+  size_t n, count;
+  unsigned group;
+  // GCC
+  count = __builtin_popcountll(targets);
+  if (count < SERIALIZE_VECTOR_MIN)
+    return serialize_targets_scalar(targets, from, types, out);
+
+  _mm512_storeu_si512(indices, _mm512_maskz_compress_epi8(targets, squares));
+
+  for (n = 0; n < count; n += 16)
+  {
+    __m512i to = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *) &indices[n]));
+    __m512i capture = _mm512_mask_blend_epi32(_mm512_test_epi32_mask(to, _mm512_set1_epi32(32)),
+        _mm512_permutex2var_epi32(types_lo, to, types_mid_lo),
+        _mm512_permutex2var_epi32(types_mid_hi, to, types_hi));
+
+    // the masked stores keep the tail branch free and never write past the last move
+    uint64_t lanes = count - n >= 16 ? ~0ull : (1ull << (4 * (count - n))) - 1;
+    for (group = 0; group < 4; ++group)
+    {
+      __m512i moves = _mm512_mask_blend_epi32(0x6666, fill, _mm512_permutex2var_epi32(to, pick[group], capture));
+      _mm512_mask_storeu_epi32(&out[n + 4 * group], (__mmask16) (lanes >> (16 * group)), moves);
+    }
+  }
+
+  return count;
+}
+
+
+enum CPU_LEVEL
+serialize_init(enum CPU_LEVEL level)
+{
+  enum CPU_LEVEL detected = cpu_detect();
+
+  if (level > detected) level = detected;
+
+  switch (level)
+  {
+  case CPU_AVX512:
+    serialize_targets = serialize_targets_avx512;
+    return CPU_AVX512;
+  case CPU_AVX2:
+    serialize_targets = serialize_targets_avx2;
+    return CPU_AVX2;
+  default:
+    serialize_targets = serialize_targets_scalar;
+    return CPU_SCALAR;
+  }
+}
@@ -0,0 +1,25 @@
+#ifndef SCHESS_SERIALIZE_H
+#define SCHESS_SERIALIZE_H
+
+#include <schess/cpu.h>
+#include <schess/types.h>
+#include <stddef.h>
+
+/*
+ * expands a target bitboard into MT_NORMAL moves from `from`, looking the captured
+ * piece up in `types`; returns the number of moves written to `out`.
+ * never writes past out[popcount(targets) - 1].
+ */
+typedef size_t (*serialize_fn)(bitboard targets, square from, const piece_type types[NUM_SQUARES], move *out);
+
+size_t serialize_targets_scalar(bitboard targets, square from, const piece_type types[NUM_SQUARES], move *out);
+size_t serialize_targets_avx2  (bitboard targets, square from, const piece_type types[NUM_SQUARES], move *out);
+size_t serialize_targets_avx512(bitboard targets, square from, const piece_type types[NUM_SQUARES], move *out);
+
+// implementation picked by serialize_init
+extern serialize_fn serialize_targets;
+
+// selects the widest implementation available up to `level`; returns the level in use
+enum CPU_LEVEL serialize_init(enum CPU_LEVEL level);
+
+#endif // SCHESS_SERIALIZE_H
@@ -0,0 +1,311 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <schess/gen.h>
+#include <schess/material.h>
+#include <schess/tb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TB_SLOTS 128
+
+struct tb_file
+{
+  const uint8_t *map;
+  size_t length;
+  const struct tb_header *header;
+  const uint64_t *offsets;
+  const uint8_t *runs;
+};
+
+struct tb_table
+{
+  struct tb_desc desc;
+  struct tb_file wdl, dtm;
+};
+
+// open addressing on the material key; key 0 (bare kings) never has a table
+static struct tb_table slots[TB_SLOTS];
+static size_t num_tables;
+
+
+/* DESCRIPTION */
+static piece_type
+tb_piece(char c, color side)
+{
+  switch (c)
+  {
+  case 'Q': return side + PR_Q;
+  case 'R': return side + PR_R;
+  case 'B': return side + PR_B;
+  case 'N': return side + PR_N;
+  case 'P': return side + PR_P;
+  default: return PT_NONE;
+  }
+}
+
+int
+tb_desc_parse(const char *name, struct tb_desc *out)
+{
+  color side = COLOR_WHITE;
+  const char *c;
+  piece_type pt;
+
+  memset(out, 0, sizeof(*out));
+  if (strlen(name) >= sizeof(out->name) || name[0] != 'K') return 1;
+  strcpy(out->name, name);
+
+  for (c = name + 1; *c; ++c)
+  {
+    if (*c == 'v')
+    {
+      if (side == COLOR_BLACK || c[1] != 'K') return 1;
+      side = COLOR_BLACK;
+      ++c;
+      continue;
+    }
+    pt = tb_piece(*c, side);
+    if (pt == PT_NONE || out->num_pieces == TB_MAX_PIECES - 2) return 1;
+    out->pieces[out->num_pieces++] = pt;
+    out->material_key += material_inc[pt];
+  }
+  if (side != COLOR_BLACK || !out->num_pieces) return 1;
+
+  out->entries = 2ull << (6 * (2 + out->num_pieces));
+  return 0;
+}
+
+uint64_t
+tb_index(const struct tb_desc *desc, const board_state *board, color active, int flip)
+{
+  const unsigned mirror = flip ? 56 : 0;
+  bitboard left = 0;
+  uint64_t index = 0;
+  piece_type pt;
+  unsigned i;
+
+#define TB_SWAP(pt) (flip ? ((pt) >= PT_BP ? (pt) - PT_BP + PT_WP : (pt) - PT_WP + PT_BP) : (pt))
+  // pieces of one type fill their slots in square order, the generator covers every order
+  for (i = desc->num_pieces; i-- > 0;)
+  {
+    pt = TB_SWAP(desc->pieces[i]);
+    if (i + 1 == desc->num_pieces || desc->pieces[i + 1] != desc->pieces[i]) left = board->bitboards[pt];
+    // GCC
+    index = index * 64 + (__builtin_ctzll(left) ^ mirror);
+    left &= left - 1;
+  }
+  index = index * 64 + (__builtin_ctzll(board->bitboards[TB_SWAP(PT_BK)]) ^ mirror);
+  index = index * 64 + (__builtin_ctzll(board->bitboards[TB_SWAP(PT_WK)]) ^ mirror);
+#undef TB_SWAP
+
+  return index * 2 + ((active == COLOR_BLACK) != !!flip);
+}
+
+
+/* FILES */
+static int
+tb_map(const char *path, enum TB_FILE_KIND kind, const struct tb_desc *desc, struct tb_file *out)
+{
+  struct stat st;
+  void *map;
+  int fd;
+
+  // LINUX
+  fd = open(path, O_RDONLY);
+  if (fd == -1) return 1;
+  if (fstat(fd, &st) || (size_t) st.st_size < sizeof(struct tb_header))
+  {
+    close(fd);
+    return 1;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return 1;
+
+  out->map = map;
+  out->length = st.st_size;
+  out->header = map;
+  out->offsets = (const uint64_t *) (out->header + 1);
+  out->runs = (const uint8_t *) (out->offsets + out->header->num_blocks + 1);
+
+  if (memcmp(out->header->magic, TB_MAGIC, sizeof(out->header->magic)) ||
+      out->header->version != TB_VERSION || out->header->kind != kind ||
+      out->header->entries != desc->entries || strncmp(out->header->name, desc->name, sizeof(desc->name)) ||
+      (size_t) (out->runs - out->map) + out->offsets[out->header->num_blocks] > out->length)
+  {
+    munmap(map, st.st_size);
+    return 1;
+  }
+  return 0;
+}
+
+static void
+tb_unmap(struct tb_file *file)
+{
+  if (file->map) munmap((void *) file->map, file->length);
+  memset(file, 0, sizeof(*file));
+}
+
+// decodes the runs of one block up to the entry
+static uint16_t
+tb_read(const struct tb_file *file, uint64_t index)
+{
+  const uint8_t *p = file->runs + file->offsets[index / file->header->block_size];
+  uint64_t pos = index % file->header->block_size, run;
+  uint16_t value;
+  unsigned shift;
+
+  for (;;)
+  {
+    memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    for (run = 0, shift = 0; *p & 0x80; shift += 7) run |= (uint64_t) (*p++ & 0x7F) << shift;
+    run |= (uint64_t) *p++ << shift;
+
+    if (pos < run) return value;
+    pos -= run;
+  }
+}
+
+static struct tb_table *
+tb_slot(uint64_t key)
+{
+  size_t i = (key * 0x9E3779B97F4A7C15ull) >> 57;
+
+  while (slots[i].desc.material_key && slots[i].desc.material_key != key) i = (i + 1) % TB_SLOTS;
+  return &slots[i];
+}
+
+int
+tb_load(const char *directory, const char *name)
+{
+  char path[4096];
+  struct tb_table table = { 0 }, *slot;
+
+  if (tb_desc_parse(name, &table.desc)) return 1;
+
+  snprintf(path, sizeof(path), "%s/%s.wdl", directory, name);
+  if (tb_map(path, TB_FILE_WDL, &table.desc, &table.wdl)) return 1;
+  snprintf(path, sizeof(path), "%s/%s.dtm", directory, name);
+  if (tb_map(path, TB_FILE_DTM, &table.desc, &table.dtm))
+  {
+    tb_unmap(&table.wdl);
+    return 1;
+  }
+
+  slot = tb_slot(table.desc.material_key);
+  if (slot->desc.material_key)
+  {
+    tb_unmap(&slot->wdl);
+    tb_unmap(&slot->dtm);
+  }
+  else if (num_tables == TB_SLOTS / 2)
+  {
+    tb_unmap(&table.wdl);
+    tb_unmap(&table.dtm);
+    return 1;
+  }
+  else ++num_tables;
+
+  *slot = table;
+  return 0;
+}
+
+size_t
+tb_init(const char *directory)
+{
+  struct dirent *entry;
+  char name[16];
+  size_t length;
+  DIR *dir;
+
+  // LINUX
+  dir = opendir(directory);
+  if (!dir) return num_tables;
+
+  while ((entry = readdir(dir)))
+  {
+    length = strlen(entry->d_name);
+    if (length < 5 || length - 4 >= sizeof(name) || strcmp(entry->d_name + length - 4, ".wdl")) continue;
+    memcpy(name, entry->d_name, length - 4);
+    name[length - 4] = '\0';
+    tb_load(directory, name);
+  }
+
+  closedir(dir);
+  return num_tables;
+}
+
+void
+tb_free(void)
+{
+  size_t i;
+
+  for (i = 0; i < TB_SLOTS; ++i)
+  {
+    tb_unmap(&slots[i].wdl);
+    tb_unmap(&slots[i].dtm);
+  }
+  memset(slots, 0, sizeof(slots));
+  num_tables = 0;
+}
+
+size_t
+tb_count(void)
+{
+  return num_tables;
+}
+
+
+/* PROBING */
+int
+tb_probe(const game_state *game, irreversable_state meta, int *wdl, int *plies)
+{
+  const uint64_t key = game->material_key,
+                 swapped = (key & 0xFFFFF) << 20 | key >> 20;
+  const struct tb_table *table;
+  uint64_t index;
+  int16_t value;
+  int flip = 0;
+
+  if (meta.castling_rights || meta.en_passant_potential) return 1;
+
+  // bare kings need no table, the generator relies on that for its first captures
+  if (!key)
+  {
+    *wdl = TB_DRAW;
+    if (plies) *plies = 0;
+    return 0;
+  }
+  if (!num_tables) return 1;
+
+  table = tb_slot(key);
+  if (!table->desc.material_key)
+  {
+    table = tb_slot(swapped);
+    if (!table->desc.material_key) return 1;
+    flip = 1;
+  }
+
+  // reached by a move that left the king en prise: the search has to see it captured
+  if (!is_board_legal((board_state *) &game->board, game->active)) return 1;
+
+  index = tb_index(&table->desc, &game->board, game->active, flip);
+  switch (tb_read(&table->wdl, index))
+  {
+  case 1: *wdl = TB_WIN; break;
+  case 2: *wdl = TB_LOSS; break;
+  default: *wdl = TB_DRAW; break;
+  }
+
+  if (plies)
+  {
+    // stored as n for a win and -(n + 1) for a loss in n plies
+    value = (int16_t) tb_read(&table->dtm, index);
+    *plies = value > 0 ? value : value < 0 ? -value - 1 : 0;
+  }
+  return 0;
+}
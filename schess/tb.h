@@ -0,0 +1,80 @@
+#ifndef SCHESS_TB_H
+#define SCHESS_TB_H
+
+#include <schess/types.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * endgame tablebases for up to TB_MAX_PIECES men, generated by tbgen.c. each table
+ * has a WDL and a DTM file; both are block wise run length encoded so a probe only
+ * decodes one block of the mapped file.
+ */
+#define TB_MAX_PIECES 4
+#define TB_DEFAULT_DIR "target/TBs"
+
+#define TB_MAGIC "SCHESSTB"
+#define TB_VERSION 1u
+#define TB_BLOCK_SIZE 4096
+
+enum TB_FILE_KIND { TB_FILE_WDL, TB_FILE_DTM };
+enum TB_WDL { TB_LOSS = -1, TB_DRAW = 0, TB_WIN = 1 };
+
+// scores handed to the search; the tables know the distance to mate, so a win in n plies
+// is the same score as a mate in n plies
+#define TB_WIN_SCORE MATE
+
+struct tb_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t kind;
+  uint64_t entries;
+  uint32_t block_size;
+  uint32_t num_blocks;
+  char name[16];
+  // followed by num_blocks + 1 uint64_t offsets into the runs, then the runs themselves
+};
+
+/* layout of a table: the side to move, both kings, then the other pieces white first */
+struct tb_desc
+{
+  char name[16];             // e.g. KRvKP
+  uint64_t material_key;     // of the position as stored
+  unsigned num_pieces;       // without the kings
+  piece_type pieces[TB_MAX_PIECES - 2];
+  uint64_t entries;
+};
+
+// fills `out` from a name like KQvKR; returns 0 on success
+int tb_desc_parse(const char *name, struct tb_desc *out);
+// index of `board` in table orientation; `flip` mirrors the ranks and swaps the colors
+uint64_t tb_index(const struct tb_desc *desc, const board_state *board, color active, int flip);
+
+// maps every table found in `directory`; returns the number of tables loaded
+size_t tb_init(const char *directory);
+// maps one table, replacing a loaded one of the same material; returns 0 on success
+int tb_load(const char *directory, const char *name);
+void tb_free(void);
+size_t tb_count(void);
+
+/*
+ * exact result of the position for the side to move. positions with castling rights,
+ * an en passant square, material without a table or the opponent's king in check are
+ * not answered (returns nonzero).
+ * `plies` (may be NULL) receives the distance to mate of a win or loss.
+ */
+int tb_probe(const game_state *game, irreversable_state meta, int *wdl, int *plies);
+
+static inline int
+tb_score(int wdl, int plies)
+{
+  return wdl == TB_WIN ? TB_WIN_SCORE - plies : wdl == TB_LOSS ? -TB_WIN_SCORE + plies : 0;
+}
+
+// generates `name` into `directory`; the tables its captures and promotions reach must be loaded
+int tb_generate(const char *directory, const char *name, unsigned threads);
+// all tables up to TB_MAX_PIECES men, in dependency order
+int tb_generate_all(const char *directory, unsigned threads);
+
+#endif // SCHESS_TB_H
@@ -0,0 +1,536 @@
+#include <errno.h>
+#include <pthread.h>
+#include <schess/gen.h>
+#include <schess/material.h>
+#include <schess/move.h>
+#include <schess/tb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * forward retrograde generation: iteration k resolves the positions won in k plies
+ * (a move reaches a loss in k - 1) and lost in k plies (every move reaches a win, the
+ * longest in k - 1). captures and promotions leave the table; their results are read
+ * from the smaller tables once, up front. en passant is not part of the positions.
+ *
+ * values are from the side to move: n wins in n plies, -(n + 1) loses in n plies,
+ * 0 is unresolved (a draw once nothing changes anymore).
+ */
+#define VALUE_WIN(n)  ((int16_t) (n))
+#define VALUE_LOSS(n) ((int16_t) (-(n) - 1))
+#define VALUE_INVALID INT16_MIN
+#define VALUE_IS_WIN(v)  ((v) > 0)
+#define VALUE_IS_LOSS(v) ((v) < 0 && (v) != VALUE_INVALID)
+#define VALUE_PLIES(v)   ((v) > 0 ? (v) : -(v) - 1)
+
+// best exit of a position: > 0 wins through an exit in that many plies, EXIT_DRAW some exit
+// does not lose, < 0 every exit loses and the longest takes -exit plies, 0 there are none
+#define EXIT_DRAW INT16_MIN
+
+#define GEN_CHUNK 4096
+#define CHECKPOINT_SECONDS 30
+
+struct tb_gen
+{
+  struct tb_desc desc;
+  int16_t *values;
+  int16_t *exits;
+  uint8_t *done;
+  unsigned iteration;
+  uint64_t next_chunk;   // work distribution, atomically incremented
+  int changed;
+  int16_t max_exit;      // longest exit distance, iterations must reach past it
+  int error;
+};
+
+
+/* POSITIONS */
+// sets up the position of `index`; returns 0 if it is invalid
+static int
+gen_setup(const struct tb_desc *desc, uint64_t index, game_state *game, irreversable_state *meta)
+{
+  square squares[TB_MAX_PIECES], sq;
+  piece_type types[TB_MAX_PIECES];
+  bitboard occ = 0;
+  unsigned i, n = desc->num_pieces + 2;
+
+  memset(game, 0, sizeof(*game));
+  memset(meta, 0, sizeof(*meta));
+  game->active = index & 1 ? COLOR_BLACK : COLOR_WHITE;
+  index >>= 1;
+
+  types[0] = PT_WK;
+  types[1] = PT_BK;
+  for (i = 0; i < desc->num_pieces; ++i) types[i + 2] = desc->pieces[i];
+
+  for (i = 0; i < n; ++i, index >>= 6)
+  {
+    sq = squares[i] = index & 63;
+    if (occ & sq2bb(sq)) return 0;
+    // pawns never stand on the first or last rank
+    if ((types[i] == PT_WP || types[i] == PT_BP) && (sq < a2 || sq > h7)) return 0;
+    occ |= sq2bb(sq);
+  }
+
+  for (i = 0; i < n; ++i)
+  {
+    game->board.bitboards[types[i]] |= sq2bb(squares[i]);
+    game->board.types[squares[i]] = types[i];
+  }
+  material_refresh(game);
+
+  // the side that just moved must not be in check
+  return is_board_legal(&game->board, game->active);
+}
+
+static int16_t
+gen_exit_value(game_state *game, irreversable_state meta)
+{
+  int wdl, plies;
+
+  if (tb_probe(game, meta, &wdl, &plies)) return VALUE_INVALID;
+  return wdl == TB_WIN ? VALUE_WIN(plies) : wdl == TB_LOSS ? VALUE_LOSS(plies) : 0;
+}
+
+static int
+gen_leaves_table(const move *m)
+{
+  return m->capture != PT_NONE || m->type == MT_EN_PASSANT ||
+         (m->type >= MT_PROMOTION_KNIGHT && m->type <= MT_PROMOTION_QUEEN);
+}
+
+
+/* PASSES */
+// classifies mates and invalid positions and collects the exits
+static void
+gen_init_position(struct tb_gen *gen, uint64_t index, game_state *game, struct move_buffer *mbuf)
+{
+  irreversable_state meta, meta_copy;
+  size_t i, num_moves, legal = 0;
+  int16_t exit = 0, v;
+  int plies;
+
+  gen->exits[index] = 0;
+  if (!gen_setup(&gen->desc, index, game, &meta))
+  {
+    gen->values[index] = VALUE_INVALID;
+    gen->done[index] = 1;
+    return;
+  }
+
+  num_moves = generate_moves(game, meta, mbuf);
+  for (i = 0; i < num_moves; ++i)
+  {
+    move *m = mbuf->moves + i;
+    meta_copy = meta;
+    move_make(m, game, &meta_copy);
+
+    if (is_board_legal(&game->board, game->active))
+    {
+      ++legal;
+      if (gen_leaves_table(m))
+      {
+        v = gen_exit_value(game, meta_copy);
+        plies = VALUE_PLIES(v) + 1;
+        if (v == VALUE_INVALID) __atomic_store_n(&gen->error, 1, __ATOMIC_RELAXED); // GCC
+        // the opponent loses: the fastest such exit wins
+        else if (VALUE_IS_LOSS(v)) { if (exit <= 0 || plies < exit) exit = plies; }
+        // a drawn exit rules out losing
+        else if (!VALUE_IS_WIN(v)) { if (exit <= 0) exit = EXIT_DRAW; }
+        // while every exit loses, the longest counts
+        else if (exit <= 0 && exit != EXIT_DRAW && -plies < exit) exit = -plies;
+      }
+    }
+
+    move_unmake(m, game);
+  }
+
+  gen->exits[index] = exit;
+  if (!legal)
+  {
+    // mate, or stalemate which stays a draw
+    gen->values[index] = is_in_check(&game->board, game->active) ? VALUE_LOSS(0) : 0;
+    gen->done[index] = 1;
+  }
+  else gen->values[index] = 0;
+}
+
+static int
+gen_iterate_position(struct tb_gen *gen, uint64_t index, game_state *game, struct move_buffer *mbuf)
+{
+  const unsigned k = gen->iteration;
+  const int16_t exit = gen->exits[index];
+  irreversable_state meta, meta_copy;
+  size_t i, num_moves;
+  int win = exit > 0 && (unsigned) exit == k,
+      loss = exit <= 0 && exit != EXIT_DRAW;
+  unsigned longest = exit < 0 && exit != EXIT_DRAW ? (unsigned) -exit : 0;
+  int16_t v;
+
+  gen_setup(&gen->desc, index, game, &meta);
+
+  num_moves = generate_moves(game, meta, mbuf);
+  for (i = 0; i < num_moves && !win; ++i)
+  {
+    move *m = mbuf->moves + i;
+    if (gen_leaves_table(m)) continue;
+
+    meta_copy = meta;
+    move_make(m, game, &meta_copy);
+    if (is_board_legal(&game->board, game->active))
+    {
+      v = __atomic_load_n(&gen->values[tb_index(&gen->desc, &game->board, game->active, 0)], __ATOMIC_RELAXED); // GCC
+      if (VALUE_IS_LOSS(v) && VALUE_PLIES(v) + 1u == k) win = 1;
+      else if (!VALUE_IS_WIN(v)) loss = 0;
+      else if (VALUE_PLIES(v) + 1u > longest) longest = VALUE_PLIES(v) + 1;
+    }
+    move_unmake(m, game);
+  }
+
+  if (win) __atomic_store_n(&gen->values[index], VALUE_WIN(k), __ATOMIC_RELAXED);
+  else if (loss && longest == k) __atomic_store_n(&gen->values[index], VALUE_LOSS(k), __ATOMIC_RELAXED);
+  else return 0;
+
+  gen->done[index] = 1;
+  return 1;
+}
+
+struct gen_worker
+{
+  struct tb_gen *gen;
+  int init;
+};
+
+static void *
+gen_worker_run(void *arg)
+{
+  struct gen_worker *worker = arg;
+  struct tb_gen *gen = worker->gen;
+  struct move_buffer *mbuf = move_buffer_create(1);
+  game_state game;
+  uint64_t chunk, index, end;
+  int changed = 0;
+
+  // GCC
+  while ((chunk = __atomic_fetch_add(&gen->next_chunk, GEN_CHUNK, __ATOMIC_RELAXED)) < gen->desc.entries)
+  {
+    end = chunk + GEN_CHUNK < gen->desc.entries ? chunk + GEN_CHUNK : gen->desc.entries;
+    for (index = chunk; index < end; ++index)
+    {
+      if (worker->init) gen_init_position(gen, index, &game, mbuf);
+      else if (!gen->done[index]) changed |= gen_iterate_position(gen, index, &game, mbuf);
+    }
+  }
+
+  if (changed) __atomic_store_n(&gen->changed, 1, __ATOMIC_RELAXED);
+  move_buffer_destroy(mbuf);
+  return NULL;
+}
+
+static int
+gen_pass(struct tb_gen *gen, unsigned threads, int init)
+{
+  pthread_t ids[threads];
+  struct gen_worker worker = { gen, init };
+  unsigned t;
+
+  gen->next_chunk = 0;
+  gen->changed = 0;
+  for (t = 1; t < threads; ++t)
+    if (pthread_create(&ids[t], NULL, gen_worker_run, &worker)) return 1;
+  gen_worker_run(&worker);
+  for (t = 1; t < threads; ++t) pthread_join(ids[t], NULL);
+  return 0;
+}
+
+
+/* CHECKPOINTS */
+struct gen_checkpoint
+{
+  char magic[8];
+  char name[16];
+  uint64_t entries;
+  uint32_t iteration;
+};
+
+static int
+gen_write_file(const char *path, const void *header, size_t header_size, const void *data, size_t data_size)
+{
+  char tmp[4096 + sizeof(".tmp")];
+  FILE *file;
+  int err;
+
+  // written aside and renamed, so an interrupted run never leaves a truncated file
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  file = fopen(tmp, "wb");
+  if (!file) return 1;
+  err = fwrite(header, 1, header_size, file) != header_size
+     || (data_size && fwrite(data, 1, data_size, file) != data_size);
+  err |= fclose(file) != 0;
+  if (!err) err = rename(tmp, path) != 0;
+  return err;
+}
+
+static int
+gen_save_checkpoint(const char *directory, const struct tb_gen *gen)
+{
+  struct gen_checkpoint cp = { TB_MAGIC, { 0 }, gen->desc.entries, gen->iteration };
+  char path[4096];
+
+  strcpy(cp.name, gen->desc.name);
+  snprintf(path, sizeof(path), "%s/%s.partial", directory, gen->desc.name);
+  return gen_write_file(path, &cp, sizeof(cp), gen->values, gen->desc.entries * sizeof(int16_t));
+}
+
+// restores the values of an interrupted run; returns 0 if there was one
+static int
+gen_load_checkpoint(const char *directory, struct tb_gen *gen)
+{
+  struct gen_checkpoint cp;
+  char path[4096];
+  uint64_t index;
+  FILE *file;
+  int err;
+
+  snprintf(path, sizeof(path), "%s/%s.partial", directory, gen->desc.name);
+  file = fopen(path, "rb");
+  if (!file) return 1;
+
+  err = fread(&cp, sizeof(cp), 1, file) != 1
+     || memcmp(cp.magic, TB_MAGIC, sizeof(cp.magic)) || strcmp(cp.name, gen->desc.name)
+     || cp.entries != gen->desc.entries
+     || fread(gen->values, sizeof(int16_t), gen->desc.entries, file) != gen->desc.entries;
+  fclose(file);
+  if (err) return 1;
+
+  gen->iteration = cp.iteration;
+  for (index = 0; index < gen->desc.entries; ++index)
+    gen->done[index] = gen->values[index] != 0 || gen->done[index];
+  return 0;
+}
+
+
+/* OUTPUT */
+static void
+put_varint(uint8_t **p, uint64_t v)
+{
+  while (v >= 0x80)
+  {
+    *(*p)++ = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  *(*p)++ = v;
+}
+
+// run length encodes `symbols` block wise; invalid positions take the previous symbol
+static int
+gen_write_table(const char *directory, const struct tb_gen *gen, enum TB_FILE_KIND kind)
+{
+  const uint64_t entries = gen->desc.entries;
+  const uint32_t num_blocks = (entries + TB_BLOCK_SIZE - 1) / TB_BLOCK_SIZE;
+  // worst case one run per entry: value + one varint byte
+  size_t header_size = sizeof(struct tb_header) + (num_blocks + 1) * sizeof(uint64_t);
+  uint8_t *buffer = malloc(header_size + entries * 3), *p;
+  struct tb_header *header = (struct tb_header *) buffer;
+  uint64_t *offsets = (uint64_t *) (header + 1), index, run;
+  uint16_t symbol, previous = 0, current;
+  char path[4096];
+  uint32_t block;
+  int16_t v;
+  int err;
+
+  if (!buffer) return 1;
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, TB_MAGIC, sizeof(header->magic));
+  header->version = TB_VERSION;
+  header->kind = kind;
+  header->entries = entries;
+  header->block_size = TB_BLOCK_SIZE;
+  header->num_blocks = num_blocks;
+  strcpy(header->name, gen->desc.name);
+
+  p = buffer + header_size;
+  for (block = 0; block < num_blocks; ++block)
+  {
+    offsets[block] = p - (buffer + header_size);
+    run = 0;
+    current = 0;
+    for (index = (uint64_t) block * TB_BLOCK_SIZE; index < entries && index < (block + 1ull) * TB_BLOCK_SIZE; ++index)
+    {
+      v = gen->values[index];
+      if (v == VALUE_INVALID) symbol = previous;
+      else if (kind == TB_FILE_DTM) symbol = (uint16_t) v;
+      else symbol = VALUE_IS_WIN(v) ? 1 : VALUE_IS_LOSS(v) ? 2 : 0;
+      previous = symbol;
+
+      if (run && symbol == current)
+      {
+        ++run;
+        continue;
+      }
+      if (run)
+      {
+        memcpy(p, &current, sizeof(current));
+        p += sizeof(current);
+        put_varint(&p, run);
+      }
+      current = symbol;
+      run = 1;
+    }
+    memcpy(p, &current, sizeof(current));
+    p += sizeof(current);
+    put_varint(&p, run);
+  }
+  offsets[num_blocks] = p - (buffer + header_size);
+
+  snprintf(path, sizeof(path), "%s/%s.%s", directory, gen->desc.name, kind == TB_FILE_WDL ? "wdl" : "dtm");
+  err = gen_write_file(path, buffer, p - buffer, NULL, 0);
+  free(buffer);
+  return err;
+}
+
+
+/* DRIVER */
+static int
+gen_exists(const char *directory, const char *name)
+{
+  char path[4096];
+
+  snprintf(path, sizeof(path), "%s/%s.dtm", directory, name);
+  if (access(path, R_OK)) return 0;
+  snprintf(path, sizeof(path), "%s/%s.wdl", directory, name);
+  return !access(path, R_OK);
+}
+
+int
+tb_generate(const char *directory, const char *name, unsigned threads)
+{
+  struct tb_gen gen = { 0 };
+  char path[4096];
+  uint64_t index;
+  time_t last_checkpoint;
+  int err = 1;
+
+  if (tb_desc_parse(name, &gen.desc)) return 1;
+  if (gen_exists(directory, name)) return tb_load(directory, name);
+  if (!threads) threads = 1;
+
+  gen.values = malloc(gen.desc.entries * sizeof(int16_t));
+  gen.exits  = malloc(gen.desc.entries * sizeof(int16_t));
+  gen.done   = calloc(gen.desc.entries, 1);
+  if (!gen.values || !gen.exits || !gen.done) goto out;
+
+  move_gen_init_LUTs();
+  if (gen_pass(&gen, threads, 1) || gen.error) goto out;
+
+  for (index = 0; index < gen.desc.entries; ++index)
+  {
+    int16_t e = gen.exits[index];
+    if (e != EXIT_DRAW && (e > 0 ? e : -e) > gen.max_exit) gen.max_exit = e > 0 ? e : -e;
+  }
+
+  gen_load_checkpoint(directory, &gen);
+  last_checkpoint = time(NULL);
+
+  // nothing changing only ends the search once no exit distance is left to reach
+  for (++gen.iteration;; ++gen.iteration)
+  {
+    if (gen_pass(&gen, threads, 0)) goto out;
+    if (!gen.changed && gen.iteration > (unsigned) gen.max_exit) break;
+
+    if (time(NULL) - last_checkpoint >= CHECKPOINT_SECONDS)
+    {
+      if (gen_save_checkpoint(directory, &gen)) goto out;
+      last_checkpoint = time(NULL);
+    }
+  }
+
+  err = gen_write_table(directory, &gen, TB_FILE_WDL) || gen_write_table(directory, &gen, TB_FILE_DTM);
+  if (!err)
+  {
+    snprintf(path, sizeof(path), "%s/%s.partial", directory, name);
+    remove(path);
+    err = tb_load(directory, name);
+  }
+
+out:
+  free(gen.values);
+  free(gen.exits);
+  free(gen.done);
+  return err;
+}
+
+// all tables: three men first, then four men by the number of pawns, since promotions remove one
+int
+tb_generate_all(const char *directory, unsigned threads)
+{
+  const char order[] = "QRBNP";
+  char name[16];
+  unsigned i, j, k;
+  int pawns;
+  int err = 0;
+
+  tb_init(directory);
+
+  for (i = 0; i < 5 && !err; ++i)
+  {
+    snprintf(name, sizeof(name), "K%cvK", order[i]);
+    err = tb_generate(directory, name, threads);
+  }
+
+  for (pawns = 0; pawns <= 2 && !err; ++pawns)
+  {
+    // both pieces on one side, stronger piece first
+    for (i = 0; i < 5 && !err; ++i)
+      for (j = i; j < 5 && !err; ++j)
+      {
+        if ((order[i] == 'P') + (order[j] == 'P') != pawns) continue;
+        snprintf(name, sizeof(name), "K%c%cvK", order[i], order[j]);
+        err = tb_generate(directory, name, threads);
+      }
+    // one piece each, the stronger one white
+    for (i = 0; i < 5 && !err; ++i)
+      for (k = i; k < 5 && !err; ++k)
+      {
+        if ((order[i] == 'P') + (order[k] == 'P') != pawns) continue;
+        snprintf(name, sizeof(name), "K%cvK%c", order[i], order[k]);
+        err = tb_generate(directory, name, threads);
+      }
+  }
+
+  return err;
+}
+
+
+#ifdef TB_GEN_EXEC
+int
+main(int argc, char **argv)
+{
+  unsigned threads;
+  int i, err = 0;
+
+  if (argc < 3)
+  {
+    fprintf(stderr, "Required arguments: <directory> <threads> [tables, e.g. KRvKP]\n");
+    exit(EXIT_FAILURE);
+  }
+  threads = strtoul(argv[2], NULL, 10);
+
+  if (argc == 3) err = tb_generate_all(argv[1], threads);
+  else
+  {
+    tb_init(argv[1]);
+    for (i = 3; i < argc && !err; ++i)
+    {
+      err = tb_generate(argv[1], argv[i], threads);
+      if (err) fprintf(stderr, "Error generating %s: %s\n", argv[i], errno ? strerror(errno) : "missing dependency");
+    }
+  }
+
+  tb_free();
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+#endif // TB_GEN_EXEC
@@ -0,0 +1,175 @@
+#include <schess/tt.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TT_BUCKET_SIZE 4
+
+struct tt_slot
+{
+  uint64_t check; // key ^ data
+  uint64_t data;
+};
+
+struct tt_bucket
+{
+  struct tt_slot slots[TT_BUCKET_SIZE];
+} __attribute__((aligned(64))); // GCC
+
+static struct tt_bucket *table;
+static size_t mask;
+static unsigned generation;
+
+static _Thread_local struct tt_stats stats;
+
+/*
+ * data layout, low to high: from (6), to (6), capture (4), move type (4), depth (8),
+ * bound (2), generation (2), score (32)
+ */
+static inline uint64_t
+tt_pack(move best, int score, unsigned depth, enum TT_BOUND bound)
+{
+  return (uint64_t) best.from
+       | (uint64_t) best.to << 6
+       | (uint64_t) best.capture << 12
+       | (uint64_t) best.type << 16
+       | (uint64_t) (depth > 255 ? 255 : depth) << 20
+       | (uint64_t) bound << 28
+       | (uint64_t) generation << 30
+       | (uint64_t) (uint32_t) score << 32;
+}
+
+static inline void
+tt_unpack(uint64_t data, struct tt_entry *out)
+{
+  out->best = (move) { data & 0x3F, data >> 6 & 0x3F, data >> 12 & 0xF, data >> 16 & 0xF };
+  out->depth = data >> 20 & 0xFF;
+  out->bound = data >> 28 & 0x3;
+  out->score = (int32_t) (uint32_t) (data >> 32);
+}
+
+int
+tt_resize(size_t megabytes)
+{
+  size_t buckets = 1;
+
+  free(table);
+  table = NULL;
+  mask = 0;
+
+  // largest power of two that fits
+  while (buckets * 2 * sizeof(struct tt_bucket) <= (megabytes << 20)) buckets *= 2;
+
+  table = aligned_alloc(sizeof(struct tt_bucket), buckets * sizeof(struct tt_bucket));
+  if (!table) return 1;
+  mask = buckets - 1;
+  tt_clear();
+  return 0;
+}
+
+void
+tt_clear(void)
+{
+  if (table) memset(table, 0, (mask + 1) * sizeof(struct tt_bucket));
+  generation = 0;
+}
+
+void
+tt_new_search(void)
+{
+  generation = (generation + 1) & 0x3;
+}
+
+// GCC
+__attribute__((constructor)) static void
+tt_init(void)
+{
+  tt_resize(TT_DEFAULT_MB);
+}
+
+int
+tt_probe(uint64_t key, struct tt_entry *out)
+{
+  struct tt_slot *slot;
+  uint64_t check, data;
+  size_t i;
+
+  if (!table || !key) return 0;
+  ++stats.probes;
+
+  slot = table[key & mask].slots;
+  for (i = 0; i < TT_BUCKET_SIZE; ++i)
+  {
+    check = __atomic_load_n(&slot[i].check, __ATOMIC_RELAXED); // GCC
+    data  = __atomic_load_n(&slot[i].data, __ATOMIC_RELAXED);
+    if ((check ^ data) != key) continue;
+
+    ++stats.hits;
+    tt_unpack(data, out);
+    return 1;
+  }
+  return 0;
+}
+
+void
+tt_store(uint64_t key, move best, int score, unsigned depth, enum TT_BOUND bound)
+{
+  struct tt_slot *slot, *victim = NULL;
+  uint64_t check, data;
+  int worth, lowest = INT_MAX;
+  size_t i;
+
+  if (!table || !key) return;
+  ++stats.stores;
+
+  slot = table[key & mask].slots;
+  for (i = 0; i < TT_BUCKET_SIZE; ++i)
+  {
+    check = __atomic_load_n(&slot[i].check, __ATOMIC_RELAXED); // GCC
+    data  = __atomic_load_n(&slot[i].data, __ATOMIC_RELAXED);
+
+    if ((check ^ data) == key)
+    {
+      // a bound without a move keeps the one found earlier
+      if (best.type == MT_NULL) best = (move) { data & 0x3F, data >> 6 & 0x3F, data >> 12 & 0xF, data >> 16 & 0xF };
+      victim = &slot[i];
+      break;
+    }
+
+    // empty slots first, then the shallowest, every search of age costing eight plies
+    worth = !check && !data ? INT_MIN
+          : (int) (data >> 20 & 0xFF) - 8 * (int) ((generation - (data >> 30)) & 0x3);
+    if (worth < lowest)
+    {
+      lowest = worth;
+      victim = &slot[i];
+    }
+  }
+
+  data = tt_pack(best, score, depth, bound);
+  __atomic_store_n(&victim->check, key ^ data, __ATOMIC_RELAXED); // GCC
+  __atomic_store_n(&victim->data, data, __ATOMIC_RELAXED);
+}
+
+unsigned
+tt_hashfull(void)
+{
+  size_t i, j, used = 0, sample = mask + 1 < 250 ? mask + 1 : 250;
+
+  if (!table) return 0;
+  for (i = 0; i < sample; ++i)
+    for (j = 0; j < TT_BUCKET_SIZE; ++j)
+      used += table[i].slots[j].data && (table[i].slots[j].data >> 30 & 0x3) == generation;
+  return used * 1000 / (sample * TT_BUCKET_SIZE);
+}
+
+struct tt_stats
+tt_stats(void)
+{
+  return stats;
+}
+
+void
+tt_stats_reset(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
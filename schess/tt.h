@@ -0,0 +1,48 @@
+#ifndef SCHESS_TT_H
+#define SCHESS_TT_H
+
+#include <schess/types.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TT_DEFAULT_MB 16
+
+enum TT_BOUND { TT_NONE, TT_UPPER, TT_LOWER, TT_EXACT };
+
+struct tt_entry
+{
+  move best;            // MT_NULL if the node had none
+  int score;
+  unsigned depth;
+  enum TT_BOUND bound;
+};
+
+struct tt_stats
+{
+  uint64_t probes, hits, stores;
+};
+
+/*
+ * transposition table keyed by zobrist_position_key, shared by all search threads
+ * without locks: like the eval cache, an entry stores its key xor its data. a bucket
+ * holds four entries in one cache line; the shallowest entry of an older search is
+ * replaced first.
+ */
+// resizes and clears the table; returns 0 on success
+int tt_resize(size_t megabytes);
+void tt_clear(void);
+// ages the entries of earlier searches, so they are replaced before the current ones
+void tt_new_search(void);
+
+// returns 1 and fills `out` if `key` is stored
+int tt_probe(uint64_t key, struct tt_entry *out);
+void tt_store(uint64_t key, move best, int score, unsigned depth, enum TT_BOUND bound);
+
+// permille of the first entries written by the current search, for `info hashfull`
+unsigned tt_hashfull(void);
+
+// counters of the calling thread
+struct tt_stats tt_stats(void);
+void tt_stats_reset(void);
+
+#endif // SCHESS_TT_H
@@ -0,0 +1,431 @@
+#include <math.h>
+#include <pthread.h>
+#include <schess/attacks.h>
+#include <schess/eval.h>
+#include <schess/evalcache.h>
+#include <schess/gen.h>
+#include <schess/material.h>
+#include <schess/pawn.h>
+#include <schess/tune.h>
+#include <schess/utils.h>
+#include <schess/zobrist.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* DATASET */
+int
+tune_pack(const char *line, struct tune_position *out)
+{
+  game_state game;
+  irreversable_state meta;
+  char FEN[128];
+  const char *bracket;
+  size_t i, spaces;
+  bitboard occ;
+  square sq;
+
+  // the board, side to move, castling and en passant fields
+  for (i = spaces = 0; line[i] && line[i] != '\n' && i < sizeof(FEN) - 1; ++i)
+  {
+    if (line[i] == ' ' && ++spaces == 4) break;
+    FEN[i] = line[i];
+  }
+  if (spaces < 3) return 1;
+  FEN[i] = '\0';
+  if (parse_FEN(FEN, &game, &meta)) return 1;
+
+  // a bracketed label may be textual too, "[1/2-1/2]" would read as the number 1
+  if ((bracket = strchr(line, '[')) && !strncmp(bracket + 1, "1/2-1/2]", 8)) out->result = 0.5f;
+  else if (bracket && !strncmp(bracket + 1, "1-0]", 4)) out->result = 1.0f;
+  else if (bracket && !strncmp(bracket + 1, "0-1]", 4)) out->result = 0.0f;
+  else if (bracket) out->result = strtof(bracket + 1, NULL);
+  else if (strstr(line, "1/2-1/2")) out->result = 0.5f;
+  else if (strstr(line, "1-0")) out->result = 1.0f;
+  else if (strstr(line, "0-1")) out->result = 0.0f;
+  else return 1;
+
+  memset(out->pieces, 0, sizeof(out->pieces));
+  out->occupancy = 0;
+  for (sq = a1; sq < NUM_SQUARES; ++sq)
+    if (game.board.types[sq] != PT_NONE) out->occupancy |= sq2bb(sq);
+  if (__builtin_popcountll(out->occupancy) > 32) return 1; // GCC
+
+  for (occ = out->occupancy, i = 0; occ; occ &= occ - 1, ++i)
+  {
+    // GCC
+    sq = __builtin_ctzll(occ);
+    out->pieces[i / 2] |= game.board.types[sq] << (i & 1 ? 4 : 0);
+  }
+  out->active = game.active;
+  return 0;
+}
+
+void
+tune_unpack(const struct tune_position *position, game_state *game, irreversable_state *meta)
+{
+  bitboard occ;
+  piece_type pt;
+  square sq;
+  size_t i;
+
+  memset(game, 0, sizeof(*game));
+  memset(meta, 0, sizeof(*meta));
+  game->active = position->active;
+  game->fullmove = 1;
+
+  for (occ = position->occupancy, i = 0; occ; occ &= occ - 1, ++i)
+  {
+    // GCC
+    sq = __builtin_ctzll(occ);
+    pt = position->pieces[i / 2] >> (i & 1 ? 4 : 0) & 0xF;
+    game->board.types[sq] = pt;
+    game->board.bitboards[pt] |= sq2bb(sq);
+  }
+
+  eval_refresh(game);
+  zobrist_refresh(game);
+  material_refresh(game);
+}
+
+int
+tune_is_quiet(const struct tune_position *position)
+{
+  struct move_buffer moves;
+  game_state game;
+  irreversable_state meta;
+  size_t i;
+  move m;
+
+  tune_unpack(position, &game, &meta);
+  if (is_in_check(&game.board, game.active)) return 0;
+
+  generate_moves(&game, meta, &moves);
+  for (i = 0; i < moves.size; ++i)
+  {
+    m = moves.moves[i];
+    if (m.type == MT_PROMOTION_QUEEN || m.type == MT_EN_PASSANT) return 0;
+    if (m.capture != PT_NONE && see(&game.board, NULL, m.from, m.to) > 0) return 0;
+  }
+  return 1;
+}
+
+int
+tune_load(const char *path, struct tune_dataset *out)
+{
+  FILE *file = fopen(path, "r");
+  struct tune_position *grown;
+  size_t capacity = 1 << 16;
+  char line[512];
+
+  if (!file) return 1;
+  out->count = 0;
+  out->positions = malloc(capacity * sizeof(*out->positions));
+  if (!out->positions) goto fail;
+
+  while (fgets(line, sizeof(line), file))
+  {
+    if (out->count == capacity)
+    {
+      capacity *= 2;
+      grown = realloc(out->positions, capacity * sizeof(*out->positions));
+      if (!grown) goto fail;
+      out->positions = grown;
+    }
+    out->count += !tune_pack(line, &out->positions[out->count]) && tune_is_quiet(&out->positions[out->count]);
+  }
+
+  fclose(file);
+  return 0;
+
+fail:
+  fclose(file);
+  tune_dataset_free(out);
+  return 1;
+}
+
+void
+tune_dataset_free(struct tune_dataset *data)
+{
+  free(data->positions);
+  data->positions = NULL;
+  data->count = 0;
+}
+
+
+/* THREAD POOL */
+struct tuner_worker
+{
+  struct tuner *tuner;
+  unsigned index;
+};
+
+struct tuner
+{
+  const struct tune_dataset *data;
+  unsigned threads;
+  pthread_t *ids;
+  struct tuner_worker *workers;
+  pthread_barrier_t start, done;
+  double k;
+  double *partial;   // per worker
+  int quit;
+};
+
+static inline double
+sigmoid(double k, double score)
+{
+  return 1.0 / (1.0 + pow(10.0, -k * score / 400.0));
+}
+
+static double
+tuner_slice(struct tuner *tuner, unsigned index)
+{
+  const struct tune_dataset *data = tuner->data;
+  size_t i, begin = data->count * index / tuner->threads,
+         end = data->count * (index + 1) / tuner->threads;
+  game_state game;
+  irreversable_state meta;
+  double sum = 0, error;
+  int score;
+
+  // the pawn terms are cached per thread under the weights they were computed with
+  pawn_table_free();
+
+  for (i = begin; i < end; ++i)
+  {
+    tune_unpack(&data->positions[i], &game, &meta);
+    // tune_load kept quiet positions only, their static score needs no capture search
+    score = eval_position(&game, meta);
+    if (game.active == COLOR_BLACK) score = -score;
+    error = data->positions[i].result - sigmoid(tuner->k, score);
+    sum += error * error;
+  }
+  return sum;
+}
+
+static void *
+tuner_worker_run(void *arg)
+{
+  struct tuner_worker *worker = arg;
+  struct tuner *tuner = worker->tuner;
+
+  for (;;)
+  {
+    pthread_barrier_wait(&tuner->start);
+    if (tuner->quit) break;
+    tuner->partial[worker->index] = tuner_slice(tuner, worker->index);
+    pthread_barrier_wait(&tuner->done);
+  }
+
+  pawn_table_free();
+  return NULL;
+}
+
+struct tuner *
+tuner_create(const struct tune_dataset *data, unsigned threads)
+{
+  struct tuner *tuner = calloc(1, sizeof(*tuner));
+  unsigned t;
+
+  if (!tuner) return NULL;
+  if (!threads) threads = 1;
+
+  tuner->data = data;
+  tuner->threads = threads;
+  tuner->ids = calloc(threads, sizeof(*tuner->ids));
+  tuner->workers = calloc(threads, sizeof(*tuner->workers));
+  tuner->partial = calloc(threads, sizeof(*tuner->partial));
+  if (!tuner->ids || !tuner->workers || !tuner->partial) goto fail;
+
+  // cached scores would outlive the weights they were computed with
+  eval_cache_resize(0);
+
+  pthread_barrier_init(&tuner->start, NULL, threads);
+  pthread_barrier_init(&tuner->done, NULL, threads);
+  for (t = 0; t < threads; ++t) tuner->workers[t] = (struct tuner_worker) { tuner, t };
+  for (t = 1; t < threads; ++t)
+  {
+    if (pthread_create(&tuner->ids[t], NULL, tuner_worker_run, &tuner->workers[t]))
+    {
+      // the barriers wait for every thread, so the pool cannot run short handed
+      fprintf(stderr, "tuner: could not start worker %u\n", t);
+      abort();
+    }
+  }
+  return tuner;
+
+fail:
+  free(tuner->ids);
+  free(tuner->workers);
+  free(tuner->partial);
+  free(tuner);
+  return NULL;
+}
+
+void
+tuner_destroy(struct tuner *tuner)
+{
+  unsigned t;
+
+  tuner->quit = 1;
+  pthread_barrier_wait(&tuner->start);
+  for (t = 1; t < tuner->threads; ++t) pthread_join(tuner->ids[t], NULL);
+
+  pthread_barrier_destroy(&tuner->start);
+  pthread_barrier_destroy(&tuner->done);
+  free(tuner->ids);
+  free(tuner->workers);
+  free(tuner->partial);
+  free(tuner);
+  eval_cache_resize(EVAL_CACHE_DEFAULT_MB);
+}
+
+
+/* OPTIMIZATION */
+double
+tuner_error(struct tuner *tuner, double k)
+{
+  double sum = 0;
+  unsigned t;
+
+  if (!tuner->data->count) return 0;
+
+  tuner->k = k;
+  pthread_barrier_wait(&tuner->start);
+  tuner->partial[0] = tuner_slice(tuner, 0);
+  pthread_barrier_wait(&tuner->done);
+
+  for (t = 0; t < tuner->threads; ++t) sum += tuner->partial[t];
+  return sum / tuner->data->count;
+}
+
+double
+tuner_fit_k(struct tuner *tuner)
+{
+  double k = 1.0, step = 0.5, best = tuner_error(tuner, k), error;
+  int improved;
+
+  // the error is convex in k: walk downhill, halving the step once neither side helps
+  while (step > 0.001)
+  {
+    improved = 0;
+    if ((error = tuner_error(tuner, k + step)) < best) { best = error; k += step; improved = 1; }
+    else if (k - step > 0 && (error = tuner_error(tuner, k - step)) < best) { best = error; k -= step; improved = 1; }
+    if (!improved) step /= 2;
+  }
+  return k;
+}
+
+static size_t
+tuner_step_params(struct tuner *tuner, double k, double *best, const struct eval_param *params, size_t num)
+{
+  size_t p, i, changed = 0;
+  double error;
+  int *value;
+
+  for (p = 0; p < num; ++p)
+  {
+    for (i = 0; i < params[p].count; ++i)
+    {
+      value = &params[p].values[i];
+
+      *value += 1;
+      eval_params_changed();
+      error = tuner_error(tuner, k);
+      if (error < *best) { *best = error; ++changed; continue; }
+
+      // weights no position depends on are left alone
+      if (error != *best)
+      {
+        *value -= 2;
+        eval_params_changed();
+        error = tuner_error(tuner, k);
+        if (error < *best) { *best = error; ++changed; continue; }
+        *value += 1;
+      }
+      else *value -= 1;
+      eval_params_changed();
+    }
+  }
+  return changed;
+}
+
+size_t
+tuner_step(struct tuner *tuner, double k, double *error)
+{
+  double best = tuner_error(tuner, k);
+  size_t changed;
+
+  changed  = tuner_step_params(tuner, k, &best, eval_params, eval_num_params);
+  changed += tuner_step_params(tuner, k, &best, pawn_params, pawn_num_params);
+
+  if (error) *error = best;
+  return changed;
+}
+
+static void
+print_params(FILE *out, const struct eval_param *params, size_t num)
+{
+  size_t p, i;
+
+  for (p = 0; p < num; ++p)
+  {
+    fprintf(out, "%s =\n{", params[p].name);
+    for (i = 0; i < params[p].count; ++i)
+      fprintf(out, "%s%5d,", i % 8 ? "" : "\n ", params[p].values[i]);
+    fprintf(out, "\n};\n");
+  }
+}
+
+void
+tune_print_params(FILE *out)
+{
+  print_params(out, eval_params, eval_num_params);
+  print_params(out, pawn_params, pawn_num_params);
+}
+
+
+#ifdef TUNE_EXEC
+// schessTune <dataset> [threads] [passes]: prints the tuned weights to stdout
+int
+main(int argc, char **argv)
+{
+  struct tune_dataset data;
+  struct tuner *tuner;
+  unsigned threads = argc > 2 ? strtoul(argv[2], NULL, 10) : 1,
+           passes  = argc > 3 ? strtoul(argv[3], NULL, 10) : 1000, pass;
+  double k, error;
+  size_t changed;
+
+  if (argc < 2 || argc > 4)
+  {
+    fprintf(stderr, "usage: %s <dataset> [threads] [passes]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (tune_load(argv[1], &data))
+  {
+    fprintf(stderr, "Error loading %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr, "%zu positions\n", data.count);
+
+  tuner = tuner_create(&data, threads);
+  if (!tuner) return EXIT_FAILURE;
+
+  k = tuner_fit_k(tuner);
+  fprintf(stderr, "K = %.4f, error %.6f\n", k, tuner_error(tuner, k));
+
+  for (pass = 0; pass < passes; ++pass)
+  {
+    changed = tuner_step(tuner, k, &error);
+    fprintf(stderr, "pass %u: %zu weights changed, error %.6f\n", pass + 1, changed, error);
+    if (!changed) break;
+  }
+
+  tune_print_params(stdout);
+  tuner_destroy(tuner);
+  tune_dataset_free(&data);
+  return EXIT_SUCCESS;
+}
+#endif
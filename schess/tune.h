@@ -0,0 +1,62 @@
+#ifndef SCHESS_TUNE_H
+#define SCHESS_TUNE_H
+
+#include <schess/types.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * texel tuning: the weights of eval_params and pawn_params are fitted so that a sigmoid
+ * of the static score predicts the results of a set of labelled quiet positions.
+ */
+
+/* a position packed once at load time, so the tuner never parses FENs again */
+struct tune_position
+{
+  bitboard occupancy;
+  uint8_t pieces[16];   // types of the occupied squares from a1 upwards, two per byte
+  uint8_t active;
+  float result;         // white's point of view: 1 win, 0.5 draw, 0 loss
+};
+
+struct tune_dataset
+{
+  struct tune_position *positions;
+  size_t count;
+};
+
+/*
+ * one position per line: a FEN (at least its first four fields) followed by the result,
+ * either as "1-0", "0-1", "1/2-1/2" anywhere in the line (EPD c9 style) or in brackets,
+ * as a number, e.g. [0.5], or as one of those, e.g. [1/2-1/2]. returns 0 on success.
+ */
+int tune_pack(const char *line, struct tune_position *out);
+void tune_unpack(const struct tune_position *position, game_state *game, irreversable_state *meta);
+
+/*
+ * whether the static score of the position can stand for it: the side to move is not in
+ * check and has no capture winning material by SEE, no queen promotion or en passant
+ */
+int tune_is_quiet(const struct tune_position *position);
+
+// lines that do not parse and positions that are not quiet are skipped; returns 0 on success
+int tune_load(const char *path, struct tune_dataset *out);
+void tune_dataset_free(struct tune_dataset *data);
+
+struct tuner;
+
+// starts `threads` - 1 workers, the calling thread is the last one; disables the eval cache
+struct tuner *tuner_create(const struct tune_dataset *data, unsigned threads);
+void tuner_destroy(struct tuner *tuner);
+
+// mean squared error of the dataset under the current weights
+double tuner_error(struct tuner *tuner, double k);
+// sigmoid scaling that fits the current weights best
+double tuner_fit_k(struct tuner *tuner);
+// one pass of local search over every weight; returns the number of weights changed
+size_t tuner_step(struct tuner *tuner, double k, double *error);
+
+void tune_print_params(FILE *out);
+
+#endif // SCHESS_TUNE_H
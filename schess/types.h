@@ -5,6 +5,15 @@
 #include <stdint.h>
 
 #define oo (INT_MAX / 2)
+// a side mating in n plies from the root scores MATE - n; scores beyond MATE_BOUND are mates
+#define MATE (oo - 1)
+#define MATE_BOUND (MATE - 1024)
+
+// used for the per color specializations, where `color` is a compile time constant
+// GCC
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+// picks the `fn_white`/`fn_black` specialization for a compile time constant color
+#define COLORED(fn, us) ((us) == COLOR_WHITE ? fn ## _white : fn ## _black)
 
 enum PIECE_REL { PR_P, PR_N, PR_B, PR_R, PR_Q, PR_K };
 typedef enum
@@ -15,6 +24,8 @@ typedef enum
   PT_COUNT
 } piece_type;
 #define OTHER_COLOR(color) (COLOR_WHITE + COLOR_BLACK - (color))
+// 0 for white, 1 for black; for per color arrays
+#define COLOR_INDEX(color) ((color) == COLOR_BLACK)
 typedef enum
 {
   COLOR_WHITE = PT_WP - PR_P,
@@ -71,16 +82,26 @@ typedef struct
 {
   unsigned halfmove_clock;
   bitboard castling_rights;
+  bitboard en_passant_potential;  // the pawn that just pushed two squares, 0 if none
 } irreversable_state;
 
 
 /* GAME STATE */
+struct nnue_accumulator;
+
 typedef struct
 {
   board_state board;
-  bitboard en_passant_potential;
   color active;
   unsigned fullmove;
+
+  // incremental evaluation terms, maintained by move_make/move_unmake
+  int psqt_mg, psqt_eg; // white relative material + piece-square sums
+  int phase;            // sum of the phase weights of all pieces on the board
+  uint64_t key;         // zobrist key of the pieces and the side to move
+  uint64_t pawn_key;    // zobrist key of the pawns only
+  uint64_t material_key; // piece counts, see material.h
+  struct nnue_accumulator *nnue; // top of the attached accumulator stack, NULL when detached
 } game_state;
 
 
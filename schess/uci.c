@@ -0,0 +1,268 @@
+#include <pthread.h>
+#include <schess/move.h>
+#include <schess/search.h>
+#include <schess/tt.h>
+#include <schess/types.h>
+#include <schess/uci.h>
+#include <schess/utils.h>
+#include <schess/zobrist.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UCI_MAX_HASH_MB 65536
+
+struct uci
+{
+  FILE *out;
+  pthread_mutex_t lock;        // one line at a time from both threads
+  game_state game;
+  irreversable_state meta;
+  // positions before the current one since the last capture or pawn move
+  uint64_t history[SEARCH_MAX_HISTORY];
+  size_t history_length;
+  unsigned multipv;
+};
+
+static void
+uci_send(struct uci *uci, const char *line)
+{
+  pthread_mutex_lock(&uci->lock);
+  fputs(line, uci->out);
+  fputc('\n', uci->out);
+  fflush(uci->out);
+  pthread_mutex_unlock(&uci->lock);
+}
+
+// the word after `name` in `line`, NULL if there is none
+static const char *
+uci_arg(const char *line, const char *name)
+{
+  size_t len = strlen(name);
+  const char *at = line;
+
+  while ((at = strstr(at, name)))
+  {
+    if ((at == line || at[-1] == ' ') && (at[len] == ' ' || at[len] == '\0'))
+      return at[len] ? at + len + 1 : NULL;
+    at += len;
+  }
+  return NULL;
+}
+
+static unsigned long
+uci_number(const char *line, const char *name)
+{
+  const char *arg = uci_arg(line, name);
+  return arg ? strtoul(arg, NULL, 10) : 0;
+}
+
+
+/* SEARCH CALLBACKS */
+// called on the search thread
+static void
+uci_info(const struct search_info *info, void *ctx)
+{
+  char line[256 + MAX_PLY * 6], score[32], *at;
+  const struct search_line *pv;
+  unsigned i, j;
+
+  for (i = 0; i < info->num_lines; ++i)
+  {
+    pv = &info->lines[i];
+
+    // mates are given in moves, negative for the side being mated
+    if (pv->score >= MATE_BOUND) snprintf(score, sizeof(score), "mate %d", (MATE - pv->score + 1) / 2);
+    else if (pv->score <= -MATE_BOUND) snprintf(score, sizeof(score), "mate %d", -(MATE + pv->score) / 2);
+    else snprintf(score, sizeof(score), "cp %d", pv->score);
+
+    at = line + snprintf(line, 256, "info depth %u multipv %u score %s nodes %llu nps %llu hashfull %u time %lu pv",
+                         pv->depth, i + 1, score, (unsigned long long) info->nodes,
+                         (unsigned long long) (info->nodes * 1000 / (info->ms ? info->ms : 1)),
+                         info->hashfull, info->ms);
+    for (j = 0; j < pv->pv_length; ++j)
+    {
+      *at++ = ' ';
+      move_to_UCI(pv->pv[j], at);
+      at += strlen(at);
+    }
+    uci_send(ctx, line);
+  }
+}
+
+static void
+uci_bestmove(const struct search_info *info, void *ctx)
+{
+  char line[32], best[6];
+
+  move_to_UCI(info->best, best);
+  snprintf(line, sizeof(line), "bestmove %s", best);
+  uci_send(ctx, line);
+}
+
+
+/* COMMANDS */
+// position [startpos | fen <FEN>] [moves <move>...]
+static int
+uci_position(struct uci *uci, const char *line)
+{
+  const char *moves = uci_arg(line, "moves"), *fen = uci_arg(line, "fen");
+  uint64_t history[SEARCH_MAX_HISTORY];
+  size_t len, length = 0;
+  game_state game;
+  irreversable_state meta;
+  char FEN[256];
+  move m;
+
+  if (fen)
+  {
+    len = moves ? (size_t) (moves - fen) - strlen("moves ") : strlen(fen);
+    while (len && fen[len - 1] == ' ') --len;
+    if (len >= sizeof(FEN)) return 1;
+    memcpy(FEN, fen, len);
+    FEN[len] = '\0';
+    if (parse_FEN(FEN, &game, &meta)) return 1;
+  }
+  else if (!strncmp(line, "position startpos", 17))
+    parse_FEN(UCI_START_FEN, &game, &meta);
+  else return 1;
+
+  // the position only changes if every move is legal
+  while (moves && *moves)
+  {
+    if (parse_UCI(moves, &game, meta, &m)) return 1;
+
+    if (length == SEARCH_MAX_HISTORY) memmove(history, history + 1, --length * sizeof(*history));
+    history[length++] = zobrist_position_key(&game, meta);
+    move_make(&m, &game, &meta);
+    if (!meta.halfmove_clock) length = 0;
+
+    moves += strcspn(moves, " ");
+    moves += strspn(moves, " ");
+  }
+
+  uci->game = game;
+  uci->meta = meta;
+  memcpy(uci->history, history, length * sizeof(*history));
+  uci->history_length = length;
+  return 0;
+}
+
+// go [depth n] [nodes n] [movetime ms] [wtime ms] [btime ms] [winc ms] [binc ms] [movestogo n] [infinite] [ponder]
+static int
+uci_go(struct uci *uci, const char *line)
+{
+  struct search_limits limits =
+  {
+    .depth = uci_number(line, "depth"),
+    .nodes = uci_number(line, "nodes"),
+    .movetime = uci_number(line, "movetime"),
+    .time = { uci_number(line, "wtime"), uci_number(line, "btime") },
+    .inc = { uci_number(line, "winc"), uci_number(line, "binc") },
+    .movestogo = uci_number(line, "movestogo"),
+    .infinite = strstr(line, "infinite") != NULL,
+    .ponder = strstr(line, "ponder") != NULL,
+    .history = uci->history,
+    .history_length = uci->history_length,
+    .multipv = uci->multipv,
+  };
+
+  return search_start(&uci->game, uci->meta, &limits, uci_info, uci_bestmove, uci);
+}
+
+// setoption name <name> value <value>
+static int
+uci_setoption(struct uci *uci, const char *line)
+{
+  const char *name = uci_arg(line, "name");
+  unsigned long value = uci_number(line, "value");
+
+  if (!name) return 1;
+  if (!strncmp(name, "Hash ", 5))
+    return tt_resize(value < 1 ? 1 : value > UCI_MAX_HASH_MB ? UCI_MAX_HASH_MB : value);
+  if (!strncmp(name, "Threads ", 8))
+  {
+    search_set_threads(value);
+    return 0;
+  }
+  if (!strncmp(name, "SplitPoints ", 12))
+  {
+    const char *on = uci_arg(line, "value");
+    search_set_parallel(on && !strncmp(on, "true", 4) ? SEARCH_YBWC : SEARCH_LAZY_SMP);
+    return 0;
+  }
+  if (!strncmp(name, "MultiPV ", 8))
+  {
+    uci->multipv = value < 1 ? 1 : value > SEARCH_MAX_MULTIPV ? SEARCH_MAX_MULTIPV : value;
+    return 0;
+  }
+  // GUIs send the ponder option whether or not the engine cares
+  return strncmp(name, "Ponder ", 7) != 0;
+}
+
+int
+uci_loop(FILE *in, FILE *out)
+{
+  struct uci uci = { .out = out, .multipv = 1 };
+  char line[8192], reply[512];
+
+  pthread_mutex_init(&uci.lock, NULL);
+  parse_FEN(UCI_START_FEN, &uci.game, &uci.meta);
+
+  while (fgets(line, sizeof(line), in))
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+
+    if (!strcmp(line, "uci"))
+    {
+      snprintf(reply, sizeof(reply),
+               "id name schess\nid author Kilian Chung\n"
+               "option name Hash type spin default %d min 1 max %d\n"
+               "option name Threads type spin default 1 min 1 max %d\n"
+               "option name SplitPoints type check default false\n"
+               "option name MultiPV type spin default 1 min 1 max %d\n"
+               "option name Ponder type check default false\nuciok",
+               TT_DEFAULT_MB, UCI_MAX_HASH_MB, SEARCH_MAX_THREADS, SEARCH_MAX_MULTIPV);
+      uci_send(&uci, reply);
+    }
+    else if (!strcmp(line, "isready")) uci_send(&uci, "readyok");
+    else if (!strcmp(line, "stop"))
+    {
+      // the search still answers with its best move
+      search_stop();
+      search_wait();
+    }
+    else if (!strcmp(line, "ponderhit")) search_ponderhit();
+    else if (!strcmp(line, "quit"))
+    {
+      search_stop();
+      break;
+    }
+    // the other commands change the engine's state, so they wait for a running search
+    else if (!strcmp(line, "ucinewgame"))
+    {
+      search_wait();
+      tt_clear();
+      search_clear();
+    }
+    else if (!strncmp(line, "position ", 9))
+    {
+      search_wait();
+      if (uci_position(&uci, line)) uci_send(&uci, "info string invalid position");
+    }
+    else if (!strncmp(line, "go", 2) && (line[2] == ' ' || !line[2]))
+    {
+      search_wait();
+      if (uci_go(&uci, line)) uci_send(&uci, "info string could not start the search");
+    }
+    else if (!strncmp(line, "setoption ", 10))
+    {
+      search_wait();
+      if (uci_setoption(&uci, line)) uci_send(&uci, "info string unknown option");
+    }
+  }
+
+  // at the end of the input a search still finishes, so scripts get their answer
+  search_wait();
+  pthread_mutex_destroy(&uci.lock);
+  return 0;
+}
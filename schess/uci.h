@@ -0,0 +1,15 @@
+#ifndef SCHESS_UCI_H
+#define SCHESS_UCI_H
+
+#include <stdio.h>
+
+#define UCI_START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+/*
+ * universal chess interface: reads commands from `in` until quit or end of input and
+ * answers on `out`; at the end of the input a running search is finished, not stopped. searches run on their own thread (see search_start), so stop,
+ * ponderhit and isready are answered while one is running. returns 0 on success.
+ */
+int uci_loop(FILE *in, FILE *out);
+
+#endif // SCHESS_UCI_H
@@ -1,7 +1,10 @@
+#include <schess/eval.h>
 #include <schess/gen.h>
+#include <schess/material.h>
 #include <schess/move.h>
 #include <schess/types.h>
 #include <schess/utils.h>
+#include <schess/zobrist.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
@@ -202,11 +205,14 @@ square_from_name(char file, char rank)
   return ((rank - '1') * 8) + (file - 'a');
 }
 static int
-parse_en_passant(const char *en_passant_string, game_state *game_out, const char **string_pos_out)
+parse_en_passant(const char *en_passant_string, const game_state *game, irreversable_state *meta_out,
+                 const char **string_pos_out)
 {
+  square target;
+
   if (en_passant_string[0] == '-')
   {
-    game_out->en_passant_potential = 0;
+    meta_out->en_passant_potential = 0;
     *string_pos_out = &en_passant_string[1];
     return 0;
   }
@@ -214,7 +220,10 @@ parse_en_passant(const char *en_passant_string, game_state *game_out, const char
   if (!is_valid_square_name(en_passant_string[0], en_passant_string[1]))
       return 1;
 
-  game_out->en_passant_potential = sq2bb(square_from_name(en_passant_string[0], en_passant_string[1]));
+  // FEN names the square behind the pawn, the game keeps the double pushed pawn itself
+  if (en_passant_string[1] != (game->active == COLOR_WHITE ? '6' : '3')) return 1;
+  target = square_from_name(en_passant_string[0], en_passant_string[1]);
+  meta_out->en_passant_potential = sq2bb(game->active == COLOR_WHITE ? target - 8 : target + 8);
   *string_pos_out = &en_passant_string[2];
   return 0;
 }
@@ -274,7 +283,7 @@ parse_FEN(const char *FEN, game_state *game_out, irreversable_state *meta_out)
   if (err) return err;
   if (*string_ptr++ != ' ') return 1;
 
-  err = parse_en_passant(string_ptr, &game, &string_ptr);
+  err = parse_en_passant(string_ptr, &game, &meta, &string_ptr);
   if (err) return err;
 
   // optional fields
@@ -293,6 +302,10 @@ parse_FEN(const char *FEN, game_state *game_out, irreversable_state *meta_out)
     if (*string_ptr != '\0') return 1;
   } while (0);
 
+  eval_refresh(&game);
+  zobrist_refresh(&game);
+  material_refresh(&game);
+
   *game_out = game;
   *meta_out = meta;
   return 0;
@@ -697,3 +710,54 @@ parse_SAN_fail_free_mbuf:
   *promotion_out = promotion;
   return 0;
 }
+
+void
+move_to_UCI(move m, char out[6])
+{
+  static const char promotions[] = "nbrq";
+
+  if (m.type == MT_NULL)
+  {
+    strcpy(out, "0000");
+    return;
+  }
+
+  memcpy(out, square_names[m.from], 2);
+  memcpy(out + 2, square_names[m.to], 2);
+  out[4] = m.type >= MT_PROMOTION_KNIGHT ? promotions[m.type - MT_PROMOTION_KNIGHT] : '\0';
+  out[5] = '\0';
+}
+
+int
+parse_UCI(const char *UCI, game_state *game, irreversable_state meta, move *out)
+{
+  struct move_buffer *mbuf;
+  irreversable_state meta_copy;
+  char name[6];
+  size_t i, len = strcspn(UCI, " \t\r\n");
+  int legal, err = 1;
+
+  if (len < 4 || len > 5) return 1;
+
+  mbuf = move_buffer_create(1);
+  if (!mbuf) return 1;
+
+  generate_moves(game, meta, mbuf);
+  for (i = 0; i < mbuf->size && err; ++i)
+  {
+    move_to_UCI(mbuf->moves[i], name);
+    if (strlen(name) != len || strncmp(name, UCI, len)) continue;
+
+    meta_copy = meta;
+    move_make(&mbuf->moves[i], game, &meta_copy);
+    legal = is_board_legal(&game->board, game->active);
+    move_unmake(&mbuf->moves[i], game);
+
+    if (!legal) break;
+    *out = mbuf->moves[i];
+    err = 0;
+  }
+
+  move_buffer_destroy(mbuf);
+  return err;
+}
@@ -19,4 +19,9 @@ void print_move(board_state *board, move m);
 
 int parse_SAN(const char *SAN, game_state *game, irreversable_state meta, square *from_out, square *to_out, piece_type *promotion_out);
 
+// long algebraic notation as UCI uses it, e.g. e7e8q; "0000" for MT_NULL
+void move_to_UCI(move m, char out[6]);
+// the legal move `UCI` names in `game`; returns 0 on success
+int parse_UCI(const char *UCI, game_state *game, irreversable_state meta, move *out);
+
 #endif // SCHESS_UTILS_H
@@ -0,0 +1,74 @@
+#include <schess/zobrist.h>
+
+uint64_t zobrist_pieces[PT_COUNT][NUM_SQUARES];
+uint64_t zobrist_side;
+uint64_t zobrist_castling[16];
+uint64_t zobrist_en_passant[8];
+
+static uint64_t
+zobrist_random(uint64_t *state)
+{
+  // xorshift64*, fixed seed so keys are stable between runs
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1Dull;
+}
+
+// GCC
+__attribute__((constructor)) static void
+zobrist_init(void)
+{
+  uint64_t state = 0x5C4E55ull;
+  piece_type pt;
+  square sq;
+  unsigned i;
+
+  // PT_NONE stays zero, so empty squares hash to nothing
+  for (pt = PT_WP; pt < PT_COUNT; ++pt)
+    for (sq = a1; sq < NUM_SQUARES; ++sq)
+      zobrist_pieces[pt][sq] = zobrist_random(&state);
+
+  zobrist_side = zobrist_random(&state);
+  // no rights hash to nothing
+  for (i = 1; i < 16; ++i) zobrist_castling[i] = zobrist_random(&state);
+  for (i = 0; i < 8; ++i) zobrist_en_passant[i] = zobrist_random(&state);
+}
+
+void
+zobrist_refresh(game_state *game)
+{
+  bitboard pawns, pieces;
+  piece_type pt;
+
+  game->key = game->active == COLOR_BLACK ? zobrist_side : 0;
+  for (pt = PT_WP; pt < PT_COUNT; ++pt)
+    for (pieces = game->board.bitboards[pt]; pieces; pieces &= pieces - 1)
+      // GCC
+      game->key ^= zobrist_pieces[pt][__builtin_ctzll(pieces)];
+
+  game->pawn_key = 0;
+  for (pawns = game->board.bitboards[PT_WP]; pawns; pawns &= pawns - 1)
+    // GCC
+    game->pawn_key ^= zobrist_pieces[PT_WP][__builtin_ctzll(pawns)];
+  for (pawns = game->board.bitboards[PT_BP]; pawns; pawns &= pawns - 1)
+    game->pawn_key ^= zobrist_pieces[PT_BP][__builtin_ctzll(pawns)];
+}
+
+unsigned
+castling_index(bitboard castling_rights)
+{
+  // rights are kept as the king's target squares g1, c1, g8 and c8
+  return (unsigned) (castling_rights >> g1 & 1)      | (unsigned) (castling_rights >> c1 & 1) << 1
+       | (unsigned) (castling_rights >> g8 & 1) << 2 | (unsigned) (castling_rights >> c8 & 1) << 3;
+}
+
+uint64_t
+zobrist_position_key(const game_state *game, irreversable_state meta)
+{
+  uint64_t key = game->key ^ zobrist_castling[castling_index(meta.castling_rights)];
+
+  // GCC
+  if (meta.en_passant_potential) key ^= zobrist_en_passant[__builtin_ctzll(meta.en_passant_potential) & 7];
+  return key;
+}
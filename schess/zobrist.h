@@ -0,0 +1,21 @@
+#ifndef SCHESS_ZOBRIST_H
+#define SCHESS_ZOBRIST_H
+
+#include <schess/types.h>
+#include <stdint.h>
+
+extern uint64_t zobrist_pieces[PT_COUNT][NUM_SQUARES];
+extern uint64_t zobrist_side;           // black to move
+extern uint64_t zobrist_castling[16];   // by castling_index
+extern uint64_t zobrist_en_passant[8];  // by file of the double pushed pawn
+
+// recomputes the hash keys of `game` from scratch
+void zobrist_refresh(game_state *game);
+
+// the four castling rights as bits K, Q, k, q
+unsigned castling_index(bitboard castling_rights);
+
+// game->key extended by the castling rights and en passant file, for positions at node entry
+uint64_t zobrist_position_key(const game_state *game, irreversable_state meta);
+
+#endif // SCHESS_ZOBRIST_H
@@ -0,0 +1,135 @@
+#include <schess/attacks.h>
+#include <schess/eval.h>
+#include <schess/gen.h>
+#include <schess/move.h>
+#include <schess/types.h>
+#include <schess/utils.h>
+#include <stddef.h>
+#include <string.h>
+#include <test/base.h>
+
+// every kernel agrees with the lookups, and the map agrees with the check detection
+static int
+attack_map_rec(game_state *game, irreversable_state meta, unsigned depth, struct move_buffer *mbuf)
+{
+  const enum CPU_LEVEL levels[] = { CPU_SCALAR, CPU_AVX2 };
+  struct attack_map map, reference;
+  irreversable_state meta_copy;
+  size_t i, l, num_moves;
+  bitboard expected;
+  square sq;
+  int err;
+
+  attack_map_select_kernels(CPU_SCALAR);
+  attack_map_compute(&game->board, &reference);
+  for (i = 0; i < reference.num_pieces; ++i)
+  {
+    sq = reference.squares[i];
+    switch ((reference.types[i] - (reference.types[i] >= PT_BP ? COLOR_BLACK : COLOR_WHITE)))
+    {
+    case PR_N: expected = knight_attacks[sq]; break;
+    case PR_B: expected = bishop_attacks(reference.occupancy, sq); break;
+    case PR_R: expected = rook_attacks(reference.occupancy, sq); break;
+    case PR_Q: expected = queen_attacks(reference.occupancy, sq); break;
+    default:   expected = king_attacks[sq]; break;
+    }
+    if (reference.attacks[i] != expected) return 1;
+  }
+  if (attack_map_in_check(&game->board, &reference, COLOR_WHITE) != is_in_check(&game->board, COLOR_WHITE)) return 2;
+  if (attack_map_in_check(&game->board, &reference, COLOR_BLACK) != is_in_check(&game->board, COLOR_BLACK)) return 3;
+
+  for (l = 1; l < sizeof(levels) / sizeof(*levels); ++l)
+  {
+    if (attack_map_select_kernels(levels[l]) != levels[l]) continue;
+    attack_map_compute(&game->board, &map);
+    if (map.num_pieces != reference.num_pieces ||
+        memcmp(map.by_type, reference.by_type, sizeof(map.by_type)) ||
+        memcmp(map.by_color, reference.by_color, sizeof(map.by_color)) ||
+        memcmp(map.twice, reference.twice, sizeof(map.twice)) ||
+        memcmp(map.attacks, reference.attacks, map.num_pieces * sizeof(*map.attacks)))
+      return 4;
+  }
+
+  if (!depth) return 0;
+
+  num_moves = generate_moves(game, meta, &mbuf[depth - 1]);
+  for (i = 0; i < num_moves; ++i)
+  {
+    move *m = mbuf[depth - 1].moves + i;
+    meta_copy = meta;
+    move_make(m, game, &meta_copy);
+    err = is_board_legal(&game->board, game->active) ? attack_map_rec(game, meta_copy, depth - 1, mbuf) : 0;
+    move_unmake(m, game);
+    if (err) return err;
+  }
+  return 0;
+}
+
+TEST(attack_map)
+{
+  const char *FENs[] =
+  {
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "Q6Q/1QQ1QQ2/8/8/4k3/8/2qq1qq1/K6q w - - 0 1",
+  };
+  const unsigned depth = 2;
+  struct move_buffer *mbuf = move_buffer_create(depth);
+  game_state game;
+  irreversable_state meta;
+  size_t i;
+  int err = 0;
+
+  move_gen_init_LUTs();
+
+  for (i = 0; i < sizeof(FENs) / sizeof(*FENs) && !err; ++i)
+  {
+    parse_FEN(FENs[i], &game, &meta);
+    err = attack_map_rec(&game, meta, depth, mbuf);
+  }
+
+  attack_map_select_kernels(CPU_SCALAR);
+  move_buffer_destroy(mbuf);
+  return err;
+}
+
+TEST(see)
+{
+  const struct
+  {
+    const char *FEN;
+    square from, to;
+    int expected;
+  } cases[] =
+  {
+    // undefended pawn
+    { "1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1",           e1, e5, 82 },
+    // knight for a pawn, the x-rayed rook and queen arrive too late
+    { "1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1",  d3, e5, 82 - 337 },
+    // pawn takes a defended knight
+    { "4k3/8/3p4/4n3/3P4/8/8/4K3 w - - 0 1",                       d4, e5, 337 - 82 },
+    // the king cannot recapture on a square still covered
+    { "4k3/8/8/3r4/8/8/3R4/3RK3 w - - 0 1",                        d2, d5, 477 },
+    // a quiet move onto an attacked square loses the piece
+    { "4k3/8/2p5/8/2N5/8/8/4K3 w - - 0 1",                         c4, d5, -337 },
+    // the rook behind the capturer only defends the knight once the capturer moved
+    { "4k3/n7/8/8/8/8/R7/r3K3 w - - 0 1",                          a2, a7, 337 - 477 },
+  };
+  struct attack_map map;
+  game_state game;
+  irreversable_state meta;
+  size_t i;
+
+  move_gen_init_LUTs();
+
+  for (i = 0; i < sizeof(cases) / sizeof(*cases); ++i)
+  {
+    parse_FEN(cases[i].FEN, &game, &meta);
+    attack_map_compute(&game.board, &map);
+    if (see(&game.board, &map, cases[i].from, cases[i].to) != cases[i].expected) return 1 + 2 * i;
+    if (see(&game.board, NULL, cases[i].from, cases[i].to) != cases[i].expected) return 2 + 2 * i;
+  }
+
+  return 0;
+}
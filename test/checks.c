@@ -0,0 +1,122 @@
+#include <schess/gen.h>
+#include <schess/move.h>
+#include <schess/types.h>
+#include <schess/utils.h>
+#include <stddef.h>
+#include <test/base.h>
+
+static int
+move_eq(move a, move b)
+{
+  return a.from == b.from && a.to == b.to && a.type == b.type;
+}
+
+static int
+move_buffer_contains(struct move_buffer *mbuf, move m)
+{
+  size_t i;
+
+  for (i = 0; i < mbuf->size; ++i)
+    if (move_eq(mbuf->moves[i], m)) return 1;
+  return 0;
+}
+
+static size_t
+count_legal(game_state *game, irreversable_state meta, struct move_buffer *mbuf)
+{
+  irreversable_state meta_copy;
+  size_t i, legal = 0;
+
+  for (i = 0; i < mbuf->size; ++i)
+  {
+    meta_copy = meta;
+    move_make(mbuf->moves + i, game, &meta_copy);
+    legal += is_board_legal(&game->board, game->active);
+    move_unmake(mbuf->moves + i, game);
+  }
+
+  return legal;
+}
+
+// compares gives_check and the check generators against making every legal move
+static int
+checks_rec(game_state *game, irreversable_state meta, unsigned depth, struct move_buffer *mbuf)
+{
+  struct move_buffer *all = &mbuf[3 * depth], *checks = all + 1, *quiet = all + 2;
+  struct check_info ci;
+  irreversable_state meta_copy;
+  size_t i, num_checks = 0, num_quiet = 0;
+  color us = game->active;
+  int legal, checking, quiet_move, err;
+
+  generate_moves(game, meta, all);
+  generate_checks(game, meta, checks);
+  generate_quiet_checks(game, meta, quiet);
+  check_info_init(game, &ci);
+
+  for (i = 0; i < all->size; ++i)
+  {
+    move *m = all->moves + i;
+    quiet_move = m->capture == PT_NONE && m->type != MT_EN_PASSANT &&
+      (m->type < MT_PROMOTION_KNIGHT || m->type > MT_PROMOTION_QUEEN);
+
+    meta_copy = meta;
+    move_make(m, game, &meta_copy);
+    legal = is_board_legal(&game->board, game->active);
+    checking = is_in_check(&game->board, OTHER_COLOR(us));
+    move_unmake(m, game);
+    if (!legal) continue;
+
+    if (checking != gives_check(game, &ci, m)) return 1;
+    if (checking != move_buffer_contains(checks, *m)) return 2;
+    if ((checking && quiet_move) != move_buffer_contains(quiet, *m)) return 3;
+    num_checks += checking;
+    num_quiet += checking && quiet_move;
+  }
+  if (num_checks != count_legal(game, meta, checks) || num_quiet != count_legal(game, meta, quiet)) return 4;
+  if (!depth) return 0;
+
+  for (i = 0; i < all->size; ++i)
+  {
+    move *m = all->moves + i;
+    meta_copy = meta;
+    move_make(m, game, &meta_copy);
+    err = is_board_legal(&game->board, game->active) ? checks_rec(game, meta_copy, depth - 1, mbuf) : 0;
+    move_unmake(m, game);
+    if (err) return err;
+  }
+
+  return 0;
+}
+
+TEST(gives_check)
+{
+  const char *FENs[] =
+  {
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "1k6/8/8/2KPp2r/8/8/8/8 w - e6 0 1",
+    "4k3/8/8/8/8/8/8/R3K2R w KQ - 0 1",
+    "7k/8/8/8/3N4/2P5/1B6/K7 w - - 0 1",
+    "k7/4P3/8/8/8/8/8/K3R3 w - - 0 1",
+  };
+  const unsigned depth = 2;
+  struct move_buffer *mbuf = move_buffer_create(3 * (depth + 1));
+  game_state game;
+  irreversable_state meta;
+  size_t i;
+  int err = 0;
+
+  move_gen_init_LUTs();
+
+  for (i = 0; i < sizeof(FENs) / sizeof(*FENs) && !err; ++i)
+  {
+    parse_FEN(FENs[i], &game, &meta);
+    err = checks_rec(&game, meta, depth, mbuf);
+  }
+
+  move_buffer_destroy(mbuf);
+  return err;
+}
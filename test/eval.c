@@ -0,0 +1,294 @@
+#include <schess/eval.h>
+#include <schess/evalcache.h>
+#include <schess/gen.h>
+#include <schess/material.h>
+#include <schess/move.h>
+#include <schess/types.h>
+#include <schess/zobrist.h>
+#include <schess/utils.h>
+#include <stddef.h>
+#include <test/base.h>
+
+static int
+incremental_eq(game_state *game)
+{
+  game_state fresh = *game;
+
+  eval_refresh(&fresh);
+  zobrist_refresh(&fresh);
+  material_refresh(&fresh);
+  return fresh.psqt_mg  == game->psqt_mg &&
+         fresh.psqt_eg  == game->psqt_eg &&
+         fresh.phase    == game->phase &&
+         fresh.key      == game->key &&
+         fresh.material_key == game->material_key &&
+         fresh.pawn_key == game->pawn_key;
+}
+
+// incremental terms must match a from scratch computation after every make and unmake
+static int
+incremental_rec(game_state *game, irreversable_state meta, unsigned depth, struct move_buffer *mbuf)
+{
+  size_t i, num_moves;
+  irreversable_state meta_copy;
+  int err;
+
+  if (!incremental_eq(game)) return 1;
+  if (!depth) return 0;
+
+  num_moves = generate_moves(game, meta, &mbuf[depth - 1]);
+  for (i = 0; i < num_moves; ++i)
+  {
+    move *m = mbuf[depth - 1].moves + i;
+    meta_copy = meta;
+    move_make(m, game, &meta_copy);
+    err = is_board_legal(&game->board, game->active) ? incremental_rec(game, meta_copy, depth - 1, mbuf) : 0;
+    move_unmake(m, game);
+    if (err) return err;
+    if (!incremental_eq(game)) return 2;
+  }
+
+  return 0;
+}
+
+TEST(incremental_psqt)
+{
+  const char *FENs[] =
+  {
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+  };
+  const unsigned depth = 3;
+  struct move_buffer *mbuf = move_buffer_create(depth);
+  game_state game;
+  irreversable_state meta;
+  size_t i;
+  int err = 0;
+
+  move_gen_init_LUTs();
+
+  for (i = 0; i < sizeof(FENs) / sizeof(*FENs) && !err; ++i)
+  {
+    parse_FEN(FENs[i], &game, &meta);
+    err = incremental_rec(&game, meta, depth, mbuf);
+  }
+
+  move_buffer_destroy(mbuf);
+  return err;
+}
+
+TEST(eval_symmetry)
+{
+  game_state white, black;
+  irreversable_state meta;
+
+  // mirrored positions evaluate the same for the side to move
+  parse_FEN("r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4", &white, &meta);
+  parse_FEN("rnbqk2r/pppp1ppp/5n2/2b1p3/4P3/2N2N2/PPPP1PPP/R1BQKB1R b KQkq - 4 4", &black, &meta);
+  if (eval_position(&white, meta) != eval_position(&black, meta)) return 1;
+
+  parse_FEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", &white, &meta);
+  if (eval_position(&white, meta) != 0) return 2;
+  if (white.phase != EVAL_PHASE_MAX) return 3;
+
+  return 0;
+}
+
+TEST(eval_cache)
+{
+  game_state game;
+  irreversable_state meta;
+  struct eval_cache_stats stats;
+  int score, cached;
+
+  parse_FEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", &game, &meta);
+
+  eval_cache_resize(0);
+  score = eval_position(&game, meta);
+  if (eval_cache_probe(game.key, &cached)) return 1;
+
+  eval_cache_resize(1);
+  eval_cache_stats_reset();
+  if (eval_position(&game, meta) != score) return 2;
+  if (eval_position(&game, meta) != score) return 3;
+  stats = eval_cache_stats();
+  if (stats.probes != 2 || stats.hits != 1) return 4;
+
+  // the side to move is part of the key
+  game.active = COLOR_BLACK;
+  game.key   ^= zobrist_side;
+  if (eval_cache_probe(game.key, &cached)) return 5;
+
+  eval_cache_resize(EVAL_CACHE_DEFAULT_MB);
+  return 0;
+}
+
+TEST(eval_lazy)
+{
+  static const char *FENs[] =
+  {
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r5k1/2q2p1p/4pQpN/3pP3/3P2R1/2PB4/5PPP/6K1 b - - 0 1",
+    "1k6/1PPPPPP1/8/8/8/8/8/4K3 w - - 0 1",
+  };
+  game_state game;
+  irreversable_state meta;
+  struct eval_stats stats;
+  int full, lazy;
+  size_t i;
+
+  parse_FEN("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", &game, &meta);
+  eval_cache_resize(0);
+  eval_stats_reset();
+
+  // a window far above the material score exits after the first stage
+  full = eval_position(&game, meta);
+  lazy = eval_position_window(&game, meta, 5000, 5001);
+  stats = eval_stats();
+  if (stats.evaluations != 2 || stats.lazy_exits != 1) return 1;
+  if (lazy + EVAL_LAZY_MARGIN > 5000) return 2;
+
+  // a window around the score is evaluated in full
+  if (eval_position_window(&game, meta, full - 1, full + 1) != full) return 3;
+  if (eval_stats().lazy_exits != 1) return 4;
+
+  // the margin bounds the later stages, even around a king under attack or for a row of
+  // passed pawns
+  for (i = 0; i < sizeof(FENs) / sizeof(*FENs); ++i)
+  {
+    parse_FEN(FENs[i], &game, &meta);
+    full = eval_position(&game, meta);
+    lazy = eval_position_window(&game, meta, 5000, 5001);
+    if (full > lazy + EVAL_LAZY_MARGIN || full < lazy - EVAL_LAZY_MARGIN) return 5 + i;
+  }
+
+  eval_cache_resize(EVAL_CACHE_DEFAULT_MB);
+  return 0;
+}
+
+TEST(material_table)
+{
+  const struct
+  {
+    const char *FEN;
+    unsigned flags;
+  } cases[] =
+  {
+    { "8/8/4k3/8/8/3K4/8/8 w - - 0 1",    MF_DRAW },
+    { "8/8/4k3/8/8/3KN3/8/8 w - - 0 1",   MF_DRAW },
+    { "8/8/4kb2/8/8/3K4/8/8 b - - 0 1",   MF_DRAW },
+    { "8/8/4k3/8/8/3KR3/8/8 w - - 0 1",   MF_KXK },
+    { "8/8/4kq2/8/8/3K4/8/8 w - - 0 1",   MF_KXK },
+    { "8/8/4k3/8/8/3KP3/8/8 w - - 0 1",   MF_KPK },
+    { "8/8/4kn2/8/8/3KN3/8/8 w - - 0 1",  0 },
+    { "8/8/4k3/8/8/3KNN2/8/8 w - - 0 1",  0 },
+  };
+  game_state game;
+  irreversable_state meta;
+  const struct material_entry *e;
+  size_t i;
+
+  for (i = 0; i < sizeof(cases) / sizeof(*cases); ++i)
+  {
+    parse_FEN(cases[i].FEN, &game, &meta);
+    if (material_probe(game.material_key)->flags != cases[i].flags) return 1 + i;
+  }
+
+  // two knights cannot force mate
+  parse_FEN("8/8/4k3/8/8/3KNN2/8/8 w - - 0 1", &game, &meta);
+  if (material_probe(game.material_key)->scale[0] != 0) return 20;
+
+  parse_FEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", &game, &meta);
+  e = material_probe(game.material_key);
+  if (e->imbalance != 0 || e->phase != EVAL_PHASE_MAX || material_count(game.material_key, PT_BP) != 8) return 21;
+
+  // three queens are outside the precomputed range
+  parse_FEN("4k3/8/8/8/8/8/8/QQQ1K3 w - - 0 1", &game, &meta);
+  e = material_probe(game.material_key);
+  if (material_count(game.material_key, PT_WQ) != 3 || e->phase != 12 || !(e->flags & MF_KXK)) return 22;
+
+  return 0;
+}
+
+TEST(kpk_bitbase)
+{
+  const struct
+  {
+    const char *FEN;
+    int win;
+  } cases[] =
+  {
+    { "4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", 1 },
+    { "4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", 1 },
+    { "4k3/4P3/4K3/8/8/8/8/8 b - - 0 1", 0 }, // stalemate
+    { "4k3/8/8/8/8/8/4P3/4K3 w - - 0 1", 1 }, // spare tempo
+    { "8/8/8/4k3/4P3/8/8/4K3 b - - 0 1", 0 }, // the pawn falls
+    { "k7/8/8/8/8/8/P7/K7 w - - 0 1",    0 }, // rook pawn
+    { "8/8/8/8/3p4/3k4/8/3K4 w - - 0 1", 1 }, // first case for black
+    { "4k3/8/8/4p3/4K3/8/8/8 w - - 0 1", 0 },
+  };
+  game_state game;
+  irreversable_state meta;
+  size_t i;
+
+  move_gen_init_LUTs();
+
+  for (i = 0; i < sizeof(cases) / sizeof(*cases); ++i)
+  {
+    parse_FEN(cases[i].FEN, &game, &meta);
+    if (!(material_probe(game.material_key)->flags & MF_KPK)) return 1 + 2 * i;
+    if ((eval_position(&game, meta) != 0) != cases[i].win) return 2 + 2 * i;
+  }
+
+  return 0;
+}
+
+TEST(eval_batch)
+{
+  const char *FENs[] =
+  {
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "8/8/4k3/8/8/3KR3/8/8 b - - 0 1",
+    "4k3/8/4K3/4P3/8/8/8/8 b - - 0 1",
+  };
+  const enum CPU_LEVEL levels[] = { CPU_SCALAR, CPU_AVX2 };
+  struct move_buffer *mbuf = move_buffer_create(1);
+  game_state games[256], game;
+  irreversable_state meta, meta_copy;
+  int scores[256];
+  size_t i, j, num_moves, count = 0;
+  int err = 0;
+
+  move_gen_init_LUTs();
+
+  // the roots and their children, an odd number so the vector loop has a tail
+  for (i = 0; i < sizeof(FENs) / sizeof(*FENs); ++i)
+  {
+    parse_FEN(FENs[i], &game, &meta);
+    games[count++] = game;
+    num_moves = generate_moves(&game, meta, mbuf);
+    for (j = 0; j < num_moves && count < 255; ++j)
+    {
+      meta_copy = meta;
+      move_make(mbuf->moves + j, &game, &meta_copy);
+      if (is_board_legal(&game.board, game.active)) games[count++] = game;
+      move_unmake(mbuf->moves + j, &game);
+    }
+  }
+  count -= !(count & 1);
+
+  for (i = 0; i < sizeof(levels) / sizeof(*levels) && !err; ++i)
+  {
+    if (eval_batch_select_kernels(levels[i]) != levels[i]) continue;
+    eval_batch(games, count, scores);
+    for (j = 0; j < count && !err; ++j)
+      if (scores[j] != eval_position(&games[j], meta)) err = 1 + i;
+  }
+
+  eval_batch_select_kernels(cpu_detect());
+  move_buffer_destroy(mbuf);
+  return err;
+}
@@ -0,0 +1,93 @@
+#include <schess/cpu.h>
+#include <schess/gen.h>
+#include <schess/move.h>
+#include <schess/nnue.h>
+#include <schess/types.h>
+#include <schess/utils.h>
+#include <stddef.h>
+#include <test/base.h>
+
+static const char *nnue_FENs[] =
+{
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+// the incrementally updated accumulators must match a refresh at every node
+static int
+nnue_rec(game_state *game, irreversable_state meta, unsigned depth, struct move_buffer *mbuf)
+{
+  size_t i, num_moves;
+  irreversable_state meta_copy;
+  int err;
+
+  if (nnue_evaluate(game) != nnue_evaluate_fresh(game)) return 1;
+  if (!depth) return 0;
+
+  num_moves = generate_moves(game, meta, &mbuf[depth - 1]);
+  for (i = 0; i < num_moves; ++i)
+  {
+    move *m = mbuf[depth - 1].moves + i;
+    meta_copy = meta;
+    move_make(m, game, &meta_copy);
+    err = is_board_legal(&game->board, game->active) ? nnue_rec(game, meta_copy, depth - 1, mbuf) : 0;
+    move_unmake(m, game);
+    if (err) return err;
+  }
+
+  return 0;
+}
+
+TEST(nnue_incremental)
+{
+  const unsigned depth = 3;
+  struct move_buffer *mbuf = move_buffer_create(depth);
+  game_state game;
+  irreversable_state meta;
+  size_t i;
+  int err = 0;
+
+  move_gen_init_LUTs();
+  nnue_init_random(0x5C4E55);
+
+  for (i = 0; i < sizeof(nnue_FENs) / sizeof(*nnue_FENs) && !err; ++i)
+  {
+    parse_FEN(nnue_FENs[i], &game, &meta);
+    nnue_attach(&game);
+    err = nnue_rec(&game, meta, depth, mbuf);
+    nnue_detach(&game);
+  }
+
+  move_buffer_destroy(mbuf);
+  nnue_unload();
+  return err;
+}
+
+TEST(nnue_kernels)
+{
+  game_state game;
+  irreversable_state meta;
+  enum CPU_LEVEL level, best = cpu_detect();
+  int expected[sizeof(nnue_FENs) / sizeof(*nnue_FENs)];
+  size_t i;
+  int err = 0;
+
+  nnue_init_random(0x5C4E55);
+
+  // every kernel level computes exactly what the scalar one does
+  for (level = CPU_SCALAR; level <= best && level <= CPU_AVX2 && !err; ++level)
+  {
+    nnue_select_kernels(level);
+    for (i = 0; i < sizeof(nnue_FENs) / sizeof(*nnue_FENs); ++i)
+    {
+      parse_FEN(nnue_FENs[i], &game, &meta);
+      if (level == CPU_SCALAR) expected[i] = nnue_evaluate_fresh(&game);
+      else if (nnue_evaluate_fresh(&game) != expected[i]) err = 1;
+    }
+  }
+
+  nnue_select_kernels(best);
+  nnue_unload();
+  return err;
+}
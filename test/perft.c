@@ -307,3 +307,57 @@ TEST(position6_perft)
   return 0;
 }
 
+
+
+static int
+move_set_rec(game_state *game, irreversable_state meta, unsigned depth, struct move_buffer *mbuf)
+{
+  size_t num_moves, i, counted, iterated;
+  irreversable_state meta_copy;
+  struct move_set set;
+  move m;
+  int err;
+
+  generate_move_set(game, meta, &set);
+  counted = move_set_count(&set);
+  for (iterated = 0; move_set_next(&set, game->board.types, &m); ++iterated);
+
+  num_moves = generate_moves(game, meta, &mbuf[depth]);
+  if (counted != num_moves) return 1;
+  if (iterated != num_moves) return 2;
+  if (!depth) return 0;
+
+  for (i = 0; i < num_moves; ++i)
+  {
+    meta_copy = meta;
+    move *mp = mbuf[depth].moves + i;
+    move_make(mp, game, &meta_copy);
+    err = is_board_legal(&game->board, game->active) ? move_set_rec(game, meta_copy, depth - 1, mbuf) : 0;
+    move_unmake(mp, game);
+    if (err) return err;
+  }
+
+  return 0;
+}
+
+TEST(move_set_count)
+{
+  game_state game;
+  irreversable_state meta;
+  const unsigned depth = 3;
+  struct move_buffer *mbuf = move_buffer_create(depth + 1);
+  int err;
+
+  move_gen_init_LUTs();
+
+  parse_FEN("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", &game, &meta);
+  err = move_set_rec(&game, meta, depth, mbuf);
+  if (!err)
+  {
+    parse_FEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", &game, &meta);
+    err = move_set_rec(&game, meta, depth, mbuf);
+  }
+
+  move_buffer_destroy(mbuf);
+  return err;
+}
@@ -0,0 +1,372 @@
+#include <schess/gen.h>
+#include <schess/material.h>
+#include <schess/move.h>
+#include <schess/search.h>
+#include <schess/tt.h>
+#include <schess/types.h>
+#include <schess/utils.h>
+#include <stddef.h>
+#include <string.h>
+#include <test/base.h>
+
+TEST(search_limits)
+{
+  struct search_limits limits = { .nodes = 20000 };
+  struct search_info info;
+  game_state game;
+  irreversable_state meta;
+  move m;
+  char name[6];
+
+  move_gen_init_LUTs();
+  parse_FEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", &game, &meta);
+
+  // the limit is looked at every few thousand nodes
+  info = search(&game, meta, &limits, NULL, NULL);
+  if (info.nodes < limits.nodes || info.nodes > limits.nodes + 4096) return 1;
+  move_to_UCI(info.best, name);
+  if (parse_UCI(name, &game, meta, &m)) return 2;
+
+  limits = (struct search_limits) { .depth = 4 };
+  info = search(&game, meta, &limits, NULL, NULL);
+  if (info.depth != 4) return 3;
+
+  // a checkmated side has no move to name
+  parse_FEN("R5k1/5ppp/8/8/8/8/8/6K1 b - -", &game, &meta);
+  if (search(&game, meta, &limits, NULL, NULL).best.type != MT_NULL) return 4;
+  return 0;
+}
+
+TEST(search_draws)
+{
+  static const struct
+  {
+    const char *FEN;
+    int insufficient;
+  } material_cases[] =
+  {
+    { "8/8/4k3/8/8/3K4/8/8 w - -", 1 },
+    { "8/8/4k3/8/8/3K4/5N2/8 w - -", 1 },
+    { "8/8/4k3/8/2b5/3K4/4B3/8 w - -", 1 },  // bishops on one colour
+    { "8/8/4k3/8/3b4/3K4/4B3/8 w - -", 0 },
+    { "8/8/4k3/8/8/3K4/4NN2/8 w - -", 0 },
+    { "8/8/4k3/8/8/3K4/4P3/8 w - -", 0 },
+  };
+  struct search_limits limits = { .depth = 6 };
+  struct search_info info;
+  game_state game;
+  irreversable_state meta;
+  char name[6];
+  size_t i;
+
+  move_gen_init_LUTs();
+  for (i = 0; i < sizeof(material_cases) / sizeof(*material_cases); ++i)
+  {
+    parse_FEN(material_cases[i].FEN, &game, &meta);
+    if (material_insufficient(&game) != material_cases[i].insufficient) return 1 + i;
+  }
+
+  // a rook down, black checks forever: Qe1+ Kh2 Qh4+ Kg1 Qe1+ repeats within the tree
+  parse_FEN("6k1/QR3ppp/8/8/7q/8/6P1/6K1 b - - 0 1", &game, &meta);
+  info = search(&game, meta, &limits, NULL, NULL);
+  move_to_UCI(info.best, name);
+  if (info.score != 0 || strcmp(name, "h4e1")) return 10;
+
+  // every move of the queen ends the game on the fifty move rule
+  parse_FEN("7k/8/8/8/8/8/8/KQ6 w - - 99 80", &game, &meta);
+  if (search(&game, meta, &limits, NULL, NULL).score != 0) return 11;
+  parse_FEN("7k/8/8/8/8/8/8/KQ6 w - - 90 80", &game, &meta);
+  if (search(&game, meta, &limits, NULL, NULL).score <= 0) return 12;
+
+  // unless the move that reaches the limit mates
+  parse_FEN("k7/8/1K6/8/8/8/8/7R w - - 99 80", &game, &meta);
+  info = search(&game, meta, &limits, NULL, NULL);
+  move_to_UCI(info.best, name);
+  if (info.score != MATE - 1 || strcmp(name, "h1h8")) return 13;
+  return 0;
+}
+
+TEST(search_mates)
+{
+  struct search_limits limits = { .depth = 12 };
+  struct search_info info;
+  game_state game;
+  irreversable_state meta;
+  char name[6];
+
+  move_gen_init_LUTs();
+
+  // Ra6 bxa6 b7#, and the search stops once the mate cannot get any shorter
+  parse_FEN("kbK5/pp6/1P6/8/8/8/8/R7 w - - 0 1", &game, &meta);
+  info = search(&game, meta, &limits, NULL, NULL);
+  move_to_UCI(info.best, name);
+  if (info.score != MATE - 3 || strcmp(name, "a1a6")) return 1;
+  if (info.depth != 4) return 2;
+
+  // the defender is mated two plies later whatever it plays
+  parse_FEN("kbK5/pp6/RP6/8/8/8/8/8 b - - 0 1", &game, &meta);
+  if (search(&game, meta, &limits, NULL, NULL).score != -MATE + 2) return 3;
+
+  // Kg6 and Kh6 stalemate, the queen mates in three
+  parse_FEN("7k/5Q2/8/6K1/8/8/8/8 w - - 0 1", &game, &meta);
+  limits.depth = 2;
+  info = search(&game, meta, &limits, NULL, NULL);
+  move_to_UCI(info.best, name);
+  if (info.score <= 0 || !strcmp(name, "g5g6") || !strcmp(name, "g5h6")) return 4;
+  limits.depth = 12;
+  if (search(&game, meta, &limits, NULL, NULL).score != MATE - 5) return 5;
+
+  // a stalemated side has no move and nothing to lose
+  parse_FEN("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1", &game, &meta);
+  info = search(&game, meta, &limits, NULL, NULL);
+  if (info.best.type != MT_NULL || info.score != 0) return 6;
+  return 0;
+}
+
+TEST(search_multipv)
+{
+  struct search_line lines[SEARCH_MAX_MULTIPV];
+  game_state game;
+  irreversable_state meta;
+  char name[6];
+  size_t i, j, n;
+
+  move_gen_init_LUTs();
+
+  // distinct moves, best first, the mate on top
+  parse_FEN("kbK5/pp6/1P6/8/8/8/8/R7 w - - 0 1", &game, &meta);
+  n = search_best_moves(&game, meta, 4, lines, 4);
+  if (n != 4) return 1;
+  move_to_UCI(lines[0].best, name);
+  if (strcmp(name, "a1a6") || lines[0].score != MATE - 3) return 2;
+  for (i = 0; i < n; ++i)
+  {
+    if (lines[i].depth != 4 || !lines[i].nodes) return 3;
+    if (i && lines[i].score > lines[i - 1].score) return 4;
+    for (j = 0; j < i; ++j)
+      if (lines[i].best.from == lines[j].best.from && lines[i].best.to == lines[j].best.to) return 5;
+  }
+
+  // no more lines than legal moves: the checked king has two squares
+  parse_FEN("7k/8/8/8/8/8/8/K6Q b - - 0 1", &game, &meta);
+  if (search_best_moves(&game, meta, 3, lines, 8) != 2) return 6;
+  parse_FEN("R5k1/5ppp/8/8/8/8/8/6K1 b - -", &game, &meta);
+  if (search_best_moves(&game, meta, 3, lines, 8) != 0) return 7;
+  return 0;
+}
+
+// the line is a legal sequence of moves from the position; leaves its end in `game`
+static int
+pv_is_legal(const struct search_line *line, const char *FEN, game_state *game, irreversable_state *meta)
+{
+  char name[6];
+  unsigned i;
+  move m;
+
+  parse_FEN(FEN, game, meta);
+  for (i = 0; i < line->pv_length; ++i)
+  {
+    move_to_UCI(line->pv[i], name);
+    if (parse_UCI(name, game, *meta, &m)) return 0;
+    move_make(&m, game, meta);
+  }
+  return 1;
+}
+
+TEST(search_pv)
+{
+  static const char *mate = "kbK5/pp6/1P6/8/8/8/8/R7 w - - 0 1",
+                    *middlegame = "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10";
+  static struct search_line lines[2];
+  game_state game;
+  irreversable_state meta;
+  size_t i;
+
+  move_gen_init_LUTs();
+
+  // the whole mate, down to the move that gives it
+  parse_FEN(mate, &game, &meta);
+  if (search_best_moves(&game, meta, 5, lines, 1) != 1) return 1;
+  if (lines[0].pv_length != 3 || !pv_is_legal(&lines[0], mate, &game, &meta)) return 2;
+  if (search_best_moves(&game, meta, 1, lines + 1, 1) != 0 || !is_in_check(&game.board, game.active)) return 3;
+
+  // every line starts with its move and stays within the extension budget
+  parse_FEN(middlegame, &game, &meta);
+  if (search_best_moves(&game, meta, 5, lines, 2) != 2) return 4;
+  for (i = 0; i < 2; ++i)
+  {
+    if (!lines[i].pv_length || lines[i].pv_length > 2 * 5) return 5 + 3 * i;
+    if (lines[i].pv[0].from != lines[i].best.from || lines[i].pv[0].to != lines[i].best.to) return 6 + 3 * i;
+    if (!pv_is_legal(&lines[i], middlegame, &game, &meta)) return 7 + 3 * i;
+  }
+  return 0;
+}
+
+TEST(search_extensions)
+{
+  struct search_limits limits = { .depth = 2 };
+  struct search_info info;
+  game_state game;
+  irreversable_state meta;
+  char name[6];
+
+  move_gen_init_LUTs();
+
+  // WAC 4: Qxh7+ Kxh7 hxg6#, the mate lies past the horizon of the recapture
+  parse_FEN("r1bq2rk/pp3pbp/2p1p1pQ/7P/3P4/2PB1N2/PP3PPR/2KR4 w - - 0 1", &game, &meta);
+  info = search(&game, meta, &limits, NULL, NULL);
+  move_to_UCI(info.best, name);
+  if (strcmp(name, "h6h7") || info.score != MATE - 3) return 1;
+  if (info.lines[0].pv_length != 3) return 2;
+  return 0;
+}
+
+TEST(search_pruning)
+{
+  const struct search_pruning defaults = search_pruning;
+  struct search_limits limits = { .depth = 5 };
+  struct search_stats stats;
+  struct search_info info;
+  uint64_t pruned_nodes, full_nodes;
+  game_state game;
+  irreversable_state meta;
+  char name[6];
+
+  move_gen_init_LUTs();
+  parse_FEN("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", &game, &meta);
+
+  // both searches start from an empty table
+  tt_clear();
+  search_clear();
+  search_stats_reset();
+  pruned_nodes = search(&game, meta, &limits, NULL, NULL).nodes;
+  stats = search_stats();
+  if (!stats.reverse_futility || !stats.futility) return 1;
+
+  search_pruning.reverse_futility_depth = search_pruning.futility_depth = 0;
+  search_pruning.razoring_depth = search_pruning.probcut_depth = 0;
+  tt_clear();
+  search_clear();
+  search_stats_reset();
+  full_nodes = search(&game, meta, &limits, NULL, NULL).nodes;
+  stats = search_stats();
+  search_pruning = defaults;
+  if (stats.reverse_futility || stats.futility || stats.razoring || stats.probcut) return 2;
+  if (pruned_nodes >= full_nodes) return 3;
+
+  // mates are left alone
+  parse_FEN("r1bq2rk/pp3pbp/2p1p1pQ/7P/3P4/2PB1N2/PP3PPR/2KR4 w - - 0 1", &game, &meta);
+  info = search(&game, meta, &limits, NULL, NULL);
+  move_to_UCI(info.best, name);
+  if (strcmp(name, "h6h7") || info.score != MATE - 3) return 4;
+  return 0;
+}
+
+TEST(search_en_passant)
+{
+  struct search_limits limits = { .depth = 2 };
+  struct move_buffer *moves;
+  struct search_info info;
+  game_state game;
+  irreversable_state meta;
+  char name[6];
+  size_t n;
+
+  move_gen_init_LUTs();
+  moves = move_buffer_create(1);
+  if (!moves) return 1;
+
+  // razoring runs the capture search at a node before generating its moves, which must
+  // still include exd6 afterwards
+  parse_FEN("4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", &game, &meta);
+  n = generate_moves(&game, meta, moves);
+  quiesce(&game, meta, -oo, +oo);
+  if (generate_moves(&game, meta, moves) != n || n != 7)
+  {
+    move_buffer_destroy(moves);
+    return 2;
+  }
+  move_buffer_destroy(moves);
+
+  // within razoring depth exd6 forks the rook and the knight
+  parse_FEN("4k3/2r1n3/8/3pP3/8/8/5PPP/4R1K1 w - d6 0 1", &game, &meta);
+  info = search(&game, meta, &limits, NULL, NULL);
+  move_to_UCI(info.best, name);
+  if (strcmp(name, "e5d6") || info.score < 200) return 3;
+
+  // so d5 is not played into it, the capture comes a ply into the search
+  parse_FEN("4k3/2rpn3/8/4P3/8/8/5PPP/4R1K1 b - - 0 1", &game, &meta);
+  limits.depth = 3;
+  info = search(&game, meta, &limits, NULL, NULL);
+  move_to_UCI(info.best, name);
+  if (!strcmp(name, "d7d5")) return 4;
+
+  // deep enough that nodes without a hashed move are first searched shallower (SEARCH_IID)
+  // or reduced, the capture must survive either
+  tt_clear();
+  search_clear();
+  parse_FEN("4k3/2r1n3/8/3pP3/8/8/5PPP/4R1K1 w - d6 0 1", &game, &meta);
+  limits.depth = 6;
+  info = search(&game, meta, &limits, NULL, NULL);
+  move_to_UCI(info.best, name);
+  if (strcmp(name, "e5d6") || info.score < 200) return 5;
+  return 0;
+}
+
+TEST(search_ordering)
+{
+  struct search_limits limits = { .depth = 6 };
+  struct search_stats stats;
+  game_state game;
+  irreversable_state meta;
+
+  move_gen_init_LUTs();
+  parse_FEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", &game, &meta);
+
+  // the killers, countermoves and histories put the refutation first at most nodes that fail high
+  tt_clear();
+  search_clear();
+  search_stats_reset();
+  search(&game, meta, &limits, NULL, NULL);
+  stats = search_stats();
+  if (!stats.cutoffs || stats.first_cutoffs * 10 < stats.cutoffs * 9) return 1;
+  return 0;
+}
+
+TEST(search_ybwc)
+{
+  struct search_limits limits = { .depth = 6 };
+  struct search_info info;
+  game_state game;
+  irreversable_state meta;
+  int err = 0;
+  move m;
+  char name[6];
+
+  move_gen_init_LUTs();
+  search_set_parallel(SEARCH_YBWC);
+  search_set_threads(4);
+
+  // the helpers join below the root, the iterations stay those of a single thread; the
+  // counters include the split points helpers open below the ones they joined
+  tt_clear();
+  search_clear();
+  search_stats_reset();
+  parse_FEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", &game, &meta);
+  info = search(&game, meta, &limits, NULL, NULL);
+  move_to_UCI(info.best, name);
+  if (info.depth != 6 || !search_stats().splits || !search_stats().cutoffs || parse_UCI(name, &game, meta, &m)) err = 1;
+
+  // a cutoff at a split point must not cost the mate
+  tt_clear();
+  search_clear();
+  parse_FEN("r1bq2rk/pp3pbp/2p1p1pQ/7P/3P4/2PB1N2/PP3PPR/2KR4 w - - 0 1", &game, &meta);
+  info = search(&game, meta, &limits, NULL, NULL);
+  move_to_UCI(info.best, name);
+  if (!err && (strcmp(name, "h6h7") || info.score != MATE - 3 || info.lines[0].pv_length != 3)) err = 2;
+
+  // the later tests search on one thread
+  search_set_threads(1);
+  search_set_parallel(SEARCH_LAZY_SMP);
+  return err;
+}
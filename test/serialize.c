@@ -0,0 +1,61 @@
+#include <schess/serialize.h>
+#include <schess/types.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <test/base.h>
+
+static uint64_t
+xorshift64(uint64_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static int
+serialize_compare(serialize_fn fn)
+{
+  piece_type types[NUM_SQUARES];
+  move expected[NUM_SQUARES + 1], got[NUM_SQUARES + 1];
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+  bitboard targets;
+  size_t i, n_expected, n_got;
+  square sq;
+
+  for (sq = a1; sq < NUM_SQUARES; ++sq)
+    types[sq] = sq % PT_COUNT;
+
+  for (i = 0; i < 100000; ++i)
+  {
+    // mix sparse and dense target sets
+    targets = xorshift64(&state);
+    if (i & 1) targets &= xorshift64(&state);
+    if (i & 2) targets &= xorshift64(&state);
+    if (i % 1000 == 0) targets = i % 2000 ? ~0ull : 0ull;
+
+    memset(got, 0xFF, sizeof(got));
+    n_expected = serialize_targets_scalar(targets, i & 63, types, expected);
+    n_got = fn(targets, i & 63, types, got);
+
+    if (n_got != n_expected) return 1;
+    if (memcmp(got, expected, n_expected * sizeof(move))) return 2;
+    // nothing written past the last move
+    if (got[n_got].from != (square) -1) return 3;
+  }
+
+  return 0;
+}
+
+TEST(serialize_avx2)
+{
+  if (serialize_init(CPU_AVX2) != CPU_AVX2) return 0;
+  return serialize_compare(serialize_targets_avx2);
+}
+
+TEST(serialize_avx512)
+{
+  if (serialize_init(CPU_AVX512) != CPU_AVX512) return 0;
+  return serialize_compare(serialize_targets_avx512);
+}
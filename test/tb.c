@@ -0,0 +1,161 @@
+#include <schess/gen.h>
+#include <schess/kpk.h>
+#include <schess/material.h>
+#include <schess/move.h>
+#include <schess/tb.h>
+#include <schess/types.h>
+#include <schess/utils.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <test/base.h>
+
+static const char *tables[] = { "KQvK", "KRvK", "KBvK", "KNvK", "KPvK" };
+#define NUM_TABLES (sizeof(tables) / sizeof(*tables))
+
+// generates the three men tables into a fresh directory
+static int
+tb_setup(char *directory)
+{
+  size_t i;
+
+  tb_free();
+  if (!mkdtemp(directory)) return 1;
+  for (i = 0; i < NUM_TABLES; ++i)
+    if (tb_generate(directory, tables[i], 1)) return 1;
+  return 0;
+}
+
+static void
+tb_teardown(const char *directory)
+{
+  char path[4096];
+  size_t i;
+
+  tb_free();
+  for (i = 0; i < NUM_TABLES; ++i)
+  {
+    snprintf(path, sizeof(path), "%s/%s.wdl", directory, tables[i]);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/%s.dtm", directory, tables[i]);
+    remove(path);
+  }
+  rmdir(directory);
+}
+
+static void
+place(game_state *game, color active, const square *squares, const piece_type *types, size_t n)
+{
+  size_t i;
+
+  memset(game, 0, sizeof(*game));
+  game->active = active;
+  for (i = 0; i < n; ++i)
+  {
+    game->board.bitboards[types[i]] |= sq2bb(squares[i]);
+    game->board.types[squares[i]] = types[i];
+  }
+  material_refresh(game);
+}
+
+// every move of a won position leads to a loss at most one ply shorter, one of them exactly
+static int
+dtm_consistent(game_state *game, irreversable_state meta, struct move_buffer *mbuf)
+{
+  irreversable_state meta_copy;
+  int wdl, plies, child_wdl, child_plies, best = -1, longest = -1;
+  size_t i, num_moves;
+
+  if (tb_probe(game, meta, &wdl, &plies)) return 0;
+  if (wdl == TB_DRAW) return 1;
+
+  num_moves = generate_moves(game, meta, mbuf);
+  for (i = 0; i < num_moves; ++i)
+  {
+    move *m = mbuf->moves + i;
+    meta_copy = meta;
+    move_make(m, game, &meta_copy);
+    if (is_board_legal(&game->board, game->active) && !tb_probe(game, meta_copy, &child_wdl, &child_plies))
+    {
+      if (child_wdl == TB_LOSS && (best < 0 || child_plies < best)) best = child_plies;
+      if (child_wdl == TB_WIN && child_plies > longest) longest = child_plies;
+    }
+    move_unmake(m, game);
+  }
+
+  if (wdl == TB_WIN) return best + 1 == plies;
+  return plies ? longest + 1 == plies : is_in_check(&game->board, game->active);
+}
+
+TEST(tablebases)
+{
+  const struct
+  {
+    const char *FEN;
+    int wdl, plies;
+  } cases[] =
+  {
+    { "k7/1Q6/1K6/8/8/8/8/8 b - - 0 1",     TB_LOSS, 0 },
+    { "k7/2Q5/1K6/8/8/8/8/8 b - - 0 1",     TB_DRAW, 0 }, // stalemate
+    { "k7/8/1K6/8/8/8/7Q/8 w - - 0 1",      TB_WIN,  1 },
+    { "kQ6/8/2K5/8/8/8/8/8 b - - 0 1",      TB_DRAW, 0 }, // the queen hangs
+    { "8/8/8/8/8/1k6/1q6/K7 w - - 0 1",     TB_LOSS, 0 }, // colours reversed
+    { "8/8/8/8/8/1k6/7q/K7 b - - 0 1",      TB_WIN,  1 },
+    { "8/8/8/3k4/8/8/8/KQ6 w KQ - 0 1",     -2,      0 }, // castling rights are not answered
+  };
+  char directory[] = "/tmp/schess_tbXXXXXX";
+  struct move_buffer *mbuf;
+  game_state game;
+  irreversable_state meta = { 0 };
+  piece_type types[] = { PT_WK, PT_BK, PT_WQ };
+  square squares[3];
+  int wdl, plies, longest = 0, err = 0;
+  size_t i;
+
+  if (tb_setup(directory)) { tb_teardown(directory); return 1; }
+  mbuf = move_buffer_create(1);
+
+  for (i = 0; i < sizeof(cases) / sizeof(*cases) && !err; ++i)
+  {
+    parse_FEN(cases[i].FEN, &game, &meta);
+    if (tb_probe(&game, meta, &wdl, &plies)) { if (cases[i].wdl != -2) err = 2 + 2 * i; }
+    else if (wdl != cases[i].wdl || plies != cases[i].plies) err = 3 + 2 * i;
+  }
+
+  // the longest win takes ten moves, and distances agree with the successors everywhere
+  memset(&meta, 0, sizeof(meta));
+  for (squares[0] = 0; squares[0] < 64 && !err; ++squares[0])
+    for (squares[1] = 0; squares[1] < 64 && !err; ++squares[1])
+      for (squares[2] = 0; squares[2] < 64 && !err; ++squares[2])
+      {
+        if (squares[0] == squares[1] || squares[0] == squares[2] || squares[1] == squares[2]) continue;
+        place(&game, COLOR_WHITE, squares, types, 3);
+        if (!is_board_legal(&game.board, COLOR_WHITE)) continue;
+        if (tb_probe(&game, meta, &wdl, &plies)) err = 20;
+        else if (wdl == TB_WIN && plies > longest) longest = plies;
+        if (!err && !(squares[2] & 7) && !dtm_consistent(&game, meta, mbuf)) err = 21;
+      }
+  if (!err && longest != 19) err = 22;
+
+  // KPvK agrees with the bitbase
+  types[2] = PT_WP;
+  for (squares[0] = 0; squares[0] < 64 && !err; ++squares[0])
+    for (squares[1] = 0; squares[1] < 64 && !err; ++squares[1])
+      for (squares[2] = a2; squares[2] <= h7 && !err; ++squares[2])
+      {
+        if (squares[0] == squares[1] || squares[0] == squares[2] || squares[1] == squares[2]) continue;
+        for (i = 0; i < 2 && !err; ++i)
+        {
+          color active = i ? COLOR_BLACK : COLOR_WHITE;
+          place(&game, active, squares, types, 3);
+          if (!is_board_legal(&game.board, active)) continue;
+          if (tb_probe(&game, meta, &wdl, &plies)) err = 30;
+          else if ((wdl != TB_DRAW) != kpk_probe(squares[0], squares[2], squares[1], COLOR_WHITE, active)) err = 31;
+        }
+      }
+
+  move_buffer_destroy(mbuf);
+  tb_teardown(directory);
+  return err;
+}
@@ -0,0 +1,104 @@
+#include <schess/eval.h>
+#include <schess/gen.h>
+#include <schess/tune.h>
+#include <schess/types.h>
+#include <schess/utils.h>
+#include <stddef.h>
+#include <test/base.h>
+
+static const struct
+{
+  const char *line, *FEN;
+  float result;
+} tune_cases[] =
+{
+  {
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1 [1.0]",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -", 1.0f,
+  },
+  {
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - c9 \"1/2-1/2\";",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - -", 0.5f,
+  },
+  {
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 b - - c9 \"0-1\";",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 b - -", 0.0f,
+  },
+  {
+    "4k3/8/4K3/4P3/8/8/8/8 b - - [0.5]\n",
+    "4k3/8/4K3/4P3/8/8/8/8 b - -", 0.5f,
+  },
+  {
+    "8/8/4k3/8/2p5/2P5/4K3/8 w - - [1/2-1/2]",
+    "8/8/4k3/8/2p5/2P5/4K3/8 w - -", 0.5f,
+  },
+};
+#define TUNE_CASES_NUM (sizeof(tune_cases) / sizeof(*tune_cases))
+
+TEST(tune_pack)
+{
+  struct tune_position packed;
+  game_state game, unpacked;
+  irreversable_state meta;
+  size_t i;
+
+  for (i = 0; i < TUNE_CASES_NUM; ++i)
+  {
+    if (tune_pack(tune_cases[i].line, &packed)) return 1 + 3 * i;
+    if (packed.result != tune_cases[i].result) return 2 + 3 * i;
+
+    // the packed position evaluates like the parsed one
+    parse_FEN(tune_cases[i].FEN, &game, &meta);
+    tune_unpack(&packed, &unpacked, &meta);
+    if (unpacked.key != game.key || eval_position(&unpacked, meta) != eval_position(&game, meta))
+      return 3 + 3 * i;
+  }
+
+  if (!tune_pack("not a position [1.0]", &packed)) return 20;
+  if (!tune_pack("8/8/4k3/8/8/3K4/8/8 w - -", &packed)) return 21; // no result
+  return 0;
+}
+
+TEST(tune_quiet)
+{
+  struct tune_position packed;
+
+  move_gen_init_LUTs();
+
+  // the static score of these would miss the material about to change hands
+  if (tune_pack("4k3/8/8/3q4/4P3/8/8/4K3 w - - [1.0]", &packed) || tune_is_quiet(&packed)) return 1;
+  if (tune_pack("4k3/8/8/8/8/8/4r3/4K3 w - - [0.5]", &packed) || tune_is_quiet(&packed)) return 2;
+  if (tune_pack("4k3/1P6/8/8/8/8/8/4K3 w - - [1.0]", &packed) || tune_is_quiet(&packed)) return 3;
+
+  // an even trade or a defended target leaves the position quiet
+  if (tune_pack("4k3/8/2p5/3p4/4P3/8/8/4K3 w - - [0.5]", &packed) || !tune_is_quiet(&packed)) return 4;
+  if (tune_pack("8/8/4k3/8/2p5/2P5/4K3/8 w - - [0.5]", &packed) || !tune_is_quiet(&packed)) return 5;
+  return 0;
+}
+
+TEST(tune_threads)
+{
+  struct tune_position positions[TUNE_CASES_NUM];
+  struct tune_dataset data = { positions, TUNE_CASES_NUM };
+  struct tuner *tuner;
+  double single, error;
+  unsigned threads;
+  size_t i;
+
+  for (i = 0; i < TUNE_CASES_NUM; ++i)
+    if (tune_pack(tune_cases[i].line, &positions[i])) return 1;
+
+  // the slices add up to the same error however the dataset is split
+  for (threads = 1; threads <= 3; ++threads)
+  {
+    tuner = tuner_create(&data, threads);
+    if (!tuner) return 2;
+    error = tuner_error(tuner, 1.0);
+    tuner_destroy(tuner);
+
+    if (threads == 1) single = error;
+    else if (error < single - 1e-12 || error > single + 1e-12) return 2 + threads;
+  }
+
+  return single > 0 && single < 1 ? 0 : 10;
+}
@@ -0,0 +1,120 @@
+#include <schess/gen.h>
+#include <schess/types.h>
+#include <schess/uci.h>
+#include <schess/utils.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <test/base.h>
+
+// runs `script` through uci_loop; the caller frees the output
+static char *
+uci_run(const char *script)
+{
+  FILE *in = fmemopen((void *) script, strlen(script), "r"), *out;
+  char *output = NULL;
+  size_t size;
+
+  if (!in) return NULL;
+  out = open_memstream(&output, &size);
+  if (!out)
+  {
+    fclose(in);
+    return NULL;
+  }
+
+  uci_loop(in, out);
+  fclose(in);
+  fclose(out);
+  return output;
+}
+
+// the move after the last "bestmove" is legal in `FEN` after `moves`
+static int
+uci_check_bestmove(const char *output, const char *FEN)
+{
+  const char *best = NULL, *at = output;
+  game_state game;
+  irreversable_state meta;
+  move m;
+
+  while ((at = strstr(at, "bestmove "))) best = at += 9;
+  if (!best) return 1;
+  parse_FEN(FEN, &game, &meta);
+  return parse_UCI(best, &game, meta, &m);
+}
+
+TEST(uci_moves)
+{
+  static const struct
+  {
+    const char *FEN, *move;
+    enum MOVE_TYPE type;
+  } cases[] =
+  {
+    { UCI_START_FEN, "e2e4", MT_DOUBLE_PAWN },
+    { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", "e1g1", MT_CASTLE_KING },
+    { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1", "e8c8", MT_CASTLE_QUEEN },
+    { "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -", "b4f4", MT_NORMAL },
+    { "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 b kq - 0 1", "b2a1n", MT_PROMOTION_KNIGHT },
+    { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", "e5f6", MT_EN_PASSANT },
+  };
+  game_state game;
+  irreversable_state meta;
+  char name[6];
+  size_t i;
+  move m;
+
+  move_gen_init_LUTs();
+  for (i = 0; i < sizeof(cases) / sizeof(*cases); ++i)
+  {
+    parse_FEN(cases[i].FEN, &game, &meta);
+    if (parse_UCI(cases[i].move, &game, meta, &m)) return 1 + 2 * i;
+    move_to_UCI(m, name);
+    if (m.type != cases[i].type || strcmp(name, cases[i].move)) return 2 + 2 * i;
+  }
+
+  // pinned piece, wrong promotion letter, no such move
+  parse_FEN("4k3/8/8/8/8/8/4r3/4K1r1 w - -", &game, &meta);
+  if (!parse_UCI("e1f2", &game, meta, &m)) return 20;
+  parse_FEN("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 b kq - 0 1", &game, &meta);
+  if (!parse_UCI("b2a1", &game, meta, &m)) return 21;
+  if (!parse_UCI("b2a1k", &game, meta, &m)) return 22;
+  if (!parse_UCI("a8a1", &game, meta, &m)) return 23;
+  return 0;
+}
+
+TEST(uci_session)
+{
+  char *output;
+  int err = 0;
+
+  move_gen_init_LUTs();
+  output = uci_run("uci\nisready\n"
+                   "position startpos moves e2e4 e7e5 g1f3\n"
+                   "go depth 3\n"
+                   "isready\n");
+  if (!output) return 1;
+  if (!strstr(output, "uciok\n") || !strstr(output, "readyok\n")) err = 2;
+  else if (!strstr(output, "info depth 3 ")) err = 3;
+  else if (uci_check_bestmove(output, "rnbqkbnr/pppp1ppp/8/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2")) err = 4;
+  free(output);
+  if (err) return err;
+
+  // stop ends an infinite search at once, which still answers before the next command
+  output = uci_run("setoption name Threads value 3\n"
+                   "position fen 8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - moves b4f4 h4g3\n"
+                   "go infinite\nstop\nisready\n"
+                   "setoption name Threads value 1\n");
+  if (!output) return 5;
+  if (!strstr(output, "bestmove ") || strstr(output, "bestmove ") > strstr(output, "readyok")) err = 6;
+  else if (uci_check_bestmove(output, "8/2p5/3p4/KP5r/5R2/6k1/4P1P1/8 w - -")) err = 7;
+  free(output);
+  if (err) return err;
+
+  output = uci_run("position fen 8/8/8/8 w\nposition startpos moves e2e5\nsetoption name Colour value red\n");
+  if (!output) return 8;
+  if (!strstr(output, "info string invalid position\ninfo string invalid position\ninfo string unknown option\n")) err = 9;
+  free(output);
+  return err;
+}